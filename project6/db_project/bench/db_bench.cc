@@ -0,0 +1,849 @@
+// Benchmarks of the db library.
+// Usage: db_bench <benchmark> [arguments]
+// Run in an empty directory of the file system to be measured. The table files and the log files
+// are created in the current directory, and removed after each run.
+// Configure the build with -DCMAKE_BUILD_TYPE=Release, not to measure the unoptimized library.
+
+#include "bpt.h"
+#include "buffer.h"
+#include "file.h"
+#include "log.h"
+#include "search.h"
+#include "trx.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include <algorithm>
+#include <vector>
+
+char log_path[] = "bench_log";
+char logmsg_path[] = "bench_logmsg";
+char table_path[] = "DATA1";
+
+typedef struct {
+    const char* name;
+    const char* arguments;
+    const char* description;
+    int (*run)(int argc, char** argv);
+} benchmark_t;
+
+// Utility
+
+double now_sec(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// xorshift64*
+uint64_t next_random(uint64_t* state) {
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return *state * 0x2545F4914F6CDD1DULL;
+}
+
+// Return the argument at index, or default_value if not given.
+int64_t get_argument(int argc, char** argv, int index, int64_t default_value) {
+    if (index < argc)
+        return atoll(argv[index]);
+    return default_value;
+}
+
+// Remove the files of the last run.
+void remove_files(void) {
+    char pathname[64];
+
+    unlink(table_path);
+    unlink(log_path);
+    unlink(logmsg_path);
+    snprintf(pathname, sizeof(pathname), "%s%s", log_path, CHECKPOINT_SUFFIX);
+    unlink(pathname);
+}
+
+// Insert the records of key in [0, number_of_records) into a new table, and shut down.
+void load_table(int64_t number_of_records, uint16_t val_size) {
+    char value[PAGE_SIZE];
+    table_id_t table_id;
+    int64_t key;
+
+    remove_files();
+    init_db(10000, 0, 0, log_path, logmsg_path);
+    table_id = open_table(table_path);
+    memset(value, 'v', sizeof(value));
+    for (key = 0; key < number_of_records; key++)
+        db_insert(table_id, key, value, val_size);
+    shutdown_db();
+}
+
+// Walk the leaf pages of the table from the leftmost one.
+// Return the ratio of the used space in the leaves, and the number of the leaves in number_of_leaves.
+double measure_leaf_fill(table_id_t table_id, int64_t* number_of_leaves) {
+    node_page_t* page;
+    pagenum_t pagenum, next_pagenum;
+    uint64_t used_space = 0;
+    int bufnum;
+
+    *number_of_leaves = 0;
+    pagenum = file_get_root_pagenum(table_id);
+    if (pagenum == 0)
+        return 0;
+
+    // I. Descend to the leftmost leaf.
+    buffer_request_page(table_id, pagenum, page, &bufnum, kLatchShared);
+    while (page->header.is_leaf == 0) {
+        pagenum = page->header.branch_first_pagenum;
+        buffer_release_page(bufnum, false);
+        buffer_request_page(table_id, pagenum, page, &bufnum, kLatchShared);
+    }
+
+    // II. Follow the right siblings.
+    while (true) {
+        (*number_of_leaves)++;
+        used_space += INITIAL_FREE_SPACE - page->header.amount_of_free_space;
+        next_pagenum = page->header.right_sibling_pagenum;
+        buffer_release_page(bufnum, false);
+        if (next_pagenum == 0)
+            break;
+        buffer_request_page(table_id, next_pagenum, page, &bufnum, kLatchShared);
+    }
+    return (double)used_space / (*number_of_leaves * INITIAL_FREE_SPACE);
+}
+
+// Visit the internal pages under the page. Add their number to number_of_pages,
+// and their keys to number_of_keys.
+void measure_internal_fill(table_id_t table_id, pagenum_t pagenum, int64_t* number_of_pages, int64_t* number_of_keys) {
+    std::vector<pagenum_t> child_pagenums;
+    node_page_t* page;
+    int bufnum;
+    int i;
+
+    buffer_request_page(table_id, pagenum, page, &bufnum, kLatchShared);
+    if (page->header.is_leaf == 1) {
+        buffer_release_page(bufnum, false);
+        return;
+    }
+    (*number_of_pages)++;
+    *number_of_keys += page->header.number_of_keys;
+    child_pagenums.push_back(page->header.branch_first_pagenum);
+    for (i = 0; i < page->header.number_of_keys; i++)
+        child_pagenums.push_back(page->branchs[i].pagenum);
+    buffer_release_page(bufnum, false);
+
+    for (i = 0; i < (int)child_pagenums.size(); i++)
+        measure_internal_fill(table_id, child_pagenums[i], number_of_pages, number_of_keys);
+}
+
+// Benchmarks
+
+// Look up the first number_of_pages of pagenums at random. Return the latency in ns.
+double measure_hits(table_id_t table_id, std::vector<pagenum_t>& pagenums, int64_t number_of_pages, int64_t number_of_lookups) {
+    node_page_t* page;
+    uint64_t state = 1;
+    int64_t i;
+    int bufnum;
+    double start;
+
+    start = now_sec();
+    for (i = 0; i < number_of_lookups; i++) {
+        buffer_request_page(table_id, pagenums[next_random(&state) % number_of_pages], page, &bufnum, kLatchShared);
+        buffer_release_page(bufnum, false);
+    }
+    return (now_sec() - start) * 1e9 / number_of_lookups;
+}
+
+// Hit latency of buffer_request_page, while 90% of the pool is filled with resident pages.
+// The page table is a hash table, so the latency of the hits on a few hot pages should not grow with num_buf.
+// The hits spread over all of the resident pages also pay the cache and TLB misses of a larger pool.
+int bench_hit_latency(int argc, char** argv) {
+    int64_t max_num_buf = get_argument(argc, argv, 0, 1000000);
+    int64_t number_of_lookups = get_argument(argc, argv, 1, 1000000);
+    std::vector<pagenum_t> pagenums;
+    node_page_t* page;
+    uint64_t hits, misses, old_hits, old_misses;
+    int64_t num_buf;
+    int64_t i;
+    int bufnum;
+    table_id_t table_id;
+    double hot_latency, uniform_latency;
+
+    printf("%10s %10s %14s %14s %10s\n", "num_buf", "resident", "ns/hit (hot)", "ns/hit (all)", "hit ratio");
+    for (num_buf = 100; num_buf <= max_num_buf; num_buf *= 10) {
+        // I. Create the pages, written at shutdown.
+        remove_files();
+        init_db(num_buf, 0, 0, log_path, logmsg_path);
+        table_id = open_table(table_path);
+        pagenums.clear();
+        for (i = 0; i < num_buf * 9 / 10; i++) {
+            pagenums.push_back(buffer_alloc_page(table_id));
+            buffer_request_page(table_id, pagenums.back(), page, &bufnum);
+            buffer_release_page(bufnum, true);
+        }
+        shutdown_db();
+
+        // II. Read them into the pool. The clean pages keep the cleaner idle.
+        init_db(num_buf, 0, 0, log_path, logmsg_path);
+        table_id = open_table(table_path);
+        for (i = 0; i < (int64_t)pagenums.size(); i++) {
+            buffer_request_page(table_id, pagenums[i], page, &bufnum, kLatchShared);
+            buffer_release_page(bufnum, false);
+        }
+
+        // III. Look up the 90 hot pages, then all of the resident pages.
+        buffer_get_stats(&old_hits, &old_misses);
+        hot_latency = measure_hits(table_id, pagenums, 90, number_of_lookups);
+        uniform_latency = measure_hits(table_id, pagenums, pagenums.size(), number_of_lookups);
+        buffer_get_stats(&hits, &misses);
+        hits -= old_hits;
+        misses -= old_misses;
+
+        printf("%10ld %10zu %14.1f %14.1f %10.4f\n", num_buf, pagenums.size(),
+                hot_latency, uniform_latency, (double)hits / (hits + misses));
+        shutdown_db();
+    }
+    remove_files();
+    return 0;
+}
+
+// Misses of each replacement policy, for point lookups mixed with periodic full scans.
+// 90% of the lookups go to the hot keys, whose leaves fit in half of the pool. A full scan
+// follows every round of lookups. A scan resistant policy keeps the hot leaves over the scans.
+// The root and internal pages of a lookup, and the leaf of a scan record, hit in any policy,
+// so the misses are reported along with the hit ratio.
+int bench_policy_hits(int argc, char** argv) {
+    int64_t number_of_records = get_argument(argc, argv, 0, 200000);
+    int64_t num_buf = get_argument(argc, argv, 1, 1000);
+    int64_t number_of_rounds = get_argument(argc, argv, 2, 10);
+    int64_t lookups_per_round = get_argument(argc, argv, 3, 20000);
+    // about 30 records of 100 bytes in a leaf
+    int64_t number_of_hot_keys = std::min(number_of_records, num_buf / 2 * 30);
+    const char* policy_names[] = {"LRU", "CLOCK", "2Q"};
+    ReplacementPolicy policies[] = {kPolicyLRU, kPolicyClock, kPolicy2Q};
+    char value[PAGE_SIZE];
+    uint16_t val_size;
+    scan_cursor_t* cursor;
+    uint64_t state;
+    uint64_t hits, misses, old_hits, old_misses;
+    uint64_t lookup_hits, lookup_misses, scan_hits, scan_misses;
+    int64_t key;
+    int64_t round, i;
+    int p;
+    int trx_id;
+    table_id_t table_id;
+    double start;
+
+    load_table(number_of_records, 100);
+
+    printf("%8s %18s %18s %18s %18s %10s\n", "policy", "lookup hit ratio", "lookup misses/rnd",
+            "scan hit ratio", "scan misses/rnd", "seconds");
+    for (p = 0; p < 3; p++) {
+        init_db(num_buf, 0, 0, log_path, logmsg_path, 1, policies[p]);
+        table_id = open_table(table_path);
+        state = 1;
+        lookup_hits = lookup_misses = scan_hits = scan_misses = 0;
+        start = now_sec();
+
+        // The first round warms up the pool, and is not counted.
+        for (round = 0; round <= number_of_rounds; round++) {
+            // I. Point lookups.
+            buffer_get_stats(&old_hits, &old_misses);
+            trx_id = trx_begin();
+            for (i = 0; i < lookups_per_round; i++) {
+                if (next_random(&state) % 10 != 0)
+                    key = next_random(&state) % number_of_hot_keys;
+                else
+                    key = next_random(&state) % number_of_records;
+                db_find(table_id, key, value, &val_size, trx_id);
+            }
+            trx_commit(trx_id);
+            buffer_get_stats(&hits, &misses);
+            if (round > 0) {
+                lookup_hits += hits - old_hits;
+                lookup_misses += misses - old_misses;
+            }
+
+            // II. A full scan.
+            old_hits = hits;
+            old_misses = misses;
+            cursor = db_scan_open(table_id, 0, number_of_records, 0);
+            while (db_scan_next(cursor, &key, value, &val_size) == 0);
+            db_scan_close(cursor);
+            buffer_get_stats(&hits, &misses);
+            if (round > 0) {
+                scan_hits += hits - old_hits;
+                scan_misses += misses - old_misses;
+            }
+        }
+
+        printf("%8s %18.4f %18.1f %18.4f %18.1f %10.2f\n", policy_names[p],
+                (double)lookup_hits / (lookup_hits + lookup_misses), (double)lookup_misses / number_of_rounds,
+                (double)scan_hits / (scan_hits + scan_misses), (double)scan_misses / number_of_rounds,
+                now_sec() - start);
+        shutdown_db();
+    }
+    remove_files();
+    return 0;
+}
+
+// Restart time as the log grows. Each step updates the records in a child process, which exits
+// without shutting down. The restart recovers from the last checkpoint, so its time should
+// not grow with the log written before the checkpoint.
+int bench_restart(int argc, char** argv) {
+    int64_t number_of_records = get_argument(argc, argv, 0, 20000);
+    int64_t number_of_steps = get_argument(argc, argv, 1, 8);
+    int64_t updates_per_step = get_argument(argc, argv, 2, 20000);
+    char value[PAGE_SIZE];
+    uint16_t old_val_size;
+    struct stat st;
+    uint64_t state = 1;
+    int64_t step, i;
+    int trx_id = 0;
+    int status;
+    pid_t pid;
+    table_id_t table_id;
+    double start;
+
+    load_table(number_of_records, 100);
+    memset(value, 'u', sizeof(value));
+
+    printf("%6s %14s %12s\n", "step", "log (MiB)", "restart (s)");
+    for (step = 1; step <= number_of_steps; step++) {
+        // I. Update in a child, and crash.
+        pid = fork();
+        if (pid == 0) {
+            init_db(1000, 0, 0, log_path, logmsg_path);
+            table_id = open_table(table_path);
+            for (i = 0; i < updates_per_step; i++) {
+                if (i % 100 == 0)
+                    trx_id = trx_begin();
+                db_update(table_id, next_random(&state) % number_of_records, value, 100, &old_val_size, trx_id);
+                if (i % 100 == 99)
+                    trx_commit(trx_id);
+            }
+            _exit(0);
+        }
+        if (pid < 0 || waitpid(pid, &status, 0) != pid) {
+            perror("fork() failure: in bench_restart()");
+            exit(EXIT_FAILURE);
+        }
+        next_random(&state);
+
+        // II. Restart, and shut down cleanly for the next step.
+        start = now_sec();
+        init_db(1000, 0, 0, log_path, logmsg_path);
+        table_id = open_table(table_path);
+        printf("%6ld %14.1f %12.3f\n", step, stat(log_path, &st) == 0 ? st.st_size / 1048576.0 : 0.0, now_sec() - start);
+        shutdown_db();
+    }
+    remove_files();
+    return 0;
+}
+
+// Return the number of the pages of the file resident in the kernel page cache.
+int64_t count_cached_pages(const char* pathname) {
+    std::vector<unsigned char> residency;
+    struct stat st;
+    void* addr;
+    int64_t number_of_pages, count = 0;
+    int64_t i;
+    int fd;
+
+    fd = open(pathname, O_RDONLY);
+    if (fd < 0 || fstat(fd, &st) < 0 || st.st_size == 0) {
+        if (fd >= 0)
+            close(fd);
+        return 0;
+    }
+    number_of_pages = (st.st_size + sysconf(_SC_PAGESIZE) - 1) / sysconf(_SC_PAGESIZE);
+    residency.resize(number_of_pages);
+    addr = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (addr != MAP_FAILED && mincore(addr, st.st_size, residency.data()) == 0)
+        for (i = 0; i < number_of_pages; i++)
+            count += residency[i] & 1;
+    if (addr != MAP_FAILED)
+        munmap(addr, st.st_size);
+    close(fd);
+    return count * sysconf(_SC_PAGESIZE) / PAGE_SIZE;
+}
+
+// Drop the clean pages of the file from the kernel page cache.
+void drop_cached_pages(const char* pathname) {
+    int fd;
+
+    fd = open(pathname, O_RDONLY);
+    if (fd < 0)
+        return;
+    fdatasync(fd);
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    close(fd);
+}
+
+// Buffered I/O against O_DIRECT, at the same total memory of ram_pages.
+// The buffered mode gives half of the memory to the pool, and leaves the other half to the
+// page cache, which caches the pool misses again. The direct mode gives all of it to the pool.
+// The page cache is not limited in this process, so its pages are counted by mincore(),
+// and the memory is reported as the pool plus the cached pages of the table file.
+// The lookups are uniform over a table of about 3/4 of ram_pages.
+int bench_direct_io(int argc, char** argv) {
+    int64_t ram_pages = get_argument(argc, argv, 0, 4000);
+    int64_t number_of_lookups = get_argument(argc, argv, 1, 500000);
+    // about 30 records of 100 bytes in a leaf
+    int64_t number_of_records = get_argument(argc, argv, 2, ram_pages * 3 / 4 * 30);
+    const char* mode_names[] = {"buffered", "direct"};
+    int64_t num_bufs[] = {ram_pages / 2, ram_pages};
+    bool direct_ios[] = {false, true};
+    char value[PAGE_SIZE];
+    uint16_t val_size;
+    uint64_t state;
+    uint64_t hits, misses, old_hits, old_misses;
+    int64_t cached_pages;
+    int64_t i;
+    int m, pass;
+    int trx_id;
+    table_id_t table_id;
+    double start, elapsed = 0;
+
+    load_table(number_of_records, 100);
+
+    printf("%10s %8s %16s %12s %12s %14s %10s\n", "mode", "num_buf", "cached pages",
+            "total MiB", "hit ratio", "lookups/s", "seconds");
+    for (m = 0; m < 2; m++) {
+        drop_cached_pages(table_path);
+        init_db(num_bufs[m], 0, 0, log_path, logmsg_path, 1, kPolicyLRU, kIOBackendSync, direct_ios[m]);
+        table_id = open_table(table_path);
+        state = 1;
+
+        // I. Warm up with a pass of the lookups, not counted.
+        // II. Measure the second pass.
+        for (pass = 0; pass < 2; pass++) {
+            buffer_get_stats(&old_hits, &old_misses);
+            start = now_sec();
+            trx_id = trx_begin();
+            for (i = 0; i < number_of_lookups; i++)
+                db_find(table_id, next_random(&state) % number_of_records, value, &val_size, trx_id);
+            trx_commit(trx_id);
+            elapsed = now_sec() - start;
+        }
+        buffer_get_stats(&hits, &misses);
+        hits -= old_hits;
+        misses -= old_misses;
+        cached_pages = count_cached_pages(table_path);
+
+        printf("%10s %8ld %16ld %12.1f %12.4f %14.0f %10.2f\n", mode_names[m], num_bufs[m], cached_pages,
+                (num_bufs[m] + cached_pages) * PAGE_SIZE / 1048576.0, (double)hits / (hits + misses),
+                number_of_lookups / elapsed, elapsed);
+        shutdown_db();
+    }
+    remove_files();
+    return 0;
+}
+
+// Linear searches, as in the nodes before the search kernels.
+int linear_search_branchs(const branch_t* branchs, int number_of_keys, int64_t key) {
+    int i;
+
+    for (i = 0; i < number_of_keys && branchs[i].key <= key; i++);
+    return i;
+}
+
+int linear_search_slots(const slot_t* slots, int number_of_keys, int64_t key) {
+    int i;
+
+    for (i = 0; i < number_of_keys; i++)
+        if (slots[i].key == key)
+            return i;
+    return -1;
+}
+
+// Node search cost of a full internal page (ORDER - 1 branchs) and a full leaf page (64 slots),
+// by the linear loop and by each search kernel. The keys are even, and the searched keys are
+// uniform over the key range, so that half of the leaf searches miss.
+int bench_node_search(int argc, char** argv) {
+    int64_t number_of_searches = get_argument(argc, argv, 0, 10000000);
+    const int number_of_queries = 4096;
+    const char* kernel_names[] = {"scalar", "sse4.2", "avx2"};
+    SearchKernelType kernels[] = {kSearchScalar, kSearchSSE42, kSearchAVX2};
+    std::vector<int64_t> queries(number_of_queries);
+    node_page_t internal_page, leaf_page;
+    uint64_t state = 1;
+    int64_t sum;
+    int64_t i;
+    int k;
+    double start, internal_ns, leaf_ns;
+
+    memset(&internal_page, 0, sizeof(internal_page));
+    memset(&leaf_page, 0, sizeof(leaf_page));
+    for (i = 0; i < ORDER - 1; i++)
+        internal_page.branchs[i].key = i * 2;
+    for (i = 0; i < 64; i++)
+        leaf_page.slots[i].key = i * 2;
+    search_init();
+
+    printf("%10s %20s %20s %12s\n", "search", "ns/search (internal)", "ns/search (leaf)", "checksum");
+
+    // I. Linear loops.
+    for (i = 0; i < number_of_queries; i++)
+        queries[i] = next_random(&state) % ((ORDER - 1) * 2 + 1) - 1;
+    sum = 0;
+    start = now_sec();
+    for (i = 0; i < number_of_searches; i++)
+        sum += linear_search_branchs(internal_page.branchs, ORDER - 1, queries[i % number_of_queries]);
+    internal_ns = (now_sec() - start) * 1e9 / number_of_searches;
+    for (i = 0; i < number_of_queries; i++)
+        queries[i] = next_random(&state) % (64 * 2 + 1) - 1;
+    start = now_sec();
+    for (i = 0; i < number_of_searches; i++)
+        sum += linear_search_slots(leaf_page.slots, 64, queries[i % number_of_queries]);
+    leaf_ns = (now_sec() - start) * 1e9 / number_of_searches;
+    printf("%10s %20.2f %20.2f %12ld\n", "linear", internal_ns, leaf_ns, sum);
+
+    // II. Search kernels, if supported.
+    for (k = 0; k < 3; k++) {
+        if (search_set_kernel(kernels[k]) != kernels[k]) {
+            printf("%10s %20s %20s\n", kernel_names[k], "unsupported", "unsupported");
+            continue;
+        }
+        state = 1;
+        for (i = 0; i < number_of_queries; i++)
+            queries[i] = next_random(&state) % ((ORDER - 1) * 2 + 1) - 1;
+        sum = 0;
+        start = now_sec();
+        for (i = 0; i < number_of_searches; i++)
+            sum += search_branchs(internal_page.branchs, ORDER - 1, queries[i % number_of_queries]);
+        internal_ns = (now_sec() - start) * 1e9 / number_of_searches;
+        for (i = 0; i < number_of_queries; i++)
+            queries[i] = next_random(&state) % (64 * 2 + 1) - 1;
+        start = now_sec();
+        for (i = 0; i < number_of_searches; i++)
+            sum += search_slots(leaf_page.slots, 64, queries[i % number_of_queries]);
+        leaf_ns = (now_sec() - start) * 1e9 / number_of_searches;
+        printf("%10s %20.2f %20.2f %12ld\n", kernel_names[k], internal_ns, leaf_ns, sum);
+    }
+    search_init();
+    return 0;
+}
+
+typedef struct {
+    int64_t next_key;
+    int64_t number_of_records;
+} bulk_load_input_t;
+
+int next_bulk_load_record(void* arg, int64_t* key, char* value, uint16_t* val_size) {
+    bulk_load_input_t* input = (bulk_load_input_t*)arg;
+
+    if (input->next_key == input->number_of_records)
+        return 1;
+    *key = input->next_key++;
+    memset(value, 'v', 100);
+    *val_size = 100;
+    return 0;
+}
+
+// Bulk load against db_insert, in sorted and in random order, of the same records.
+// The time runs from init_db to shutdown_db, so that every method ends with the pages written.
+int bench_bulk_load(int argc, char** argv) {
+    int64_t number_of_records = get_argument(argc, argv, 0, 500000);
+    int64_t num_buf = get_argument(argc, argv, 1, 10000);
+    const char* method_names[] = {"bulk load", "insert (sorted)", "insert (random)"};
+    std::vector<int64_t> keys(number_of_records);
+    bulk_load_input_t input;
+    char value[PAGE_SIZE];
+    struct stat st;
+    uint64_t state = 1;
+    int64_t number_of_leaves;
+    int64_t i;
+    int m;
+    table_id_t table_id;
+    double start, elapsed, fill;
+
+    memset(value, 'v', sizeof(value));
+    printf("%16s %10s %12s %10s %10s %10s\n", "method", "seconds", "records/s", "file MiB", "leaves", "leaf fill");
+    for (m = 0; m < 3; m++) {
+        for (i = 0; i < number_of_records; i++)
+            keys[i] = i;
+        if (m == 2)
+            for (i = number_of_records - 1; i > 0; i--)
+                std::swap(keys[i], keys[next_random(&state) % (i + 1)]);
+
+        remove_files();
+        start = now_sec();
+        init_db(num_buf, 0, 0, log_path, logmsg_path);
+        table_id = open_table(table_path);
+        if (m == 0) {
+            input.next_key = 0;
+            input.number_of_records = number_of_records;
+            db_bulk_load(table_id, next_bulk_load_record, &input);
+        } else {
+            for (i = 0; i < number_of_records; i++)
+                db_insert(table_id, keys[i], value, 100);
+        }
+        shutdown_db();
+        elapsed = now_sec() - start;
+
+        init_db(num_buf, 0, 0, log_path, logmsg_path);
+        table_id = open_table(table_path);
+        fill = measure_leaf_fill(table_id, &number_of_leaves);
+        shutdown_db();
+
+        printf("%16s %10.2f %12.0f %10.1f %10ld %9.1f%%\n", method_names[m], elapsed, number_of_records / elapsed,
+                stat(table_path, &st) == 0 ? st.st_size / 1048576.0 : 0.0, number_of_leaves, fill * 100);
+    }
+    remove_files();
+    return 0;
+}
+
+// A range scan against one db_find per key of the range, as the range grows.
+// The ranges are read in trxs of about 1000 records, so that the log flush of the commits
+// does not hide the cost of the reads. The table fits in the pool.
+int bench_scan(int argc, char** argv) {
+    int64_t number_of_records = get_argument(argc, argv, 0, 200000);
+    int64_t records_per_length = get_argument(argc, argv, 1, 100000);
+    char value[PAGE_SIZE];
+    uint16_t val_size;
+    scan_cursor_t* cursor;
+    uint64_t state;
+    uint64_t hits, misses, old_hits, old_misses;
+    int64_t length, lo, key;
+    int64_t number_of_ranges, number_of_read_records, number_of_committed_records;
+    int64_t i;
+    int m;
+    int trx_id;
+    table_id_t table_id;
+    double start, ns_per_record[2], pages_per_record[2];
+
+    load_table(number_of_records, 100);
+    init_db(10000, 0, 0, log_path, logmsg_path);
+    table_id = open_table(table_path);
+
+    printf("%10s %16s %16s %16s %16s\n", "length", "find ns/record", "scan ns/record",
+            "find pages/rec", "scan pages/rec");
+    for (length = 1; length <= number_of_records / 10; length *= 10) {
+        number_of_ranges = std::max(records_per_length / length, (int64_t)1);
+        for (m = 0; m < 2; m++) {
+            state = 1;
+            number_of_read_records = number_of_committed_records = 0;
+            buffer_get_stats(&old_hits, &old_misses);
+            start = now_sec();
+            trx_id = trx_begin();
+            for (i = 0; i < number_of_ranges; i++) {
+                lo = next_random(&state) % (number_of_records - length + 1);
+                if (m == 0) {
+                    for (key = lo; key < lo + length; key++)
+                        if (db_find(table_id, key, value, &val_size, trx_id) == 0)
+                            number_of_read_records++;
+                } else {
+                    cursor = db_scan_open(table_id, lo, lo + length - 1, trx_id);
+                    while (db_scan_next(cursor, &key, value, &val_size) == 0)
+                        number_of_read_records++;
+                    db_scan_close(cursor);
+                }
+                if (number_of_read_records - number_of_committed_records >= 1000) {
+                    trx_commit(trx_id);
+                    trx_id = trx_begin();
+                    number_of_committed_records = number_of_read_records;
+                }
+            }
+            trx_commit(trx_id);
+            ns_per_record[m] = (now_sec() - start) * 1e9 / number_of_read_records;
+            buffer_get_stats(&hits, &misses);
+            pages_per_record[m] = (double)(hits - old_hits + misses - old_misses) / number_of_read_records;
+        }
+        printf("%10ld %16.1f %16.1f %16.2f %16.2f\n", length, ns_per_record[0], ns_per_record[1],
+                pages_per_record[0], pages_per_record[1]);
+    }
+    shutdown_db();
+    remove_files();
+    return 0;
+}
+
+// Read keys_per_size keys uniform over the table, in batches of batch_size by db_find_batch,
+// or one db_find per key if batch_size is 0. If is_locked, the keys are read in trxs of about
+// 1000 keys, as in bench_scan. Otherwise they are read without locks, by trx_id 0.
+// Return the time per key in ns, and the page requests per key in pages_per_key.
+double measure_find_batch(table_id_t table_id, int64_t number_of_records, int64_t keys_per_size, int64_t batch_size,
+        bool is_locked, std::vector<int64_t>& keys, std::vector<char*>& out_vals, std::vector<uint16_t>& out_sizes,
+        double* pages_per_key) {
+    uint64_t state = 1;
+    uint64_t hits, misses, old_hits, old_misses;
+    int64_t number_of_read_keys = 0, number_of_committed_keys = 0;
+    int64_t i;
+    int trx_id = 0;
+    double start, elapsed;
+
+    buffer_get_stats(&old_hits, &old_misses);
+    start = now_sec();
+    if (is_locked)
+        trx_id = trx_begin();
+    while (number_of_read_keys < keys_per_size) {
+        if (batch_size == 0) {
+            db_find(table_id, next_random(&state) % number_of_records, out_vals[0], &out_sizes[0], trx_id);
+            number_of_read_keys++;
+        } else {
+            for (i = 0; i < batch_size; i++)
+                keys[i] = next_random(&state) % number_of_records;
+            db_find_batch(table_id, keys.data(), batch_size, out_vals.data(), out_sizes.data(), trx_id);
+            number_of_read_keys += batch_size;
+        }
+        if (is_locked && number_of_read_keys - number_of_committed_keys >= 1000) {
+            trx_commit(trx_id);
+            trx_id = trx_begin();
+            number_of_committed_keys = number_of_read_keys;
+        }
+    }
+    if (is_locked)
+        trx_commit(trx_id);
+    elapsed = now_sec() - start;
+    buffer_get_stats(&hits, &misses);
+    *pages_per_key = (double)(hits - old_hits + misses - old_misses) / number_of_read_keys;
+    return elapsed * 1e9 / number_of_read_keys;
+}
+
+// Per-key cost of db_find_batch as the batch grows, against one db_find per key.
+// The keys of a batch are uniform over the table. The table fits in the pool.
+// The cost is reported with the locks of a trx, and without locks, where the shared descents show.
+int bench_find_batch(int argc, char** argv) {
+    int64_t number_of_records = get_argument(argc, argv, 0, 200000);
+    int64_t keys_per_size = get_argument(argc, argv, 1, 100000);
+    int64_t max_batch_size = get_argument(argc, argv, 2, 4096);
+    std::vector<int64_t> keys(max_batch_size);
+    // The values are at most 112 bytes. Packed, not to miss the TLB on a page per value.
+    std::vector<char> values(max_batch_size * 128);
+    std::vector<char*> out_vals(max_batch_size);
+    std::vector<uint16_t> out_sizes(max_batch_size);
+    int64_t batch_size;
+    int64_t i;
+    table_id_t table_id;
+    double locked_ns, unlocked_ns, locked_pages, unlocked_pages;
+
+    for (i = 0; i < max_batch_size; i++)
+        out_vals[i] = &values[i * 128];
+    load_table(number_of_records, 100);
+    init_db(10000, 0, 0, log_path, logmsg_path);
+    table_id = open_table(table_path);
+
+    printf("%10s %14s %16s %18s %18s\n", "batch", "ns/key (trx)", "pages/key (trx)",
+            "ns/key (no lock)", "pages/key (no lock)");
+    // Batch size 0 stands for one db_find per key, in a trx only.
+    for (batch_size = 0; batch_size <= max_batch_size; batch_size = batch_size == 0 ? 1 : batch_size * 4) {
+        locked_ns = measure_find_batch(table_id, number_of_records, keys_per_size, batch_size, true,
+                keys, out_vals, out_sizes, &locked_pages);
+        if (batch_size == 0) {
+            printf("%10s %14.1f %16.3f\n", "db_find", locked_ns, locked_pages);
+            continue;
+        }
+        unlocked_ns = measure_find_batch(table_id, number_of_records, keys_per_size, batch_size, false,
+                keys, out_vals, out_sizes, &unlocked_pages);
+        printf("%10ld %14.1f %16.3f %18.1f %18.3f\n", batch_size, locked_ns, locked_pages,
+                unlocked_ns, unlocked_pages);
+    }
+    shutdown_db();
+    remove_files();
+    return 0;
+}
+
+// Insert throughput and page fill of sequential inserts, against keys with gaps and random keys.
+// The keys with gaps increase as timestamps, by a random step in [1, 1000].
+// An appended key skips the descent, and a split at the right edge leaves the left page full.
+int bench_append(int argc, char** argv) {
+    int64_t number_of_records = get_argument(argc, argv, 0, 500000);
+    int64_t num_buf = get_argument(argc, argv, 1, 10000);
+    const char* order_names[] = {"sequential", "timestamps", "random"};
+    std::vector<int64_t> keys(number_of_records);
+    char value[PAGE_SIZE];
+    uint64_t state;
+    int64_t number_of_leaves, number_of_internal_pages, number_of_internal_keys;
+    int64_t i;
+    int o;
+    table_id_t table_id;
+    double start, elapsed, leaf_fill;
+
+    memset(value, 'v', sizeof(value));
+    printf("%12s %12s %10s %10s %10s %10s\n", "keys", "inserts/s", "leaves", "leaf fill",
+            "internals", "int. fill");
+    for (o = 0; o < 3; o++) {
+        state = 1;
+        for (i = 0; i < number_of_records; i++) {
+            if (o == 1)
+                keys[i] = (i == 0 ? 0 : keys[i - 1]) + next_random(&state) % 1000 + 1;
+            else
+                keys[i] = i;
+        }
+        if (o == 2)
+            for (i = number_of_records - 1; i > 0; i--)
+                std::swap(keys[i], keys[next_random(&state) % (i + 1)]);
+
+        remove_files();
+        init_db(num_buf, 0, 0, log_path, logmsg_path);
+        table_id = open_table(table_path);
+        start = now_sec();
+        for (i = 0; i < number_of_records; i++)
+            db_insert(table_id, keys[i], value, 100);
+        elapsed = now_sec() - start;
+
+        leaf_fill = measure_leaf_fill(table_id, &number_of_leaves);
+        number_of_internal_pages = number_of_internal_keys = 0;
+        measure_internal_fill(table_id, file_get_root_pagenum(table_id), &number_of_internal_pages, &number_of_internal_keys);
+        shutdown_db();
+
+        printf("%12s %12.0f %10ld %9.1f%% %10ld %9.1f%%\n", order_names[o], number_of_records / elapsed,
+                number_of_leaves, leaf_fill * 100, number_of_internal_pages,
+                number_of_internal_pages == 0 ? 0.0 : 100.0 * number_of_internal_keys / (number_of_internal_pages * (ORDER - 1)));
+    }
+    remove_files();
+    return 0;
+}
+
+benchmark_t benchmarks[] = {
+    {"hit_latency", "[max_num_buf=1000000] [lookups=1000000]",
+        "buffer hit latency as num_buf grows from 100", bench_hit_latency},
+    {"policy_hits", "[records=200000] [num_buf=1000] [rounds=10] [lookups=20000]",
+        "misses of each replacement policy, lookups mixed with full scans", bench_policy_hits},
+    {"restart", "[records=20000] [steps=8] [updates_per_step=20000]",
+        "restart time as the log grows, after a crash in each step", bench_restart},
+    {"direct_io", "[ram_pages=4000] [lookups=500000] [records=ram_pages*3/4*30]",
+        "buffered I/O against O_DIRECT, at the same total memory", bench_direct_io},
+    {"node_search", "[searches=10000000]",
+        "key search in a full internal page and a full leaf page, per kernel", bench_node_search},
+    {"bulk_load", "[records=500000] [num_buf=10000]",
+        "bulk load against db_insert, in time and file size", bench_bulk_load},
+    {"scan", "[records=200000] [records_per_length=100000]",
+        "range scan against repeated db_find, as the range grows", bench_scan},
+    {"find_batch", "[records=200000] [keys_per_size=100000] [max_batch_size=4096]",
+        "per-key cost of db_find_batch as the batch grows", bench_find_batch},
+    {"append", "[records=500000] [num_buf=10000]",
+        "insert throughput and page fill of sequential inserts", bench_append},
+};
+
+void usage(void) {
+    int i;
+
+    printf("Usage: db_bench <benchmark> [arguments]\n");
+    for (i = 0; i < (int)(sizeof(benchmarks) / sizeof(benchmarks[0])); i++)
+        printf("  %-14s %-64s %s\n", benchmarks[i].name, benchmarks[i].arguments, benchmarks[i].description);
+}
+
+int main(int argc, char** argv) {
+    int i;
+
+    if (argc < 2) {
+        usage();
+        return EXIT_FAILURE;
+    }
+    for (i = 0; i < (int)(sizeof(benchmarks) / sizeof(benchmarks[0])); i++)
+        if (strcmp(argv[1], benchmarks[i].name) == 0)
+            return benchmarks[i].run(argc - 2, argv + 2);
+
+    usage();
+    return EXIT_FAILURE;
+}
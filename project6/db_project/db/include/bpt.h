@@ -2,9 +2,13 @@
 #define __BPT_H__
 
 #include <string>
+#include <vector>
 #include <unistd.h>
 
 #include "page.h"
+#include "buffer.h"
+#include "io.h"
+#include "file.h"
 
 // ----------------------------------------------------------------
 // ----------------------------------------------------------------
@@ -27,6 +31,12 @@ int64_t open_table(char *pathname);
 // If tree does not exist, return 0.
 // pagenum_t find_leaf_pagenum(table_id_t table_id, pagenum_t root_pagenum, page::key_t key);
 
+// Descent path
+// The pages from the root to the leaf page, recorded by the descent. The parent of a page is the one before it.
+// The structure modifications take the parents from the path, so the parent page number is not kept in the pages.
+// Return the leaf page number, the last page of the path. If tree does not exist, return 0 with the empty path.
+pagenum_t find_leaf_path(table_id_t table_id, pagenum_t root_pagenum, page::key_t key, std::vector<pagenum_t>& path);
+
 // Find key and store matched value and size in ret_val and val_size if key exists.
 // If success, return 0. Otherwise, return non-zero value.
 // The caller must allocate ret_val and val_size.
@@ -38,28 +48,66 @@ int64_t open_table(char *pathname);
 
 slot_t make_slot(page::key_t key, uint16_t size);
 // Make a new leaf page or internal page.
-pagenum_t make_node_page(int is_leaf);
+// Allocated next to near_pagenum, if given and free.
+pagenum_t make_node_page(table_id_t table_id, int is_leaf, pagenum_t near_pagenum = 0);
 
 // Insert the new slot and value into the leaf page.
 int insert_into_leaf_page(table_id_t table_id, pagenum_t leaf_pagenum, slot_t slot, char* value);
-int insert_into_leaf_page_after_splitting(table_id_t table_id, pagenum_t leaf_pagenum, slot_t slot, char* value);
+// The path ends at the leaf page. It is consumed by the insertion into the parent.
+int insert_into_leaf_page_after_splitting(table_id_t table_id, std::vector<pagenum_t>& path, slot_t slot, char* value);
 
 // Insert the new branch into the internal page.
 int insert_into_internal_page(table_id_t table_id, pagenum_t internal_pagenum, page::key_t new_right_key, pagenum_t new_branch_pagenum);
-int insert_into_internal_page_after_splitting(table_id_t table_id, pagenum_t internal_pagenum, page::key_t new_right_key, pagenum_t new_branch_pagenum);
+// The path ends at the internal page.
+int insert_into_internal_page_after_splitting(table_id_t table_id, std::vector<pagenum_t>& path, page::key_t new_right_key, pagenum_t new_branch_pagenum);
 
-// Insert the new branch into the parent page.
-int insert_into_parent_page(table_id_t table_id, pagenum_t branch_pagenum, page::key_t new_right_key, pagenum_t new_branch_pagenum);
+// Insert the new branch into the parent page of the branch page, the last page of the path.
+// The branch page is popped from the path, and the parent page is the last one left.
+int insert_into_parent_page(table_id_t table_id, std::vector<pagenum_t>& path, page::key_t new_right_key, pagenum_t new_branch_pagenum);
 
 // Insert into internal root page.
 int insert_into_new_root_page(table_id_t table_id, pagenum_t branch_pagenum, page::key_t new_right_key, pagenum_t new_branch_pagenum);
 // Insert into leaf root page.
 int start_new_page_tree(table_id_t table_id, slot_t slot, char* value);
 
+// Append insertion
+// The right-most leaf page inserted into is remembered per table. If it is still the right-most leaf page
+// and the new key is beyond its last key, the key is inserted without the descent from the root.
+// A page split at the right edge of the tree by an appended key keeps APPEND_SPLIT_PERCENT in the left page,
+// so that the pages filled by increasing keys are not left half empty.
+#define APPEND_SPLIT_PERCENT 90
+
+typedef struct {
+    pagenum_t leaf_pagenum;         // 0, if forgotten.
+    page::key_t last_key;           // not greater than the last key of the leaf page. A smaller key is not appended.
+} append_hint_t;
+
+// Return the remembered leaf page of the table, if the key is appended to it. Otherwise, return 0.
+// Store whether the leaf page has to be split in split_flag.
+pagenum_t append_find_leaf_pagenum(table_id_t table_id, page::key_t key, uint16_t val_size, bool* split_flag);
+// Remember the right-most leaf page inserted into, and its last key. 0 forgets it.
+void append_set_leaf_pagenum(table_id_t table_id, pagenum_t leaf_pagenum, page::key_t last_key);
+// Return true if the last page of the path and its ancestors are the last child of their parents.
+// The last page itself is not requested.
+bool is_right_edge_page(table_id_t table_id, const std::vector<pagenum_t>& path);
+
 // Insert key and value to data file at the right place.
 // If success, return 0. Otherwise, return non-zero value.
 int db_insert(int64_t table_id, int64_t key, char* value, uint16_t val_size);
 
+// Insert the n records in one pass. The records are visited in sorted order,
+// and the records of the same leaf page are inserted while the leaf page is latched.
+// If the leaf page overflows, it is split into as many pages as needed at once.
+// A key existing in the table, or repeated in the records, is ignored (the first one is inserted).
+// Return the number of the records inserted.
+int db_insert_batch(int64_t table_id, const int64_t* keys, char** values, const uint16_t* val_sizes, int n);
+// Merge the records order[first, last) into the leaf page, all of whose keys are in the range of the page.
+// The path ends at the leaf page. It is consumed if the leaf page is split.
+// Store the number of the records inserted in number_of_inserted.
+// Return the number of the new leaf pages split from the leaf page.
+int insert_batch_into_leaf_page(table_id_t table_id, std::vector<pagenum_t>& path, const int64_t* keys, char** values, const uint16_t* val_sizes,
+                                const std::vector<int>& order, int first, int last, int* number_of_inserted);
+
 // ----------------------------------------------------------------
 // Deletion
 // ----------------------------------------------------------------
@@ -73,31 +121,96 @@ int adjust_root_page(table_id_t table_id, pagenum_t root_pagenum);
 // Coalesce a too small page with a neighbor page
 // which can accept the additional entries
 // without exceeding the maximum.
-int coalesce_leaf_pages(table_id_t table_id, pagenum_t leaf_pagenum, pagenum_t neighbor_pagenum, page::key_t key_between_two);
-int coalesce_internal_pages(table_id_t table_id, pagenum_t internal_pagenum, pagenum_t neighbor_pagenum, page::key_t key_between_two);
+// The path ends at the too small page. It is consumed by the deletion in the parent.
+int coalesce_leaf_pages(table_id_t table_id, std::vector<pagenum_t>& path, pagenum_t neighbor_pagenum, page::key_t key_between_two);
+int coalesce_internal_pages(table_id_t table_id, std::vector<pagenum_t>& path, pagenum_t neighbor_pagenum, page::key_t key_between_two);
 
 // Redistribute between a too small page and a neighbor page
 // which is too big to app\end the small page
 // without exceeding the maximum.
 // Move some entries from the neighbor page to the leaf page.
-int redistribute_leaf_pages(table_id_t table_id, pagenum_t leaf_pagenum, pagenum_t neighbor_pagenum, int branch_index_between_two);
+// The path ends at the too small page. The parent page is the one before it.
+int redistribute_leaf_pages(table_id_t table_id, const std::vector<pagenum_t>& path, pagenum_t neighbor_pagenum, int branch_index_between_two);
 // Move a entry from the nieghbor page to the internal page.
-int redistribute_internal_pages(table_id_t table_id, pagenum_t internal_pagenum, pagenum_t neighbor_pageum, int branch_index_between_two);
+int redistribute_internal_pages(table_id_t table_id, const std::vector<pagenum_t>& path, pagenum_t neighbor_pageum, int branch_index_between_two);
 
-// Delete the key in the page.
-int delete_entry_in_page(table_id_t table_id, pagenum_t pagenum, int is_leaf, page::key_t key);
+// Delete the key in the page, the last page of the path.
+int delete_entry_in_page(table_id_t table_id, std::vector<pagenum_t>& path, int is_leaf, page::key_t key);
 
 // Find key and delete it if found.
 // If success, return 0. Otherwise, return non-zero value.
 int db_delete(int64_t table_id, int64_t key);
 
+// ----------------------------------------------------------------
+// Bulk load
+// ----------------------------------------------------------------
+// A leaf page is filled up to fill_percent of its space, and an internal page up to fill_percent of its branches.
+#define BULK_LOAD_FILL_PERCENT 90
+// At a small fill_percent, a leaf page still takes a record of the largest value (112 bytes),
+// and an internal page two keys.
+#define BULK_LOAD_MIN_LEAF_FILL (SLOT_SIZE + 112)
+// Number of pages written in a batch.
+#define BULK_LOAD_BATCH_PAGES 64
+
+// Store the next record of the input in key, value and val_size.
+// If the input ends, return non-zero value.
+typedef int (*bulk_load_next_t)(void* arg, int64_t* key, char* value, uint16_t* val_size);
+
+// A level of the tree being built. levels[0] is the leaf level.
+typedef struct {
+    pagenum_t pagenum;              // the page being filled. 0, if none.
+    node_page_t* page;
+    page::key_t low_key;            // the first key under the page
+    // The previous internal page, full but not yet in its parent.
+    // Kept until the page being filled has a key, so that no internal page is left with one branch.
+    pagenum_t pending_pagenum;
+    node_page_t* pending_page;
+    page::key_t pending_low_key;
+} bulk_load_level_t;
+
+typedef struct {
+    table_id_t table_id;
+    int leaf_fill;                  // bytes of the values and slots in a leaf page
+    int internal_fill;              // keys in an internal page
+    std::vector<bulk_load_level_t> levels;
+    std::vector<pagenum_t> pagenums;        // all allocated, freed if failed
+    // The pages to be written.
+    page_t* batch;
+    file_page_io_t ios[BULK_LOAD_BATCH_PAGES];
+    int batch_size;
+} bulk_load_t;
+
+// Build the tree of an empty table bottom-up from the input sorted by key, strictly increasing.
+// The pages are allocated in a row, and written bypassing the buffer, in batches.
+// The records are not logged. The pages are forced, and then a single kBulkLoad log is flushed.
+// The table must not be used by others until it returns.
+// fill_percent must be in [1, 100]. See BULK_LOAD_MIN_LEAF_FILL for the least fill of a page.
+// If the table is not empty, the input is not sorted, or fill_percent is out of the range,
+// return non-zero value and leave the table empty.
+int db_bulk_load(int64_t table_id, bulk_load_next_t next, void* arg, int fill_percent = BULK_LOAD_FILL_PERCENT);
+
+pagenum_t bulk_load_alloc_page(bulk_load_t* loader);
+void bulk_load_init_page(node_page_t* page, int is_leaf);
+// Append the record to the leaf page being filled. Start a new leaf page if full.
+void bulk_load_append_record(bulk_load_t* loader, page::key_t key, char* value, uint16_t val_size);
+// Append the page of the level below to the level. Its parent is decided, and it is written.
+void bulk_load_append_child(bulk_load_t* loader, int level, page::key_t low_key, pagenum_t child_pagenum, node_page_t* child_page);
+// Complete the levels from the bottom. Return the root page number.
+pagenum_t bulk_load_finish(bulk_load_t* loader);
+void bulk_load_write_page(bulk_load_t* loader, pagenum_t pagenum, node_page_t* page);
+void bulk_load_flush(bulk_load_t* loader);
+
 // TODO: implement
 // log_path: log file path
 // logmsg_path: log message path
 // flag: for the recovery test, (0: normal, 1: REDO, 2: UNDO)
 // log_num: needed for REDO/UNDO CRASH
+// num_buf_instances: number of buffer instances which the num_buf frames are split into.
+// replacement_policy: kPolicyLRU, kPolicyClock or kPolicy2Q
+// io_backend: kIOBackendSync (default) or kIOBackendUring (falls back to kIOBackendSync if not supported)
+// direct_io: open the table files with O_DIRECT, so that the pages are cached only in the buffer.
 // If success, return 0.
-int init_db(int num_buf, int flag, int log_num, char* log_path, char* logmsg_path);
+int init_db(int num_buf, int flag, int log_num, char* log_path, char* logmsg_path, int num_buf_instances = 1, ReplacementPolicy replacement_policy = kPolicyLRU, IOBackendType io_backend = kIOBackendSync, bool direct_io = false);
 int shutdown_db(void);
 
 // Utility
@@ -113,6 +226,28 @@ pagenum_t find_leaf_pagenum(table_id_t table_id, pagenum_t root_pagenum, page::k
 // Note that all tasks that need to be handled. (e.g., releasing the vlocks that are held by this txn, rollback of previous operations, etc.) should be completed in db_find().
 int db_find(int64_t table_id, int64_t key, char* ret_val, uint16_t *val_size, int trx_id);
 
+// A page on the path of the last descent, with the upper bound of the keys under it.
+// The keys are visited in ascending order, so a page covers the next key if below the bound.
+typedef struct {
+    pagenum_t pagenum;
+    page::key_t high_key;
+    bool is_bounded;                // false on the right-most path
+} find_batch_path_t;
+
+// Find the n keys in one pass, read by the txn have trx_id, and store the matched values and sizes in out_vals[i] and out_sizes[i].
+// The keys are visited in sorted order. A descent starts from the lowest page on the path of the previous one
+// which covers the key, and each leaf page is read once for all its keys.
+// The locks of the keys in a leaf page are acquired in one pass through the lock table. If trx_id is 0, no lock is acquired.
+// If a key does not exist, out_sizes[i] is 0.
+// Return the number of the keys found.
+// If a lock is failed (e.g., deadlock detected), the txn is aborted and return OP_FAILURE.
+// The caller must allocate out_vals[i] and out_sizes.
+int db_find_batch(int64_t table_id, const int64_t* keys, int n, char** out_vals, uint16_t* out_sizes, int trx_id);
+// Descend from the path to the leaf page which may contain the key, and store the path.
+// The key must not be smaller than the key of the previous descent on the path.
+// If the tree does not exist, return 0.
+pagenum_t find_batch_leaf_pagenum(table_id_t table_id, std::vector<find_batch_path_t>& path, page::key_t key);
+
 // Find the matching key and modify the values.
 // If found, update the value of the record to 'values' with its 'new_val_size' and store its size in 'old_val_size'.
 // If success, return 0. 
@@ -122,4 +257,36 @@ int db_find(int64_t table_id, int64_t key, char* ret_val, uint16_t *val_size, in
 // Note that all tasks taht need to be handled (e.g., releasing the locks that are held on this txn, rollback of previous operations, etc.) should be completed in db_update().
 int db_update(int64_t table_id, int64_t key, char* values, uint16_t new_val_szie, uint16_t* old_val_size, int trx_id);
 
+// ----------------------------------------------------------------
+// Range scan
+// ----------------------------------------------------------------
+// db_scan_next() returns SCAN_END after the last record in the range.
+#define SCAN_END 1
+
+// A cursor over the records of [lo, hi] in key order.
+// It descends the tree once, and then follows the right siblings of the leaf pages.
+// No page is pinned between the calls. The position is the key to be returned next, so that
+// the records inserted or deleted in the leaf page between the calls are seen or skipped.
+// If a page of the table is freed between the calls, the leaf page may have been coalesced,
+// and the cursor descends again to next_key.
+typedef struct {
+    table_id_t table_id;
+    int trx_id;                     // 0, if the records are not locked.
+    pagenum_t leaf_pagenum;         // the leaf page which may contain next_key. 0, if ended.
+    uint64_t free_count;            // file_get_free_count() before leaf_pagenum was found
+    page::key_t next_key;           // no record before it is returned again.
+    page::key_t hi;
+} scan_cursor_t;
+
+// Open a cursor over the records of key in [lo, hi] of the table, read by the txn have trx_id.
+// If trx_id is 0, the records are read without locks.
+// If failed, return NULL.
+scan_cursor_t* db_scan_open(int64_t table_id, int64_t lo, int64_t hi, int trx_id);
+// Store the next record in key, ret_val and val_size, pinning one leaf page at a time.
+// If success, return 0. If no record is left, return SCAN_END.
+// If the lock of the record is failed (e.g., deadlock detected), the txn is aborted and return OP_FAILURE.
+// The caller must allocate ret_val and val_size.
+int db_scan_next(scan_cursor_t* cursor, int64_t* key, char* ret_val, uint16_t* val_size);
+void db_scan_close(scan_cursor_t* cursor);
+
 #endif /* __BPT_H__*/
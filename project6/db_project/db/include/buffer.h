@@ -4,17 +4,83 @@
 #include <stdint.h>
 #include <pthread.h>
 
+#include <atomic>
+#include <deque>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
 #include "page.h"
 
 #define INVALID_BUFNUM -1
 
+// Replacement policy of the buffer pool, selected at buffer_init.
+enum ReplacementPolicy {
+    kPolicyLRU = 0,             // move to the LRU head on every hit
+    kPolicyClock = 1,           // second chance, a hit only sets the reference bit
+    kPolicy2Q = 2,              // scan resistant, pages referenced once never reach the Am queue
+};
+
+// 2Q queue sizes in percent of the frames of an instance.
+// A hit in A1in promotes the page to Am only after the correlated reference period,
+// which is measured in requests to the instance and equals the size of A1in.
+#define TWO_Q_A1IN_PERCENT 25
+#define TWO_Q_A1OUT_PERCENT 50
+
+// Page cleaner
+// The cleaner thread keeps CLEANER_TARGET_PERCENT of the frames of each instance,
+// the ones to be evicted next, clean. It wakes up every CLEANER_INTERVAL_MS,
+// or when a miss had to write a dirty victim.
+#define CLEANER_TARGET_PERCENT 10
+#define CLEANER_INTERVAL_MS 10
+
+// Checkpoint
+// A checkpoint writes the dirty pages of recLSN before the previous checkpoint, CHECKPOINT_BATCH_SIZE pages a batch.
+#define CHECKPOINT_BATCH_SIZE 64
+
+// Read-ahead
+// After READAHEAD_TRIGGER consecutive leaf requests of a table follow the right sibling chain,
+// the next READAHEAD_WINDOW siblings are prefetched in background.
+// After RANDOM_READAHEAD_THRESHOLD misses within a cluster of RANDOM_READAHEAD_CLUSTER pages,
+// the rest of the cluster is prefetched.
+#define READAHEAD_TRIGGER 4
+#define READAHEAD_WINDOW 32
+#define RANDOM_READAHEAD_CLUSTER 64
+#define RANDOM_READAHEAD_THRESHOLD 16
+#define READAHEAD_QUEUE_SIZE 64
+
+enum ReadAheadType {
+    kReadAheadLinear = 0,       // along the right sibling chain
+    kReadAheadRandom = 1,       // a cluster of pagenums
+};
+
+enum PageLatchMode {
+    kLatchShared = 0,           // read-only access, shared with other readers
+    kLatchExclusive = 1,        // modification
+};
+
+// Page table key: (table_id, pagenum)
+typedef std::pair<table_id_t, pagenum_t> buffer_page_id_t;
+
+class BufferPageHash {
+    public: size_t operator() (const buffer_page_id_t &page_id) const {
+        return std::hash<uint64_t>()(((uint64_t)page_id.first << 48) ^ page_id.second);
+    }
+};
+
 typedef struct buffer_cntl_block_t {
     table_id_t table_id;
     pagenum_t pagenum;
 
-    bool is_dirty;
-    // int number_of_pins;
-    pthread_mutex_t page_latch;
+    std::atomic<bool> is_dirty;
+    // LSN before the first log which may have dirtied the page since it was on disk.
+    // -1, if the page on disk is up to date. Kept until the page cleaner's write is forced.
+    // Set when the page is latched in kLatchExclusive, so that a checkpoint never misses a page being modified.
+    std::atomic<int64_t> recLSN;
+    bool is_recLSN_by_latch;        // recLSN was set by the current kLatchExclusive, reset if released clean
+    // The buffer cannot be evicted while pinned.
+    std::atomic<int> number_of_pins;
+    pthread_rwlock_t page_latch;
 
     // for maintaining data structure
     union {
@@ -23,38 +89,176 @@ typedef struct buffer_cntl_block_t {
     };
     int LRU_prev_bufnum;
 
+    // for replacement policy
+    bool is_referenced;             // CLOCK reference bit
+    bool is_in_A1in;                // 2Q: linked in A1in, otherwise in Am (LRU list)
+    uint64_t A1in_tick;             // 2Q: number of requests to the instance when loaded into A1in
+
 } buffer_cntl_block_t;
 
+// A buffer instance. Pages are routed to an instance by the hash of (table_id, pagenum).
+// Every field is protected by instance_latch.
 typedef struct {
+    int first_bufnum;           // owned frames: [first_bufnum, first_bufnum + number_of_bufs)
+    int number_of_bufs;
+
     int first_free_bufnum;      // free buffer list
     int LRU_head_bufnum;        // Most recently used
     int LRU_tail_bufnum;        // Least recently used
 
+    // Resident pages. (table_id, pagenum) -> bufnum
+    std::unordered_map<buffer_page_id_t, int, BufferPageHash> page_table;
+
+    // CLOCK
+    int clock_hand_bufnum;
+
+    // 2Q: A1in is a FIFO of pages referenced once, A1out remembers pages evicted from A1in.
+    int A1in_head_bufnum;
+    int A1in_tail_bufnum;
+    int number_of_A1in_bufs;
+    std::deque< std::pair<buffer_page_id_t, uint64_t> > A1out_queue;
+    std::unordered_map<buffer_page_id_t, uint64_t, BufferPageHash> A1out_table;
+    uint64_t A1out_seq;
+
+    // statistics for buffer_request_page
+    uint64_t number_of_hits;
+    uint64_t number_of_misses;
+
+    pthread_mutex_t instance_latch;
+
 } buffer_info_t ;
 
+typedef struct {
+    ReadAheadType type;
+    table_id_t table_id;
+    pagenum_t pagenum;          // the first page to prefetch
+} readahead_request_t;
+
+// Sequential access detection of a table.
+typedef struct {
+    pagenum_t last_pagenum;     // the last leaf requested
+    pagenum_t expected_pagenum; // its right sibling
+    int number_of_sequential;   // consecutive leaf requests along the chain
+    int last_trigger;           // number_of_sequential at the last read-ahead
+} readahead_state_t;
+
+// An entry of the dirty page table for a checkpoint.
+typedef struct {
+    table_id_t table_id;
+    pagenum_t pagenum;
+    int64_t recLSN;
+} dirty_page_entry_t;
+
+// Replacement policy interface. Every callback is called under instance_latch.
+typedef struct {
+    // The page is loaded into the buffer.
+    void (*on_load)(buffer_info_t* instance, int bufnum);
+    // The resident page is requested.
+    void (*on_hit)(buffer_info_t* instance, int bufnum);
+    // The page is freed from the buffer.
+    void (*on_remove)(buffer_info_t* instance, int bufnum);
+    // Detach an unpinned victim and return it.
+    // If every buffer is pinned, return INVALID_BUFNUM.
+    int (*pick_victim)(buffer_info_t* instance);
+    // Append up to count buffers in the order they will be evicted.
+    void (*get_victim_candidates)(buffer_info_t* instance, int count, std::vector<int>& bufnums);
+} buffer_policy_t;
+
 
 
 // APIs
 
-pagenum_t buffer_alloc_page(table_id_t table_id);
+// Allocate a page, and load it into the buffer initialized. See file_alloc_page() for near_pagenum.
+// The caller must release it dirty.
+pagenum_t buffer_alloc_page(table_id_t table_id, pagenum_t near_pagenum = 0);
 
 void buffer_free_page(table_id_t table_id, pagenum_t pagenum);
 
-// If the page exists in buffer, return it.
-// Otherwise, call disk manager (file_read_page).
-int get_new_bufnum(table_id_t table_id, pagenum_t pagenum);
+// Drop the frame of the page, if any, without writing.
+// For a page written to disk bypassing the buffer.
+void buffer_discard_page(table_id_t table_id, pagenum_t pagenum);
+
+// Load the page into a free or evicted buffer of the instance and return its bufnum.
+// If is_read is false, the frame is left for the caller to fill.
+// The caller must hold instance_latch.
+int get_new_bufnum(buffer_info_t* instance, table_id_t table_id, pagenum_t pagenum, bool is_read = true);
 // Store page and bufnum into the parameter, if requeested buffer is valid.
-int buffer_request_page(table_id_t table_id, pagenum_t pagenum, header_page_t*& page, int* bufnum);
-int buffer_request_page(table_id_t table_id, pagenum_t pagenum, node_page_t*& page, int* bufnum);
+// The buffer is pinned and latched in latch_mode until released.
+// Read-only callers should request kLatchShared.
+int buffer_request_page(table_id_t table_id, pagenum_t pagenum, node_page_t*& page, int* bufnum, PageLatchMode latch_mode = kLatchExclusive);
 
 // Remain the page dirty in buffer.
-// If header, immediately flush
+// is_dirty must be false, if the page is latched in kLatchShared.
 void buffer_release_page(int bufnum, bool is_dirty);
 
-void buffer_init(int num_buf);
+// Split num_buf frames into num_instances buffer instances managed by the replacement policy.
+void buffer_init(int num_buf, int num_instances, ReplacementPolicy policy);
 void buffer_close_table_files(void);
 
 // Utility
 
+// Return the buffer instance which the page belongs to.
+buffer_info_t* buffer_get_instance(table_id_t table_id, pagenum_t pagenum);
+
+// Return the bufnum holding the page, if the page exists in the instance.
+// Otherwise, return INVALID_BUFNUM. The caller must hold instance_latch.
+int buffer_lookup_page(buffer_info_t* instance, table_id_t table_id, pagenum_t pagenum);
+
+// Maintain a doubly linked list of buffers (LRU list or A1in). The caller must hold instance_latch.
+void buffer_unlink(int* head_bufnum, int* tail_bufnum, int bufnum);
+void buffer_link_to_head(int* head_bufnum, int* tail_bufnum, int bufnum);
+
+// Page cleaner
+void buffer_cleaner_start(void);
+void buffer_cleaner_stop(void);
+void* buffer_cleaner_main(void* arg);
+// Write the dirty candidates of the instance in one batch.
+// temp_frames must hold the cleaner target of the instance.
+void buffer_clean_instance(buffer_info_t* instance, page_t* temp_frames);
+// Write the pinned pages of the batch by WAL, force them and unpin.
+// temp_frames must hold the batch.
+void buffer_write_batch(std::vector<int>& batch, page_t* temp_frames);
+
+// Read-ahead
+void buffer_readahead_start(void);
+void buffer_readahead_stop(void);
+void* buffer_readahead_main(void* arg);
+// Called on every leaf request, and on every miss. Queue a read-ahead if detected.
+void buffer_readahead_on_leaf(table_id_t table_id, pagenum_t pagenum, pagenum_t right_sibling_pagenum);
+void buffer_readahead_on_miss(table_id_t table_id, pagenum_t pagenum);
+// Load the page into the buffer if not resident.
+// Return the right sibling if the page is a leaf. Otherwise, return 0.
+pagenum_t buffer_prefetch_page(table_id_t table_id, pagenum_t pagenum);
+// Load the pages not resident into the buffer, read in one batch of the I/O backend.
+void buffer_prefetch_pages(table_id_t table_id, std::vector<pagenum_t>& pagenums);
+
+// Store the resident pages not yet up to date on disk, for a checkpoint.
+void buffer_get_dirty_pages(std::vector<dirty_page_entry_t>& dirty_pages);
+// Write the dirty pages of recLSN < LSN, so that redo of the next restart starts after the LSN.
+void buffer_flush_old_pages(int64_t LSN);
+
+int buffer_get_number_of_frames(void);
+// Sum the hits and misses of buffer_request_page over the instances.
+void buffer_get_stats(uint64_t* hits, uint64_t* misses);
+
+// Replacement policies
+void LRU_on_load(buffer_info_t* instance, int bufnum);
+void LRU_on_hit(buffer_info_t* instance, int bufnum);
+void LRU_on_remove(buffer_info_t* instance, int bufnum);
+int LRU_pick_victim(buffer_info_t* instance);
+void LRU_get_victim_candidates(buffer_info_t* instance, int count, std::vector<int>& bufnums);
+
+void clock_on_load(buffer_info_t* instance, int bufnum);
+void clock_on_hit(buffer_info_t* instance, int bufnum);
+void clock_on_remove(buffer_info_t* instance, int bufnum);
+int clock_pick_victim(buffer_info_t* instance);
+void clock_get_victim_candidates(buffer_info_t* instance, int count, std::vector<int>& bufnums);
+
+void two_q_on_load(buffer_info_t* instance, int bufnum);
+void two_q_on_hit(buffer_info_t* instance, int bufnum);
+void two_q_on_remove(buffer_info_t* instance, int bufnum);
+int two_q_pick_victim(buffer_info_t* instance);
+void two_q_get_victim_candidates(buffer_info_t* instance, int count, std::vector<int>& bufnums);
+
 
 #endif
\ No newline at end of file
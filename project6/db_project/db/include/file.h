@@ -2,11 +2,81 @@
 #define __DB_FILE_H_
 
 #include <stdint.h>
+#include <pthread.h>
+#include <atomic>
+#include <string>
 #include <vector>
 
 #include "page.h"
-
-#define MAX_TABLES 20
+#include "io.h"
+
+// Table registry
+// A table id indexes the registry directly, in [0, MAX_TABLES).
+// At most FILE_FD_POOL_SIZE table files are kept open. When another one is needed,
+// the least recently used file not in use is closed, and reopened on demand.
+// If every open file is in use, the pool exceeds the size.
+#define MAX_TABLES 131072
+#define FILE_FD_POOL_SIZE 256
+
+// Page write policy
+// 0: no-force. A page write is a plain pwrite() after the log up to the page LSN is flushed.
+//    The table files are forced by fdatasync() once per cleaner batch and once per checkpoint.
+// 1: force. Every page write is followed by fdatasync().
+#define FORCE_PAGE_WRITES 0
+
+// Free space management
+// Each bitmap page tracks the allocation of PAGES_PER_BITMAP pages, a group.
+// The bitmap page of a group is its second page. (page 0 is the header page)
+// A bitmap page is written at the first allocation in its group. Until then it is a hole of zeros.
+// The file grows in extents of FILE_EXTENT_PAGES, doubling in one call.
+#define PAGES_PER_BITMAP ((uint64_t)PAGE_SIZE * 8)                  // 32768 pages, 128MiB
+#define BITMAP_PAGENUM(group) ((pagenum_t)(group) * PAGES_PER_BITMAP + 1)
+#define FILE_EXTENT_PAGES 256                                       // 1MiB
+#define INVALID_PAGENUM ((pagenum_t)-1)
+
+// File format
+// Written in the header page. A file of the free page list format, without the bitmaps,
+// has no magic. Such a file is refused, as its page 1 is not a bitmap page.
+#define FILE_FORMAT_MAGIC 0x3150414d54494244ULL                    // "DBITMAP1"
+
+// In-memory copy of the bitmaps of a table file.
+typedef struct {
+    std::vector<page_t> bitmaps;            // bit set: allocated
+    pthread_mutex_t space_latch;
+} file_space_t;
+
+// In-memory header page of a table, authoritative while the table is registered.
+// Read without latch. The page counts are modified under space_latch.
+// Written to page 0 when the table files are forced (every checkpoint), and before the file is closed.
+// Not covered by the WAL. Only the record updates are logged, not the structure modifications
+// (splits, merges, root changes, page allocations) which change the header. The header is
+// as durable as the node pages it describes: both reach the disk at the checkpoint.
+// The root set by a bulk load is the exception, logged by its kBulkLoad log.
+typedef struct {
+    std::atomic<pagenum_t> first_free_pagenum;      // No free page before it. 0 when loaded.
+    std::atomic<uint64_t> number_of_pages;
+    std::atomic<pagenum_t> root_pagenum;
+    std::atomic<bool> is_dirty;                     // modified since written
+} file_header_t;
+
+// A registered table. Never freed until file_close_table_files().
+typedef struct {
+    std::string pathname;
+    std::atomic<int> fd;                    // -1, if closed by the fd pool.
+    std::atomic<int> number_of_users;       // file_acquire_fd() not yet released. The fd is not closed while used.
+    std::atomic<bool> is_referenced;        // CLOCK reference bit of the fd pool
+    std::atomic<bool> is_unsynced;          // written since the last sync
+    std::atomic<uint64_t> free_count;       // pages freed since registered. A scan cursor detects a freed leaf page by it.
+    file_space_t* space;                    // loaded while the file is open
+    file_header_t header;
+} file_table_t;
+
+// A page of a batched read or write.
+typedef struct {
+    table_id_t table_id;
+    pagenum_t pagenum;
+    page_t* page;
+} file_page_io_t;
 
 
 // API to be exported to upper layer.
@@ -15,26 +85,85 @@
 // If failed, return -1.
 table_id_t file_open_table_file(const char* pathname);
 
-// Allocate an on-disk page from the free page list.
-pagenum_t file_alloc_page(table_id_t table_id);
+// Allocate an on-disk page in the bitmap.
+// If near_pagenum is given, prefer the first free page within an extent after it,
+// so that the pages allocated in a row are contiguous.
+pagenum_t file_alloc_page(table_id_t table_id, pagenum_t near_pagenum = 0);
 
-// Free an on-disk page to the free page list.
+// Free an on-disk page in the bitmap.
 void file_free_page(table_id_t table_id, pagenum_t pagenum);
 
 // Read an on-disk page into the in-memory page structure(dest).
 void file_read_page(table_id_t table_id, pagenum_t pagenum, page_t* dest);
 
-// Write an in-memory page(src) to the on-disk page.
+// Write an in-memory page(src) to the on-disk page, after flushing the log up to the page LSN.
+// Not forced unless FORCE_PAGE_WRITES. See file_sync_table_files().
 void file_write_page(table_id_t table_id, pagenum_t pagenum, const page_t* src);
 
+// Read the on-disk pages in one batch of the I/O backend.
+void file_read_pages(file_page_io_t* ios, int count);
+
+// Write the in-memory pages in one batch of the I/O backend, without forcing.
+// The caller must flush the log up to the page LSNs, and force the files by file_sync_table_file().
+void file_write_pages(file_page_io_t* ios, int count);
+
+// Force the writes of the table file.
+void file_sync_table_file(table_id_t table_id);
+// Force the writes of every table file.
+void file_sync_table_files(void);
+
+// Hint the kernel that the pages [pagenum, pagenum + count) will be read soon.
+void file_advise_willneed(table_id_t table_id, pagenum_t pagenum, int count);
+
 // Stop referencing the database file
 // Close all of the opened file
 void file_close_table_files(void);
 
 bool file_is_valid_table_id(table_id_t tid);
 
-void file_init(void);
-inline int file_convert_tid_to_fd(int64_t tid);
+// Select the I/O backend of the page reads and writes.
+// If direct_io, the table files are opened with O_DIRECT, bypassing the kernel page cache.
+// A file system not supporting O_DIRECT falls back to buffered I/O.
+void file_init(IOBackendType io_backend = kIOBackendSync, bool direct_io = false);
+
+// Table registry
+// Return the fd of the registered table, reopened if closed. The fd stays open until released.
+// Lock-free if the file is open.
+int file_acquire_fd(table_id_t table_id);
+void file_release_fd(table_id_t table_id);
+// Open the file of the table and load its bitmaps, closing another file if the pool is full.
+// The caller must hold table_registry_latch.
+// If the file is not of FILE_FORMAT_MAGIC, return -1.
+int file_open_fd(file_table_t* table);
+// Close the least recently used file not in use. If every file is in use, return false.
+// The caller must hold table_registry_latch.
+bool file_close_lru_fd(void);
+// Load the header page of the file. Initialize the file if empty.
+// If the file is not of FILE_FORMAT_MAGIC, return OP_FAILURE.
+int file_load_header(file_table_t* table, int fd);
+// Load the bitmaps of the file.
+file_space_t* file_load_space(int fd, uint64_t number_of_pages);
+
+// Cached header page
+// Lock-free. The root page number is not latched; the caller serializes the structure modifications.
+pagenum_t file_get_root_pagenum(table_id_t table_id);
+void file_set_root_pagenum(table_id_t table_id, pagenum_t root_pagenum);
+uint64_t file_get_number_of_pages(table_id_t table_id);
+// Return the number of the pages freed in the table since registered.
+uint64_t file_get_free_count(table_id_t table_id);
+// Write the header page if modified, without forcing.
+void file_write_header(file_table_t* table, int fd);
+
+// Free space management. The caller must hold space_latch.
+// Grow the file from old_number_of_pages to new_number_of_pages, by fallocate() or ftruncate().
+void file_extend(int fd, uint64_t old_number_of_pages, uint64_t new_number_of_pages);
+// Initialize the bitmap of a new group in memory. Only the bitmap page (and the header page) is allocated.
+void file_bitmap_init_group(file_space_t* space, uint64_t group);
+bool file_bitmap_test(file_space_t* space, pagenum_t pagenum);
+void file_bitmap_set(file_space_t* space, pagenum_t pagenum, bool is_allocated);
+// Return the first free page in [start_pagenum, end_pagenum). If none, return INVALID_PAGENUM.
+pagenum_t file_bitmap_find_free(file_space_t* space, pagenum_t start_pagenum, pagenum_t end_pagenum);
+void file_write_bitmap(int fd, file_space_t* space, uint64_t group);
 
 
 inline void wrapper_read (int fd, pagenum_t pagenum, file_manager_page_t*& dest);
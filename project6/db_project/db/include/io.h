@@ -0,0 +1,53 @@
+#ifndef __IO_H__
+#define __IO_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+// I/O backend under the disk space manager, selected at file_init.
+enum IOBackendType {
+    kIOBackendSync = 0,         // pread()/pwrite() on the caller's thread, one at a time
+    kIOBackendUring = 1,        // io_uring, a batch is submitted together and reaped as completed
+};
+
+// io_uring
+// Each thread submitting I/O has its own ring of IO_URING_QUEUE_DEPTH entries.
+// A larger batch keeps the ring full, refilling it as completions are reaped.
+#define IO_URING_QUEUE_DEPTH 64
+
+typedef struct {
+    int fd;
+    bool is_write;
+    void* buf;
+    size_t length;
+    off_t offset;
+} io_request_t;
+
+// Backend interface.
+typedef struct {
+    // Issue the requests and return after all of them are completed.
+    // A failed or short transfer is fatal.
+    void (*submit_and_wait)(io_request_t* requests, int count);
+    // Release the resources of the calling thread.
+    void (*shutdown)(void);
+} io_backend_t;
+
+
+// APIs
+
+// Select the backend. If io_uring is not supported by the kernel, fall back to kIOBackendSync.
+void io_init(IOBackendType type);
+void io_shutdown(void);
+IOBackendType io_get_backend_type(void);
+
+void io_submit_and_wait(io_request_t* requests, int count);
+
+// Backends
+void sync_submit_and_wait(io_request_t* requests, int count);
+void sync_shutdown(void);
+
+void uring_submit_and_wait(io_request_t* requests, int count);
+void uring_shutdown(void);
+
+#endif
@@ -2,14 +2,31 @@
 #ifndef __LOG_H__
 #define __LOG_H__
 
+#include <stddef.h>         // for offsetof()
 #include <stdint.h>
 
 #include <set>
+#include <utility>
+#include <vector>
 
 #include "page.h"
+#include "buffer.h"
 
 #define LOG_BUFFER_SIZE (PAGE_SIZE * 1000)
 #define TRX_LOG_SIZE 28
+// The largest image of an update log.
+#define MAX_LOG_DATA_LENGTH 108
+
+// Log writer
+// The writer thread writes the filled logs whenever a flush is requested, or every LOG_WRITER_INTERVAL_MS.
+// It drains the sealed part of the ring while appenders fill the rest.
+#define LOG_WRITER_INTERVAL_MS 1
+
+// Checkpoint
+// The checkpointer thread takes a fuzzy checkpoint every CHECKPOINT_INTERVAL_MS, and on shutdown.
+// The last checkpoint is stored in "<log_path>.ckpt", replaced by rename().
+#define CHECKPOINT_INTERVAL_MS 1000
+#define CHECKPOINT_SUFFIX ".ckpt"
 
 enum LogType {
     kBegin = 0,
@@ -17,8 +34,12 @@ enum LogType {
     kCommit = 2,
     kRollback = 3,
     kCompensate = 4,
+    kBulkLoad = 5,              // a tree built by db_bulk_load, its pages forced before the log
 };
 
+// On-disk log record formats.
+// LSN is the offset of the record in the log file.
+#pragma pack(push, 1)
 struct trx_log_t {
     int log_size;
     int64_t LSN;
@@ -38,8 +59,8 @@ struct update_log_t {
     pagenum_t page_id;
     uint16_t offset;
     uint16_t data_length;
-    char old_img[108];
-    char new_img[108];
+    // old image, then new image. Only 2 * data_length bytes are logged.
+    char images[2 * MAX_LOG_DATA_LENGTH];
 };
 
 struct compensate_log_t {
@@ -53,37 +74,123 @@ struct compensate_log_t {
     pagenum_t page_id;
     uint16_t offset;
     uint16_t data_length;
-    char old_img[108];
-    char new_img[108];
     int64_t next_undo_LSN;
+    // old image, then new image. Only 2 * data_length bytes are logged.
+    char images[2 * MAX_LOG_DATA_LENGTH];
+};
+
+// The records of a bulk load are not logged. Redo sets the root page of the table, if not yet.
+struct bulk_load_log_t {
+    int log_size;
+    int64_t LSN;
+    int64_t prev_LSN;
+    int trx_id;                     // 0, not in a trx
+    LogType type;
+
+    table_id_t table_id;
+    pagenum_t root_pagenum;
+    uint64_t number_of_records;
+};
+#pragma pack(pop)
+
+#define BULK_LOAD_LOG_SIZE ((int)sizeof(bulk_load_log_t))
+
+// The record size derives from data_length. (48 + 2 * data_length, 56 + 2 * data_length)
+#define UPDATE_LOG_HEADER_SIZE ((int)offsetof(update_log_t, images))
+#define COMPENSATE_LOG_HEADER_SIZE ((int)offsetof(compensate_log_t, images))
+#define UPDATE_LOG_SIZE(data_length) (UPDATE_LOG_HEADER_SIZE + 2 * (int)(data_length))
+#define COMPENSATE_LOG_SIZE(data_length) (COMPENSATE_LOG_HEADER_SIZE + 2 * (int)(data_length))
+// Images of an update log or a CLR.
+#define LOG_OLD_IMG(log) ((log)->images)
+#define LOG_NEW_IMG(log) ((log)->images + (log)->data_length)
+
+// Checkpoint file format: a header, the dirty page table, then the active trx table.
+// Analysis starts at start_LSN, and redo at the minimum recLSN of the dirty page table.
+struct checkpoint_header_t {
+    int64_t start_LSN;
+    int64_t last_LSN;               // LSN of the log before start_LSN, -1 if none
+    int number_of_dirty_pages;
+    int number_of_active_trxs;
+};
+
+struct checkpoint_trx_entry_t {
+    int trx_id;
+    int64_t first_LSN;              // LSN of the begin log
 };
 
 // APIs
 void log_init(int flag, int log_num, char* log_path, char* logmsg_path);
+// Take the last checkpoint, and close the log file.
+// The buffer must be closed, so that the checkpoint has no dirty page.
+void log_shutdown(void);
 
 // If success, return LSN.
 // Otherwise, negative value.
 int64_t log_create(LogType type, int trx_id);
 int64_t log_create(LogType type, int trx_id, table_id_t table_id, pagenum_t page_id, uint16_t offset, uint16_t data_length, char* old_img, char* new_img);
 int64_t log_create(LogType type, int trx_id, table_id_t table_id, pagenum_t page_id, uint16_t offset, uint16_t data_length, char* old_img, char* new_img, int64_t next_undo_LSN);
+// kBulkLoad
+int64_t log_create(LogType type, table_id_t table_id, pagenum_t root_pagenum, uint64_t number_of_records);
 
 int log_flush(void);
+// Return after the log of the LSN is on disk.
+// The caller wakes up the log writer and waits for the flushed LSN to pass the LSN.
+// Concurrent callers form a group served by a single write and fsync.
+int log_flush(int64_t LSN);
+
+// Log writer
+void log_writer_start(void);
+// Write all filled logs and stop.
+void log_writer_stop(void);
+void* log_writer_main(void* arg);
+
+// Group commit
+// The writer waits up to wait_us for more flush requests before writing. (default 0)
+void log_set_group_commit_wait(int wait_us);
+// groups: number of fsyncs by the writer serving flush requests, grouped_flushes: number of flush requests they served,
+// max_size: the largest group.
+void log_get_group_commit_stats(uint64_t* groups, uint64_t* grouped_flushes, uint64_t* max_size);
+// Read the variable-size update log of the LSN.
 void log_get_update_log(update_log_t* log, int64_t LSN);
 
+// Return the LSN of the next log.
+int64_t log_get_next_LSN(void);
+// Return the end of the filled logs, a log boundary, and store the LSN of the log before it into last_LSN.
+int64_t log_get_filled_LSN(int64_t* last_LSN);
+
+// Checkpoint
+// I. Write the dirty pages older than the previous checkpoint.
+// II. Snapshot the active trx table, then the dirty page table.
+// III. Flush the log up to the snapshot, and replace the checkpoint file.
+void log_checkpoint(void);
+void log_checkpointer_start(void);
+void log_checkpointer_stop(void);
+void* log_checkpointer_main(void* arg);
+// Read the last checkpoint into the parameters.
+// If there is no valid checkpoint, return false.
+bool read_checkpoint(checkpoint_header_t* header, std::vector<dirty_page_entry_t>& dirty_pages, std::vector<checkpoint_trx_entry_t>& active_trxs);
+
 // Utility
-void append_log(void* log, int log_size);
+// Number the log and append it to the log buffer. Return the LSN.
+int64_t append_log(void* log, int log_size);
+// Copy between the ring log buffer and memory.
+void copy_to_log_buffer(int64_t LSN, const void* src, int size);
+void copy_from_log_buffer(void* dest, int64_t LSN, int size);
 void recover(int flag, int log_num);
 
 std::set<int> analysis(void);
 // log_num == 0: normal recovery
 int redo(int log_num);
+// Load the pages of the dirty page table redone first, in batches of the I/O backend.
+void prefetch_redo_pages(void);
 int undo(std::set<int> loser_list, int log_num);
 
-void read_log_file_to_buffer(int64_t LSN);
-void write_log_buffer_to_file(int log_buffer_size);
-void read_log_from_file(void* log, int offset_from_end, int log_size);
+// Write size bytes of logs in the log buffer from the LSN, and force them.
+void write_log_to_file(int64_t LSN, int64_t size);
+void read_log_from_file(void* log, int64_t LSN, int log_size);
 
 void get_log(void* log, int64_t LSN, int log_size);
+void open_log_table_file(table_id_t table_id);
 
 
 
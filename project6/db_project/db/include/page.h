@@ -27,7 +27,8 @@ typedef int64_t key_t;
 // This structure that the upper layer component will use
 // which means the disk space manager reads 4096 bytes from a database file
 // and puts it into the buffer.
-struct page_t {
+// Aligned to PAGE_SIZE for direct I/O. Allocate it by aligned_alloc(), not malloc().
+struct alignas(PAGE_SIZE) page_t {
     // in-memory page structure
     // Disk space manager never opens allocated pages.
     char buffer[PAGE_SIZE];
@@ -57,7 +58,8 @@ typedef struct header_page_t {
     uint64_t number_of_pages;       // [8-15] 
     pagenum_t root_pagenum;         // [16-23]
     int64_t LSN;                    // [24-31]
-    char reserved[4064];            // [32-4095]
+    uint64_t format_magic;          // [32-39]
+    char reserved[4056];            // [40-4095]
 } header_page_t;
 
 typedef struct free_page_t {
@@ -67,7 +69,7 @@ typedef struct free_page_t {
 
 // header foramt 128B
 typedef struct page_header_t {
-    pagenum_t parent_pagenum;       // [0-7]
+    pagenum_t parent_pagenum;       // [0-7]     not maintained. The parent is found on the descent path.
     int is_leaf;                    // [8-11]
     int number_of_keys;             // [12-15]
     char reserved[8];               // [16-23]
@@ -0,0 +1,65 @@
+#ifndef __SEARCH_H__
+#define __SEARCH_H__
+
+#include <stdint.h>
+
+#include "page.h"
+
+// Key search in a node page.
+// slot_t and branch_t are 16B entries with the key at [0-7]. Both are searched in place, sorted by key.
+// The search narrows the entries by a branch-free binary search, down to a window of SEARCH_LINEAR_ENTRIES,
+// and counts the keys in the window by the SIMD kernel, selected at search_init by cpuid.
+#define SEARCH_ENTRY_SIZE 16
+#define SEARCH_LINEAR_ENTRIES 8
+
+enum SearchKernelType {
+    kSearchScalar = 0,          // branch-free binary search to the end
+    kSearchSSE42 = 1,           // one entry per compare
+    kSearchAVX2 = 2,            // two entries per compare
+};
+
+// Select the fastest kernel supported by the CPU.
+void search_init(void);
+// Use the kernel, if supported. Return the kernel in use.
+SearchKernelType search_set_kernel(SearchKernelType type);
+SearchKernelType search_get_kernel(void);
+
+// Return the first index whose key is greater than key.
+// (the number of entries whose key is not greater than key)
+int search_upper_bound(const void* entries, int number_of_entries, int64_t key);
+// Return the first index whose key is not smaller than key.
+int search_lower_bound(const void* entries, int number_of_entries, int64_t key);
+
+// Typed wrappers
+// The branch to follow is branchs[search_branchs(...) - 1], or branch_first_pagenum if 0.
+inline int search_branchs(const branch_t* branchs, int number_of_keys, int64_t key) {
+    return search_upper_bound(branchs, number_of_keys, key);
+}
+// Return the insertion index of the key, after the equal keys.
+inline int search_slots_insertion(const slot_t* slots, int number_of_keys, int64_t key) {
+    return search_upper_bound(slots, number_of_keys, key);
+}
+// Return the index of the slot of the key. If not exists, return -1.
+inline int search_slots(const slot_t* slots, int number_of_keys, int64_t key) {
+    int slot_index = search_lower_bound(slots, number_of_keys, key);
+    return slot_index < number_of_keys && slots[slot_index].key == key ? slot_index : -1;
+}
+// Return the index of the first slot whose key is not smaller than key.
+inline int search_slots_lower_bound(const slot_t* slots, int number_of_keys, int64_t key) {
+    return search_lower_bound(slots, number_of_keys, key);
+}
+// Return the index of the branch of the key. If not exists, return -1.
+inline int search_branchs_exact(const branch_t* branchs, int number_of_keys, int64_t key) {
+    int branch_index = search_lower_bound(branchs, number_of_keys, key);
+    return branch_index < number_of_keys && branchs[branch_index].key == key ? branch_index : -1;
+}
+
+// Kernels
+// Return the number of the keys not greater than key in [0, number_of_entries), by branch-free binary search.
+int search_count_scalar(const char* entries, int number_of_entries, int64_t key);
+// Return the number of the keys not greater than key in the window of SEARCH_LINEAR_ENTRIES.
+int search_count_window_scalar(const char* entries, int64_t key);
+int search_count_window_sse42(const char* entries, int64_t key);
+int search_count_window_avx2(const char* entries, int64_t key);
+
+#endif
@@ -6,6 +6,7 @@
 
 #include <queue>
 #include <utility>
+#include <vector>
 
 #include "page.h"
 
@@ -64,6 +65,7 @@ struct trx_t {
     lock_t* lock_list_tail;
 
     std::queue<int64_t> queue_LSN;
+    int64_t first_LSN = -1;         // LSN of the begin log
 };
 
 
@@ -79,6 +81,12 @@ int trx_init(void);
 // If an error occurs, return NULL.
 lock_t* lock_acquire(int64_t table_id, pagenum_t page_id, int64_t key, int trx_id, int lock_mode);
 
+// Acquire the locks of the keys in a page, in one pass through the lock list of the page.
+// keys must be sorted and distinct.
+// Only the locks granted without waiting are acquired, from the first key up to a key conflicting with another trx.
+// Return the number of the keys locked. The caller acquires the lock of the next key by lock_acquire(), and continues.
+int lock_acquire_batch(int64_t table_id, pagenum_t page_id, const int64_t* keys, int number_of_keys, int trx_id, int lock_mode);
+
 // Remove the lock_obj from the lock list.
 //      If there is a successor, wake up the successor.
 // If success, return 0.
@@ -112,6 +120,14 @@ void trx_pop_log_from_queue(int trx_id);
 void trx_surrect(int trx_id);
 void trx_kill(int trx_id);
 int trx_get_last_LSN(int trx_id);
+// Store (trx_id, LSN of the begin log) of the active trxs, for a checkpoint.
+// Return the LSN where analysis starts, and store the LSN of the log before it into last_LSN.
+// A trx not in the snapshot has no begin log before the returned LSN, or has its commit or rollback log before it.
+int64_t trx_get_active_trxs(std::vector< std::pair<int, int64_t> >& active_trxs, int64_t* last_LSN);
+
+// test API
+// Call the hook in trx_commit(), after the commit log and before the trx leaves the trx_table.
+void trx_test_set_commit_hook(void (*hook)(int trx_id));
 
 // Utility
 
@@ -120,6 +136,9 @@ int trx_get_last_LSN(int trx_id);
 // If converted, return 1.
 // If failed, return -1.
 int convert_implicit_to_explicit(int64_t table_id, pagenum_t page_id, int64_t key);
+// Return the lock table entry of the page, created if not exists.
+// The caller must hold lock_table_latch.
+lock_table_entry_t* lock_table_get_entry(int64_t table_id, pagenum_t page_id);
 bool is_alive_trx(int trx_id);
 bool detect_deadlock(int trx_id);
 
@@ -4,15 +4,23 @@
 #include <string.h>
 #include <stdlib.h>
 
+#include <algorithm>
+#include <unordered_map>
+
 #include "page.h"
 #include "file.h"
 #include "buffer.h"
 #include "trx.h"
 #include "log.h"
+#include "search.h"
 
 bool verbose;
 bool verbose2;
 
+// Append insertion. table_id -> the last leaf page inserted into.
+std::unordered_map<table_id_t, append_hint_t> append_hints;
+pthread_mutex_t append_latch = PTHREAD_MUTEX_INITIALIZER;
+
 // Open existing data file using pathname or create a new one if not existed.
 // If success, return unique table id, which represents the own table in this database.
 // If failure, return negative value.
@@ -56,16 +64,12 @@ pagenum_t find_leaf_pagenum(table_id_t table_id, pagenum_t root_pagenum, page::k
         return 0;
     
     // Request the root page.
-    buffer_request_page(table_id, root_pagenum, node_page, &node_bufnum);
+    buffer_request_page(table_id, root_pagenum, node_page, &node_bufnum, kLatchShared);
     
     // Find the leaf page which may contain the key.
     while (node_page->header.is_leaf == 0) {
         // Find the child page number which may contain the key.
-        for (branch_index = 0; branch_index < node_page->header.number_of_keys; branch_index++) {
-            if (key < node_page->branchs[branch_index].key) 
-                break;
-        }
-        branch_index--;
+        branch_index = search_branchs(node_page->branchs, node_page->header.number_of_keys, key) - 1;
         if (branch_index == -1)
             node_pagenum = node_page->header.branch_first_pagenum;
         else
@@ -75,7 +79,7 @@ pagenum_t find_leaf_pagenum(table_id_t table_id, pagenum_t root_pagenum, page::k
         buffer_release_page(node_bufnum, false);
 
         // Request the child page.
-        buffer_request_page(table_id, node_pagenum, node_page, &node_bufnum);
+        buffer_request_page(table_id, node_pagenum, node_page, &node_bufnum, kLatchShared);
 
     }
 
@@ -88,14 +92,60 @@ pagenum_t find_leaf_pagenum(table_id_t table_id, pagenum_t root_pagenum, page::k
     // Return the leaf page number.
     return node_pagenum;
 }
+
+// Return the leaf page number which may contain the key, and record the pages from the root to it in the path.
+// If tree does not exist, return 0.
+pagenum_t find_leaf_path(table_id_t table_id, pagenum_t root_pagenum, page::key_t key, std::vector<pagenum_t>& path) {
+    int branch_index;
+    int node_bufnum;
+    node_page_t* node_page;
+    pagenum_t node_pagenum = root_pagenum;
+
+    if (verbose)
+        printf(" |find_leaf_path");
+
+    path.clear();
+
+    // Tree does not exist.
+    if (root_pagenum == 0)
+        return 0;
+
+    // Request the root page.
+    buffer_request_page(table_id, root_pagenum, node_page, &node_bufnum, kLatchShared);
+    path.push_back(root_pagenum);
+
+    // Find the leaf page which may contain the key.
+    while (node_page->header.is_leaf == 0) {
+        // Find the child page number which may contain the key.
+        branch_index = search_branchs(node_page->branchs, node_page->header.number_of_keys, key) - 1;
+        if (branch_index == -1)
+            node_pagenum = node_page->header.branch_first_pagenum;
+        else
+            node_pagenum = node_page->branchs[branch_index].pagenum;
+
+        // Release the page.
+        buffer_release_page(node_bufnum, false);
+
+        // Request the child page.
+        buffer_request_page(table_id, node_pagenum, node_page, &node_bufnum, kLatchShared);
+        path.push_back(node_pagenum);
+    }
+
+    // Release the leaf page.
+    buffer_release_page(node_bufnum, false);
+
+    if (verbose) {
+        printf("| ");
+    }
+    // Return the leaf page number.
+    return node_pagenum;
+}
 // Find the key and store matched value and size in ret_val and val_size if the key exists.
 // If success, return 0. Otherwise, return non-zero vlaue.
 // The caller must allocate ret_val and val_size.
 int db_find(table_id_t table_id, page::key_t key, char *ret_val, uint16_t *val_size) {
 
     int slot_index;
-    int header_bufnum;
-    header_page_t *header_page;
     pagenum_t root_pagenum, leaf_pagenum;
     int leaf_bufnum;
     node_page_t *leaf_page;
@@ -110,9 +160,7 @@ int db_find(table_id_t table_id, page::key_t key, char *ret_val, uint16_t *val_s
         return OP_FAILURE;
 
     // Get the root_pagenum.
-    buffer_request_page(table_id, 0, header_page, &header_bufnum);
-    root_pagenum = header_page->root_pagenum;
-    buffer_release_page(header_bufnum, false);
+    root_pagenum = file_get_root_pagenum(table_id);
 
     // Find the leaf page number which may contain the key in the tree.
     leaf_pagenum = find_leaf_pagenum(table_id, root_pagenum, key);
@@ -126,17 +174,15 @@ int db_find(table_id_t table_id, page::key_t key, char *ret_val, uint16_t *val_s
     }
 
     // Request the leaf page.
-    buffer_request_page(table_id, leaf_pagenum, leaf_page, &leaf_bufnum);
+    buffer_request_page(table_id, leaf_pagenum, leaf_page, &leaf_bufnum, kLatchShared);
 
     // Find the key in the leaf page.
-    for (slot_index = 0; slot_index < leaf_page->header.number_of_keys; slot_index++) {
-        // Store the value and size, if exist.
-        if (leaf_page->slots[slot_index].key == key) {
-            existence_flag = true;
-            memcpy(ret_val, &(leaf_page->values[VALUE_OFFSET(leaf_page->slots[slot_index].offset)]), leaf_page->slots[slot_index].size);
-            *val_size = leaf_page->slots[slot_index].size;
-            break;
-        }
+    slot_index = search_slots(leaf_page->slots, leaf_page->header.number_of_keys, key);
+    // Store the value and size, if exist.
+    if (slot_index >= 0) {
+        existence_flag = true;
+        memcpy(ret_val, &(leaf_page->values[VALUE_OFFSET(leaf_page->slots[slot_index].offset)]), leaf_page->slots[slot_index].size);
+        *val_size = leaf_page->slots[slot_index].size;
     }
     
     // Release the leaf page.
@@ -161,7 +207,7 @@ slot_t make_slot(page::key_t key, uint16_t size) {
     return new_slot;
 }
 
-pagenum_t make_node_page(table_id_t table_id, int is_leaf) {
+pagenum_t make_node_page(table_id_t table_id, int is_leaf, pagenum_t near_pagenum) {
     
     pagenum_t new_pagenum;
     int new_bufnum;
@@ -172,7 +218,7 @@ pagenum_t make_node_page(table_id_t table_id, int is_leaf) {
         printf(" |make_node_page ");
     }
     // Allocate the new page.
-    new_pagenum = buffer_alloc_page(table_id);
+    new_pagenum = buffer_alloc_page(table_id, near_pagenum);
 
     // Request the new page.
     buffer_request_page(table_id, new_pagenum, new_page, &new_bufnum);
@@ -207,9 +253,7 @@ int insert_into_leaf_page(table_id_t table_id, pagenum_t leaf_pagenum, slot_t sl
 
     // Find the insertion index.
     // The first index where new key is smaller than key in the leaf page.
-    for (insertion_index = 0; insertion_index < leaf_page->header.number_of_keys; insertion_index++)
-        if (slot.key < leaf_page->slots[insertion_index].key)
-            break;
+    insertion_index = search_slots_insertion(leaf_page->slots, leaf_page->header.number_of_keys, slot.key);
     
     // Make room for insertion. Move all data behind the insertion index.
     for (slot_index = leaf_page->header.number_of_keys; slot_index > insertion_index; slot_index--)
@@ -235,9 +279,9 @@ int insert_into_leaf_page(table_id_t table_id, pagenum_t leaf_pagenum, slot_t sl
     return OP_SUCCESS;
 }
 
-int insert_into_leaf_page_after_splitting(table_id_t table_id, pagenum_t leaf_pagenum, slot_t slot, char* value) {
+int insert_into_leaf_page_after_splitting(table_id_t table_id, std::vector<pagenum_t>& path, slot_t slot, char* value) {
 
-    pagenum_t new_leaf_pagenum;
+    pagenum_t leaf_pagenum, new_leaf_pagenum;
     int leaf_bufnum, new_leaf_bufnum;
     node_page_t *leaf_page, *new_leaf_page;
     slot_t* temp_slots;
@@ -247,6 +291,9 @@ int insert_into_leaf_page_after_splitting(table_id_t table_id, pagenum_t leaf_pa
     int split_index, insertion_index, slot_index, temp_slot_index;
     int occupied_space = 0;
     int new_key;
+    bool append_flag;
+
+    leaf_pagenum = path.back();
     
     if (verbose) {
         printf("\n|insert_into_leaf_page_after_splitting (%ld, %d) in %ld", slot.key, slot.size, leaf_pagenum);
@@ -259,11 +306,11 @@ int insert_into_leaf_page_after_splitting(table_id_t table_id, pagenum_t leaf_pa
 
     // Find the insertion index,
     // which is the first index where new key is smaller than key in the leaf page.
-    for (insertion_index = 0; insertion_index < leaf_page->header.number_of_keys; insertion_index++)
-        if (slot.key < leaf_page->slots[insertion_index].key)
-            break;
+    insertion_index = search_slots_insertion(leaf_page->slots, leaf_page->header.number_of_keys, slot.key);
+    // Appended at the right edge of the tree.
+    append_flag = (leaf_page->header.right_sibling_pagenum == 0 && insertion_index == leaf_page->header.number_of_keys);
     if (verbose) {
-        printf("(insertion_index:%d)", insertion_index);
+        printf("(insertion_index:%d, append:%d)", insertion_index, append_flag);
     }
     
     // Create a temporary array of slots,
@@ -293,10 +340,21 @@ int insert_into_leaf_page_after_splitting(table_id_t table_id, pagenum_t leaf_pa
     memset(&leaf_page->values[0], 0, INITIAL_FREE_SPACE);
 
     // Find the split index of temp_slots.
-    for (split_index = 0; split_index < number_of_temp_slots; split_index++) {
-        occupied_space += temp_slots[split_index].size;
-        if (occupied_space >= INITIAL_FREE_SPACE / 2)
-            break;
+    // I. appended. Fill the left page up to APPEND_SPLIT_PERCENT. The new slot goes to the right page.
+    if (append_flag == true) {
+        for (split_index = 0; split_index < number_of_temp_slots - 1; split_index++) {
+            occupied_space += SLOT_SIZE + temp_slots[split_index].size;
+            if (occupied_space > INITIAL_FREE_SPACE * APPEND_SPLIT_PERCENT / 100)
+                break;
+        }
+    }
+    // II. otherwise, split in half.
+    else {
+        for (split_index = 0; split_index < number_of_temp_slots; split_index++) {
+            occupied_space += temp_slots[split_index].size;
+            if (occupied_space >= INITIAL_FREE_SPACE / 2)
+                break;
+        }
     }
     if (verbose) {
         printf("(occupied_space:%d, split_index:%d)", occupied_space, split_index);
@@ -315,14 +373,14 @@ int insert_into_leaf_page_after_splitting(table_id_t table_id, pagenum_t leaf_pa
     }
     
     // Create a new leaf page.
-    new_leaf_pagenum = make_node_page(table_id, 1);
+    // Next to the leaf page, so that the leaf chain is read sequentially.
+    new_leaf_pagenum = make_node_page(table_id, 1, leaf_pagenum);
     // Request the new leaf page.
     buffer_request_page(table_id, new_leaf_pagenum, new_leaf_page, &new_leaf_bufnum);
 
-    // Set the metadata (right sibling and parent).
+    // Set the metadata (right sibling).
     new_leaf_page->header.right_sibling_pagenum = leaf_page->header.right_sibling_pagenum;
     leaf_page->header.right_sibling_pagenum = new_leaf_pagenum;
-    new_leaf_page->header.parent_pagenum = leaf_page->header.parent_pagenum;
 
     // Move the second half into new_leaf_page.
     for (temp_slot_index = split_index, slot_index = 0; temp_slot_index < number_of_temp_slots; temp_slot_index++, slot_index++) {
@@ -353,7 +411,7 @@ int insert_into_leaf_page_after_splitting(table_id_t table_id, pagenum_t leaf_pa
         printf("->");
     }
     // Insert new_right_key and new_leaf_pagenum into parent.
-    return insert_into_parent_page(table_id, leaf_pagenum, new_key, new_leaf_pagenum);
+    return insert_into_parent_page(table_id, path, new_key, new_leaf_pagenum);
 }
 
 int insert_into_internal_page(table_id_t table_id, pagenum_t internal_pagenum, page::key_t new_right_key, pagenum_t new_branch_pagenum) {
@@ -371,9 +429,7 @@ int insert_into_internal_page(table_id_t table_id, pagenum_t internal_pagenum, p
 
     // Find the insertion_index.
     // The first index where new key is smaller than key in the internal page.
-    for (insertion_index = 0; insertion_index < internal_page->header.number_of_keys; insertion_index++) 
-        if (new_right_key < internal_page->branchs[insertion_index].key)
-            break;
+    insertion_index = search_branchs(internal_page->branchs, internal_page->header.number_of_keys, new_right_key);
 
     // Move all data behind the insertion index to make room for insertion.
     for (branch_index = internal_page->header.number_of_keys; branch_index > insertion_index; branch_index--)
@@ -397,16 +453,17 @@ int insert_into_internal_page(table_id_t table_id, pagenum_t internal_pagenum, p
     return OP_SUCCESS;
 }
 
-int insert_into_internal_page_after_splitting(table_id_t table_id, pagenum_t internal_pagenum, page::key_t new_right_key, pagenum_t new_branch_pagenum) {
+int insert_into_internal_page_after_splitting(table_id_t table_id, std::vector<pagenum_t>& path, page::key_t new_right_key, pagenum_t new_branch_pagenum) {
 
-    pagenum_t new_internal_pagenum;
+    pagenum_t internal_pagenum, new_internal_pagenum;
     int internal_bufnum, new_internal_bufnum;
     node_page_t *internal_page, *new_internal_page;
     branch_t* temp_branchs;
     int branch_index, insertion_index, split_index, temp_branch_index;
     int new_key;
-    int branch_bufnum;
-    node_page_t *branch_page;
+    bool append_flag;
+
+    internal_pagenum = path.back();
 
     if (verbose)
         printf("\n|insert_into_internal_page_after_splitting (%ld, %ld) in page %ld", new_right_key, new_branch_pagenum, internal_pagenum);
@@ -424,9 +481,7 @@ int insert_into_internal_page_after_splitting(table_id_t table_id, pagenum_t int
 
     // Find the insertion index.
     // The first index where new key is smaller than key in the internal page.
-    for (insertion_index = 0; insertion_index < internal_page->header.number_of_keys; insertion_index++) 
-        if (new_right_key < internal_page->branchs[insertion_index].key)
-            break;
+    insertion_index = search_branchs(internal_page->branchs, internal_page->header.number_of_keys, new_right_key);
 
     // Move internal_page->branchs into temp_branchs. Hop at insertion_index.
     // branch_first_pagenum would not be moved, so does not need to be changed.
@@ -442,8 +497,13 @@ int insert_into_internal_page_after_splitting(table_id_t table_id, pagenum_t int
     internal_page->header.number_of_keys = 0;
 
     // Find the split index of temp_branchs.
-    // half of max number of keys. (ORDER-1)
-    split_index = ((ORDER-1) % 2 == 0? (ORDER-1)/2 : (ORDER-1)/2 + 1);
+    // I. appended at the right edge of the tree. Keep APPEND_SPLIT_PERCENT of the branchs in the left page.
+    append_flag = (insertion_index == ORDER - 1 && is_right_edge_page(table_id, path));
+    if (append_flag == true)
+        split_index = ORDER * APPEND_SPLIT_PERCENT / 100;
+    // II. otherwise, half of max number of keys. (ORDER-1)
+    else
+        split_index = ((ORDER-1) % 2 == 0? (ORDER-1)/2 : (ORDER-1)/2 + 1);
 
     // Move the first half into internal_page.
     for (temp_branch_index = 0; temp_branch_index < split_index - 1; temp_branch_index++) {
@@ -454,12 +514,9 @@ int insert_into_internal_page_after_splitting(table_id_t table_id, pagenum_t int
     }
 
     // Create a new internal page.
-    new_internal_pagenum = make_node_page(table_id, 0);
+    new_internal_pagenum = make_node_page(table_id, 0, internal_pagenum);
     // Request the new internal page.
     buffer_request_page(table_id, new_internal_pagenum, new_internal_page, &new_internal_bufnum);
-
-    // Set the metadata.
-    new_internal_page->header.parent_pagenum = internal_page->header.parent_pagenum;
     
     // Get new_key to be inserted into parent.
     new_key = temp_branchs[split_index - 1].key;
@@ -477,16 +534,7 @@ int insert_into_internal_page_after_splitting(table_id_t table_id, pagenum_t int
     // Deallocate the temp_branchs.
     free(temp_branchs);
 
-    // Update the parent pagent number of moved branch pages. (Read, modify, write)
-    buffer_request_page(table_id, new_internal_page->header.branch_first_pagenum, branch_page, &branch_bufnum);
-    branch_page->header.parent_pagenum = new_internal_pagenum;
-    buffer_release_page(branch_bufnum, true);
-    for (branch_index = 0; branch_index < new_internal_page->header.number_of_keys; branch_index++) {
-        // Update the metadata of moved branch pages. (Read, modify, write)
-        buffer_request_page(table_id, new_internal_page->branchs[branch_index].pagenum, branch_page, &branch_bufnum);
-        branch_page->header.parent_pagenum = new_internal_pagenum;
-        buffer_release_page(branch_bufnum, true);
-    }
+    // The moved branch pages are not modified. Their parent is found on the path of the next descent.
 
     // Release the pages. Write the pages.
     buffer_release_page(internal_bufnum, true);
@@ -498,32 +546,32 @@ int insert_into_internal_page_after_splitting(table_id_t table_id, pagenum_t int
         printf("->");
     }
     // Insert new_right_key and new_internal_pagenum into parent.
-    return insert_into_parent_page(table_id, internal_pagenum, new_key, new_internal_pagenum);
+    return insert_into_parent_page(table_id, path, new_key, new_internal_pagenum);
 }
 
-int insert_into_parent_page(table_id_t table_id, pagenum_t branch_pagenum, page::key_t new_right_key, pagenum_t new_branch_pagenum) {
+int insert_into_parent_page(table_id_t table_id, std::vector<pagenum_t>& path, page::key_t new_right_key, pagenum_t new_branch_pagenum) {
 
-    pagenum_t parent_pagenum;
-    int branch_bufnum, parent_bufnum;
-    node_page_t *branch_page, *parent_page;
+    pagenum_t branch_pagenum, parent_pagenum;
+    int parent_bufnum;
+    node_page_t *parent_page;
     bool split_flag = false;
 
     if (verbose)
         printf("\n|insert_into_parent_page->");
 
-    // Get the parent page number in the branch page.
-    buffer_request_page(table_id, branch_pagenum, branch_page, &branch_bufnum);
-    parent_pagenum = branch_page->header.parent_pagenum;
-    buffer_release_page(branch_bufnum, false);
+    // Get the parent page number on the path.
+    branch_pagenum = path.back();
+    path.pop_back();
 
     // I. new_branch is root.
-    if (parent_pagenum == 0) {
+    if (path.empty() == true) {
         return insert_into_new_root_page(table_id, branch_pagenum, new_right_key, new_branch_pagenum);
     }
+    parent_pagenum = path.back();
 
     // Get the split flag in the parent page
     // Check if the parent page is full.
-    buffer_request_page(table_id, parent_pagenum, parent_page, &parent_bufnum);
+    buffer_request_page(table_id, parent_pagenum, parent_page, &parent_bufnum, kLatchShared);
     if (parent_page->header.number_of_keys == ORDER - 1)
         split_flag = true;
     buffer_release_page(parent_bufnum, false);
@@ -533,17 +581,15 @@ int insert_into_parent_page(table_id_t table_id, pagenum_t branch_pagenum, page:
         return insert_into_internal_page(table_id, parent_pagenum, new_right_key, new_branch_pagenum);
     // III. Parent does not have room for insertion.
     else   
-        return insert_into_internal_page_after_splitting(table_id, parent_pagenum, new_right_key, new_branch_pagenum);
+        return insert_into_internal_page_after_splitting(table_id, path, new_right_key, new_branch_pagenum);
 
 }
 
 int insert_into_new_root_page(table_id_t table_id, pagenum_t branch_pagenum, page::key_t new_right_key, pagenum_t new_branch_pagenum) {
 
     pagenum_t root_pagenum;
-    int root_bufnum, branch_bufnum, header_bufnum;
+    int root_bufnum;
     node_page_t *root_page;
-    node_page_t *branch_page;
-    header_page_t * header_page;
 
     if (verbose) {
         printf("\n|insert_into_new_root_page");
@@ -557,9 +603,6 @@ int insert_into_new_root_page(table_id_t table_id, pagenum_t branch_pagenum, pag
     // Request the root page.
     buffer_request_page(table_id, root_pagenum, root_page, &root_bufnum);
 
-    // Set the metadata.
-    root_page->header.parent_pagenum = 0;
-
     // Insert the branchs.
     root_page->header.branch_first_pagenum = branch_pagenum;
     root_page->branchs[0].key = new_right_key;
@@ -570,19 +613,8 @@ int insert_into_new_root_page(table_id_t table_id, pagenum_t branch_pagenum, pag
     // Release the root page. Write the root page.
     buffer_release_page(root_bufnum, true);
 
-    // Update parent_pagenum of moved branchs. (Read, modify, write)
-    buffer_request_page(table_id, branch_pagenum, branch_page, &branch_bufnum);
-    branch_page->header.parent_pagenum = root_pagenum;
-    buffer_release_page(branch_bufnum, true);
-
-    buffer_request_page(table_id, new_branch_pagenum, branch_page, &branch_bufnum);
-    branch_page->header.parent_pagenum = root_pagenum;
-    buffer_release_page(branch_bufnum, true);
-
-    // Update the metadata in header_page. (Read, modify, write)
-    buffer_request_page(table_id, 0, header_page, &header_bufnum);
-    header_page->root_pagenum = root_pagenum;
-    buffer_release_page(header_bufnum, true);
+    // Update the metadata in the header page.
+    file_set_root_pagenum(table_id, root_pagenum);
 
     if (verbose) {
         printf("\tafter insertion ");
@@ -598,9 +630,8 @@ int insert_into_new_root_page(table_id_t table_id, pagenum_t branch_pagenum, pag
 int start_new_page_tree(table_id_t table_id, slot_t slot, char* value) {
 
     pagenum_t root_pagenum;
-    int root_bufnum, header_bufnum;
+    int root_bufnum;
     node_page_t* root_page;
-    header_page_t* header_page;
     
     if(verbose)
         printf(" |start_new_page_tree");
@@ -611,8 +642,7 @@ int start_new_page_tree(table_id_t table_id, slot_t slot, char* value) {
     // Request the root page.
     buffer_request_page(table_id, root_pagenum, root_page, &root_bufnum);
 
-    // Set the metadata (parent and right sibling).
-    root_page->header.parent_pagenum = 0;
+    // Set the metadata (right sibling).
     root_page->header.right_sibling_pagenum = 0;
 
     // Insert the slot and value.
@@ -626,10 +656,8 @@ int start_new_page_tree(table_id_t table_id, slot_t slot, char* value) {
     // Release the root page. Write the root page.
     buffer_release_page(root_bufnum, true);
 
-    // Update the metadata in header_page. (Read, modify, write)
-    buffer_request_page(table_id, 0, header_page, &header_bufnum);
-    header_page->root_pagenum = root_pagenum;
-    buffer_release_page(header_bufnum, true);
+    // Update the metadata in the header page.
+    file_set_root_pagenum(table_id, root_pagenum);
     
     if (verbose) {
         printf("\n\tafter insertion");
@@ -644,10 +672,9 @@ int db_insert(int64_t table_id, int64_t key, char* value, uint16_t val_size) {
 
     slot_t slot;
     pagenum_t root_pagenum, leaf_pagenum;
-    int header_bufnum, leaf_bufnum;
-    header_page_t* header_page;
+    std::vector<pagenum_t> path;
+    int leaf_bufnum;
     node_page_t* leaf_page;
-    int slot_index;
     bool split_flag = false;
 
     if (verbose) {
@@ -657,16 +684,21 @@ int db_insert(int64_t table_id, int64_t key, char* value, uint16_t val_size) {
     if (file_is_valid_table_id(table_id) == false)
         return OP_FAILURE;
 
-    // Get the root page number in header_page.
-    buffer_request_page(table_id, 0, header_page, &header_bufnum);
-    root_pagenum = header_page->root_pagenum;
-    buffer_release_page(header_bufnum, false);
+    // Get the root page number in the header page.
+    root_pagenum = file_get_root_pagenum(table_id);
     
     // Make a new slot.
     slot = make_slot(key, val_size);
 
-    // Get the leaf page number which may contain the key.
-    leaf_pagenum = find_leaf_pagenum(table_id, root_pagenum, key);
+    // Appended to the remembered leaf page. Skip the descent.
+    // The split needs the path to the leaf page. Descend for it below.
+    leaf_pagenum = append_find_leaf_pagenum(table_id, key, val_size, &split_flag);
+    if (leaf_pagenum != 0 && split_flag == false)
+        return insert_into_leaf_page(table_id, leaf_pagenum, slot, value);
+    split_flag = false;
+
+    // Get the leaf page number which may contain the key, and the path to it.
+    leaf_pagenum = find_leaf_path(table_id, root_pagenum, key, path);
     
     // I. the tree does not exist.
     if (leaf_pagenum == 0) {
@@ -678,23 +710,30 @@ int db_insert(int64_t table_id, int64_t key, char* value, uint16_t val_size) {
     
     // II. the tree exists.
     // Request the leaf page.
-    buffer_request_page(table_id ,leaf_pagenum, leaf_page, &leaf_bufnum);
+    buffer_request_page(table_id ,leaf_pagenum, leaf_page, &leaf_bufnum, kLatchShared);
 
     if (verbose) {
         printf("(num_keys:%d, free: %ld)", leaf_page->header.number_of_keys, leaf_page->header.amount_of_free_space);
     }
     // Find the key in the leaf page.
-    for (slot_index = 0; slot_index < leaf_page->header.number_of_keys; slot_index++)
-        // Ignore duplicates if the key exists in the leaf page.
-        if (key == leaf_page->slots[slot_index].key) {
-            buffer_release_page(leaf_bufnum, false);
-            return OP_FAILURE;
-        }
+    // Ignore duplicates if the key exists in the leaf page.
+    if (search_slots(leaf_page->slots, leaf_page->header.number_of_keys, key) >= 0) {
+        buffer_release_page(leaf_bufnum, false);
+        return OP_FAILURE;
+    }
 
     // Set the split flag if the leaf page does not have enough room.
     if (leaf_page->header.amount_of_free_space < (SLOT_SIZE + val_size))
         split_flag = true;
 
+    // Remember the right-most leaf page, unless it is split.
+    if (leaf_page->header.right_sibling_pagenum == 0) {
+        if (split_flag == true)
+            append_set_leaf_pagenum(table_id, 0, 0);
+        else if (leaf_page->header.number_of_keys > 0)
+            append_set_leaf_pagenum(table_id, leaf_pagenum, std::max(key, leaf_page->slots[leaf_page->header.number_of_keys - 1].key));
+    }
+
     // Release the leaf page.
     buffer_release_page(leaf_bufnum, false);
 
@@ -703,7 +742,312 @@ int db_insert(int64_t table_id, int64_t key, char* value, uint16_t val_size) {
         return insert_into_leaf_page(table_id, leaf_pagenum, slot, value);
     // II-2. leaf does not have room for insertion.
     else   
-        return insert_into_leaf_page_after_splitting(table_id, leaf_pagenum, slot, value);
+        return insert_into_leaf_page_after_splitting(table_id, path, slot, value);
+}
+
+pagenum_t append_find_leaf_pagenum(table_id_t table_id, page::key_t key, uint16_t val_size, bool* split_flag) {
+
+    std::unordered_map<table_id_t, append_hint_t>::iterator it;
+    append_hint_t hint;
+    int leaf_bufnum;
+    node_page_t* leaf_page;
+    bool append_flag;
+
+    pthread_mutex_lock(&append_latch);
+    it = append_hints.find(table_id);
+    if (it != append_hints.end())
+        hint = it->second;
+    else
+        hint.leaf_pagenum = 0;
+    pthread_mutex_unlock(&append_latch);
+
+    // Not appended, without reading the leaf page.
+    if (hint.leaf_pagenum == 0 || key <= hint.last_key)
+        return 0;
+
+    // The right-most leaf page covers every key beyond its last key.
+    buffer_request_page(table_id, hint.leaf_pagenum, leaf_page, &leaf_bufnum, kLatchShared);
+    append_flag = (leaf_page->header.is_leaf == 1 && leaf_page->header.right_sibling_pagenum == 0
+                    && leaf_page->header.number_of_keys > 0);
+    if (append_flag == true) {
+        hint.last_key = leaf_page->slots[leaf_page->header.number_of_keys - 1].key;
+        if (key > hint.last_key) {
+            *split_flag = (leaf_page->header.amount_of_free_space < (uint64_t)(SLOT_SIZE + val_size));
+            hint.last_key = key;
+        } else {
+            append_flag = false;
+        }
+    }
+    buffer_release_page(leaf_bufnum, false);
+
+    // Keep the last key, unless the leaf page is forgotten meanwhile.
+    pthread_mutex_lock(&append_latch);
+    it = append_hints.find(table_id);
+    if (it != append_hints.end() && it->second.leaf_pagenum == hint.leaf_pagenum)
+        it->second.last_key = hint.last_key;
+    pthread_mutex_unlock(&append_latch);
+
+    return append_flag == true ? hint.leaf_pagenum : 0;
+}
+
+void append_set_leaf_pagenum(table_id_t table_id, pagenum_t leaf_pagenum, page::key_t last_key) {
+    append_hint_t hint;
+
+    hint.leaf_pagenum = leaf_pagenum;
+    hint.last_key = last_key;
+    pthread_mutex_lock(&append_latch);
+    append_hints[table_id] = hint;
+    pthread_mutex_unlock(&append_latch);
+}
+
+bool is_right_edge_page(table_id_t table_id, const std::vector<pagenum_t>& path) {
+
+    int node_bufnum;
+    node_page_t* node_page;
+    pagenum_t last_pagenum;
+    int path_index;
+
+    // Up to the root, check the page is the last branch of its parent.
+    for (path_index = (int)path.size() - 2; path_index >= 0; path_index--) {
+        buffer_request_page(table_id, path[path_index], node_page, &node_bufnum, kLatchShared);
+        if (node_page->header.number_of_keys == 0)
+            last_pagenum = node_page->header.branch_first_pagenum;
+        else
+            last_pagenum = node_page->branchs[node_page->header.number_of_keys - 1].pagenum;
+        buffer_release_page(node_bufnum, false);
+
+        if (last_pagenum != path[path_index + 1])
+            return false;
+    }
+    return true;
+}
+
+int db_insert_batch(int64_t table_id, const int64_t* keys, char** values, const uint16_t* val_sizes, int n) {
+
+    std::vector<int> order;
+    std::vector<find_batch_path_t> path;
+    std::vector<pagenum_t> leaf_path;
+    pagenum_t leaf_pagenum;
+    page::key_t high_key;
+    bool is_bounded;
+    int first, last, i;
+    int number_of_inserted, total_inserted = 0;
+
+    if (verbose) {
+        printf("|db_insert_batch %d ", n);
+    }
+
+    // Check the table_id is valid.
+    if (file_is_valid_table_id(table_id) == false)
+        return OP_FAILURE;
+
+    // Sort the records by their index. The first of the equal keys is kept.
+    order.resize(n);
+    for (i = 0; i < n; i++)
+        order[i] = i;
+    std::stable_sort(order.begin(), order.end(), [keys](int a, int b) { return keys[a] < keys[b]; });
+    order.erase(std::unique(order.begin(), order.end(), [keys](int a, int b) { return keys[a] == keys[b]; }), order.end());
+    n = order.size();
+
+    for (first = 0; first < n; first = last) {
+        // I. the tree does not exist.
+        leaf_pagenum = find_batch_leaf_pagenum(table_id, path, keys[order[first]]);
+        if (leaf_pagenum == 0) {
+            start_new_page_tree(table_id, make_slot(keys[order[first]], val_sizes[order[first]]), values[order[first]]);
+            total_inserted++;
+            last = first + 1;
+            continue;
+        }
+
+        // II. Insert the records in the range of the leaf page.
+        high_key = path.back().high_key;
+        is_bounded = path.back().is_bounded;
+        for (last = first; last < n && (is_bounded == false || keys[order[last]] < high_key); last++);
+
+        // The pages on the path may be split. Descend from the root again.
+        leaf_path.clear();
+        for (i = 0; i < (int)path.size(); i++)
+            leaf_path.push_back(path[i].pagenum);
+        if (insert_batch_into_leaf_page(table_id, leaf_path, keys, values, val_sizes, order, first, last, &number_of_inserted) > 0)
+            path.clear();
+        total_inserted += number_of_inserted;
+    }
+
+    if (verbose) {
+        printf("(inserted: %d)|", total_inserted);
+    }
+
+    return total_inserted;
+}
+
+int insert_batch_into_leaf_page(table_id_t table_id, std::vector<pagenum_t>& path, const int64_t* keys, char** values, const uint16_t* val_sizes,
+                                const std::vector<int>& order, int first, int last, int* number_of_inserted) {
+
+    int leaf_bufnum, new_leaf_bufnum;
+    node_page_t *leaf_page, *new_leaf_page;
+    std::vector<slot_t> temp_slots;
+    std::vector<const char*> temp_values;
+    std::vector<int> new_records;           // index of the records to be inserted, in order
+    std::vector<int> split_indices;
+    std::vector<pagenum_t> new_leaf_pagenums;
+    char old_values[INITIAL_FREE_SPACE];
+    slot_t slot;
+    pagenum_t leaf_pagenum, right_sibling_pagenum;
+    int number_of_pages, occupied_space, total_space = 0, new_space = 0;
+    int values_offset;
+    int slot_index, record_index, temp_slot_index, page_index;
+
+    leaf_pagenum = path.back();
+
+    if (verbose) {
+        printf("\n|insert_batch_into_leaf_page %d records in %ld", last - first, leaf_pagenum);
+    }
+
+    // Request the leaf page. It is kept until all the records are placed.
+    buffer_request_page(table_id, leaf_pagenum, leaf_page, &leaf_bufnum);
+
+    // I. Find the records whose key is not in the leaf page.
+    slot_index = 0;
+    for (record_index = first; record_index < last; record_index++) {
+        slot_index += search_slots_lower_bound(&leaf_page->slots[slot_index], leaf_page->header.number_of_keys - slot_index, keys[order[record_index]]);
+        if (slot_index < leaf_page->header.number_of_keys && leaf_page->slots[slot_index].key == keys[order[record_index]])
+            continue;
+        new_records.push_back(order[record_index]);
+        new_space += SLOT_SIZE + val_sizes[order[record_index]];
+    }
+    *number_of_inserted = new_records.size();
+
+    // II. the leaf page has room. Merge the slots from the back in place, and append the values.
+    if (new_space <= (int)leaf_page->header.amount_of_free_space) {
+        values_offset = PAGE_HEADER_SIZE + SLOT_SIZE * leaf_page->header.number_of_keys + leaf_page->header.amount_of_free_space;
+        slot_index = leaf_page->header.number_of_keys - 1;
+        temp_slot_index = leaf_page->header.number_of_keys + new_records.size() - 1;
+        for (record_index = new_records.size() - 1; record_index >= 0; temp_slot_index--) {
+            if (slot_index >= 0 && leaf_page->slots[slot_index].key > keys[new_records[record_index]]) {
+                leaf_page->slots[temp_slot_index] = leaf_page->slots[slot_index];
+                slot_index--;
+            } else {
+                slot = make_slot(keys[new_records[record_index]], val_sizes[new_records[record_index]]);
+                slot.trx_id = 0;
+                values_offset -= slot.size;
+                slot.offset = values_offset;
+                leaf_page->slots[temp_slot_index] = slot;
+                memcpy(&leaf_page->values[VALUE_OFFSET(slot.offset)], values[new_records[record_index]], slot.size);
+                record_index--;
+            }
+        }
+        // Modify the metadata.
+        leaf_page->header.number_of_keys += new_records.size();
+        leaf_page->header.amount_of_free_space -= new_space;
+
+        // Release the leaf page. Write, if inserted.
+        buffer_release_page(leaf_bufnum, new_records.empty() == false);
+        if (verbose) {
+            printf("|");
+        }
+        return 0;
+    }
+
+    // III. the leaf page overflows. Merge the slots of the leaf page and the new records in order.
+    memcpy(&old_values[0], &leaf_page->values[0], INITIAL_FREE_SPACE);
+    slot_index = 0;
+    record_index = 0;
+    while (slot_index < leaf_page->header.number_of_keys || record_index < (int)new_records.size()) {
+        if (record_index == (int)new_records.size()
+                || (slot_index < leaf_page->header.number_of_keys && leaf_page->slots[slot_index].key < keys[new_records[record_index]])) {
+            temp_slots.push_back(leaf_page->slots[slot_index]);
+            temp_values.push_back(&old_values[VALUE_OFFSET(leaf_page->slots[slot_index].offset)]);
+            slot_index++;
+        } else {
+            slot = make_slot(keys[new_records[record_index]], val_sizes[new_records[record_index]]);
+            slot.trx_id = 0;
+            temp_slots.push_back(slot);
+            temp_values.push_back(values[new_records[record_index]]);
+            record_index++;
+        }
+        total_space += SLOT_SIZE + temp_slots.back().size;
+    }
+
+    // IV. Split the slots evenly into the least pages, so that no page overflows.
+    number_of_pages = (total_space + INITIAL_FREE_SPACE - 1) / INITIAL_FREE_SPACE;
+    while (true) {
+        split_indices.assign(1, 0);
+        occupied_space = 0;
+        for (temp_slot_index = 0; temp_slot_index < (int)temp_slots.size(); temp_slot_index++) {
+            // A slot belongs to the page where its middle falls.
+            page_index = (int)(((int64_t)occupied_space + (SLOT_SIZE + temp_slots[temp_slot_index].size) / 2) * number_of_pages / total_space);
+            if (page_index >= (int)split_indices.size() && temp_slot_index > split_indices.back())
+                split_indices.push_back(temp_slot_index);
+            occupied_space += SLOT_SIZE + temp_slots[temp_slot_index].size;
+        }
+        split_indices.push_back(temp_slots.size());
+
+        for (page_index = 0; page_index + 1 < (int)split_indices.size(); page_index++) {
+            occupied_space = 0;
+            for (temp_slot_index = split_indices[page_index]; temp_slot_index < split_indices[page_index + 1]; temp_slot_index++)
+                occupied_space += SLOT_SIZE + temp_slots[temp_slot_index].size;
+            if (occupied_space > INITIAL_FREE_SPACE)
+                break;
+        }
+        if (page_index + 1 == (int)split_indices.size())
+            break;
+        number_of_pages++;
+    }
+    number_of_pages = split_indices.size() - 1;
+    if (verbose) {
+        printf("(slots: %ld, space: %d, pages: %d)", temp_slots.size(), total_space, number_of_pages);
+    }
+
+    // V. Fill the leaf page and the new leaf pages in a row. The last page takes the right sibling of the leaf page.
+    right_sibling_pagenum = leaf_page->header.right_sibling_pagenum;
+    new_leaf_pagenums.push_back(leaf_pagenum);
+    for (page_index = 1; page_index < number_of_pages; page_index++)
+        new_leaf_pagenums.push_back(make_node_page(table_id, 1, new_leaf_pagenums.back()));
+
+    for (page_index = 0; page_index < number_of_pages; page_index++) {
+        if (page_index == 0) {
+            new_leaf_page = leaf_page;
+        } else {
+            buffer_request_page(table_id, new_leaf_pagenums[page_index], new_leaf_page, &new_leaf_bufnum);
+        }
+        if (page_index + 1 < number_of_pages)
+            new_leaf_page->header.right_sibling_pagenum = new_leaf_pagenums[page_index + 1];
+        else
+            new_leaf_page->header.right_sibling_pagenum = right_sibling_pagenum;
+
+        new_leaf_page->header.number_of_keys = 0;
+        new_leaf_page->header.amount_of_free_space = INITIAL_FREE_SPACE;
+        for (temp_slot_index = split_indices[page_index]; temp_slot_index < split_indices[page_index + 1]; temp_slot_index++) {
+            // Append the slot and pointed value.
+            slot = temp_slots[temp_slot_index];
+            slot.offset = PAGE_HEADER_SIZE + SLOT_SIZE * new_leaf_page->header.number_of_keys + new_leaf_page->header.amount_of_free_space - slot.size;
+            new_leaf_page->slots[new_leaf_page->header.number_of_keys] = slot;
+            memcpy(&new_leaf_page->values[VALUE_OFFSET(slot.offset)], temp_values[temp_slot_index], slot.size);
+            // Modify the metadata.
+            new_leaf_page->header.number_of_keys++;
+            new_leaf_page->header.amount_of_free_space -= (SLOT_SIZE + slot.size);
+        }
+
+        if (page_index > 0)
+            buffer_release_page(new_leaf_bufnum, true);
+    }
+    // Release the leaf page. Write.
+    buffer_release_page(leaf_bufnum, true);
+
+    // VI. Insert the new leaf pages into the parent, from the left.
+    // A new page goes next to its left page, which may be moved by the split of the parent.
+    // The path to the left page is found by the descent for its first key, already in the parent.
+    for (page_index = 1; page_index < number_of_pages; page_index++) {
+        if (page_index > 1)
+            find_leaf_path(table_id, file_get_root_pagenum(table_id), temp_slots[split_indices[page_index - 1]].key, path);
+        insert_into_parent_page(table_id, path, temp_slots[split_indices[page_index]].key, new_leaf_pagenums[page_index]);
+    }
+
+    if (verbose) {
+        printf("|");
+    }
+
+    return number_of_pages - 1;
 }
 
 // Deletion
@@ -722,11 +1066,9 @@ int remove_entry_from_leaf_page(table_id_t table_id, pagenum_t leaf_pagenum, pag
     buffer_request_page(table_id, leaf_pagenum, leaf_page, &leaf_bufnum);
 
     // Find the deletion index of the slot containing the key.
-    for (deletion_index = 0; deletion_index < leaf_page->header.number_of_keys; deletion_index++)
-        if (key == leaf_page->slots[deletion_index].key) {
-            removed_slot = leaf_page->slots[deletion_index];
-            break;
-        }
+    // The caller has checked that the key exists.
+    deletion_index = search_slots(leaf_page->slots, leaf_page->header.number_of_keys, key);
+    removed_slot = leaf_page->slots[deletion_index];
     
     // Remove the slot. Move all data behind the deletion index.
     for (slot_index = deletion_index + 1; slot_index < leaf_page->header.number_of_keys; slot_index++) 
@@ -768,9 +1110,7 @@ int remove_entry_from_internal_page(table_id_t table_id, pagenum_t internal_page
     buffer_request_page(table_id, internal_pagenum, internal_page, &internal_bufnum);
 
     // Find the deltion index of the branch containing the key.
-    for (deletion_index = 0; deletion_index < internal_page->header.number_of_keys; deletion_index++)
-        if (key == internal_page->branchs[deletion_index].key)
-            break;
+    deletion_index = search_branchs_exact(internal_page->branchs, internal_page->header.number_of_keys, key);
     
     // TODO: maybe there will be change of this implementation.. one argu will be added: branch_pagenum
     // Remove the branch. Move all data behind the deletion index.
@@ -791,9 +1131,8 @@ int remove_entry_from_internal_page(table_id_t table_id, pagenum_t internal_page
 
 int adjust_root_page(table_id_t table_id, pagenum_t root_pagenum) {
 
-    int root_bufnum, new_root_bufnum, header_bufnum;
-    node_page_t* root_page, *new_root_page;
-    header_page_t* header_page;
+    int root_bufnum;
+    node_page_t* root_page;
     pagenum_t new_root_pagenum = 0;
 
     if (verbose) {
@@ -803,7 +1142,7 @@ int adjust_root_page(table_id_t table_id, pagenum_t root_pagenum) {
     }
 
     // Request the root page.
-    buffer_request_page(table_id, root_pagenum, root_page, &root_bufnum);
+    buffer_request_page(table_id, root_pagenum, root_page, &root_bufnum, kLatchShared);
 
     // I. nonempty root.
     if (root_page->header.number_of_keys > 0) {
@@ -823,15 +1162,8 @@ int adjust_root_page(table_id_t table_id, pagenum_t root_pagenum) {
         buffer_release_page(root_bufnum, false);
         buffer_free_page(table_id, root_pagenum);
 
-        // Update the metadata in the header page. (Read, modify, write)
-        buffer_request_page(table_id, 0, header_page, &header_bufnum);
-        header_page->root_pagenum = new_root_pagenum;
-        buffer_release_page(header_bufnum, true);
-
-        // Update the metadata in the new root_page. (Read, modify, write)
-        buffer_request_page(table_id, new_root_pagenum, new_root_page, &new_root_bufnum);
-        new_root_page->header.parent_pagenum = 0;
-        buffer_release_page(new_root_bufnum, true);
+        // Update the metadata in the header page.
+        file_set_root_pagenum(table_id, new_root_pagenum);
 
     }
     // III. empty root, it is leaf (has no child).
@@ -842,10 +1174,8 @@ int adjust_root_page(table_id_t table_id, pagenum_t root_pagenum) {
         buffer_release_page(root_bufnum, false);
         buffer_free_page(table_id, root_pagenum);
 
-        // Update the metadata in the header pag e. (Read, modify, write)
-        buffer_request_page(table_id, 0, header_page, &header_bufnum);
-        header_page->root_pagenum = 0;
-        buffer_release_page(header_bufnum, true);
+        // Update the metadata in the header page.
+        file_set_root_pagenum(table_id, 0);
 
     }
 
@@ -858,14 +1188,15 @@ int adjust_root_page(table_id_t table_id, pagenum_t root_pagenum) {
     return OP_SUCCESS;
 }
 
-int coalesce_leaf_pages(table_id_t table_id, pagenum_t leaf_pagenum, pagenum_t neighbor_pagenum, page::key_t key_between_two) {
+int coalesce_leaf_pages(table_id_t table_id, std::vector<pagenum_t>& path, pagenum_t neighbor_pagenum, page::key_t key_between_two) {
 
     int leaf_bufnum, neighbor_bufnum, temp_bufnum;
     node_page_t *leaf_page, *neighbor_page;
-    pagenum_t temp_pagenum;
+    pagenum_t leaf_pagenum, temp_pagenum;
     int appending_index, neighbor_index, leaf_index;
     slot_t temp_slot;
-    pagenum_t parent_pagenum;
+
+    leaf_pagenum = path.back();
 
     if (verbose) {
         printf("\n|coalesce_leaf_pages(nei -key- leaf) %ld -%ld- %ld \n", neighbor_pagenum, key_between_two, leaf_pagenum);
@@ -922,9 +1253,6 @@ int coalesce_leaf_pages(table_id_t table_id, pagenum_t leaf_pagenum, pagenum_t n
         getchar();
     }
 
-    // Get the parent page number.
-    parent_pagenum = leaf_page->header.parent_pagenum;
-
     // Release and free the leaf page.
     buffer_release_page(leaf_bufnum, false);
 
@@ -946,19 +1274,20 @@ int coalesce_leaf_pages(table_id_t table_id, pagenum_t leaf_pagenum, pagenum_t n
         printf("->");
     }
 
-    // Delete the key pointing the leaf page in the parent page.
-    return delete_entry_in_page(table_id, parent_pagenum, 0, key_between_two);
+    // Delete the key pointing the leaf page in the parent page, the next page on the path.
+    path.pop_back();
+    return delete_entry_in_page(table_id, path, 0, key_between_two);
 }
 
 
-int coalesce_internal_pages(table_id_t table_id, pagenum_t internal_pagenum, pagenum_t neighbor_pagenum, page::key_t key_between_two) {
+int coalesce_internal_pages(table_id_t table_id, std::vector<pagenum_t>& path, pagenum_t neighbor_pagenum, page::key_t key_between_two) {
     
-    int internal_bufnum, neighbor_bufnum, temp_bufnum, branch_bufnum;
+    int internal_bufnum, neighbor_bufnum, temp_bufnum;
     node_page_t *internal_page, *neighbor_page;
-    pagenum_t temp_pagenum;
+    pagenum_t internal_pagenum, temp_pagenum;
     int appending_index, neighbor_index, internal_index;
-    node_page_t *branch_page;
-    pagenum_t parent_pagenum;
+
+    internal_pagenum = path.back();
 
     if (verbose) {
         printf("\n|coalesce_internal_pages (nei -key- intern) %ld -%ld- %ld\n", neighbor_pagenum, key_between_two, internal_pagenum);
@@ -993,19 +1322,11 @@ int coalesce_internal_pages(table_id_t table_id, pagenum_t internal_pagenum, pag
     // Append key_pointg_internal_page and branch_first_pagenum.
     neighbor_page->branchs[appending_index].key = key_between_two;
     neighbor_page->branchs[appending_index].pagenum = internal_page->header.branch_first_pagenum;
-    // Update parent_pagenum of the moved branch. (Read, modify, write)
-    buffer_request_page(table_id, neighbor_page->branchs[appending_index].pagenum, branch_page, &branch_bufnum);
-    branch_page->header.parent_pagenum = neighbor_pagenum;
-    buffer_release_page(branch_bufnum, true);
     // Modify the metadata.
     neighbor_page->header.number_of_keys++;
     for (neighbor_index = appending_index + 1, internal_index = 0; internal_index < internal_page->header.number_of_keys; neighbor_index++, internal_index++) {
         // Append branch to neighbor_page.
         neighbor_page->branchs[neighbor_index] = internal_page->branchs[internal_index];
-        // Update parent_pagenum of moved branchs. (Read, modify, write)
-        buffer_request_page(table_id, neighbor_page->branchs[neighbor_index].pagenum, branch_page, &branch_bufnum);
-        branch_page->header.parent_pagenum = neighbor_pagenum;
-        buffer_release_page(branch_bufnum, true);
 
         // Modify the metadata in neighbor_page.
         neighbor_page->header.number_of_keys++;
@@ -1014,9 +1335,6 @@ int coalesce_internal_pages(table_id_t table_id, pagenum_t internal_pagenum, pag
     // Release the neighbor page. Write the neighbor page.
     buffer_release_page(neighbor_bufnum, true);
 
-    // Get the parent page number.
-    parent_pagenum = internal_page->header.parent_pagenum;
-
     // Release and free the internal page.
     buffer_release_page(internal_bufnum, false);
     buffer_free_page(table_id, internal_pagenum);
@@ -1027,19 +1345,26 @@ int coalesce_internal_pages(table_id_t table_id, pagenum_t internal_pagenum, pag
         printf("->");
     }
 
-    // Delete the key pointing the internal page in the parent page.
-    return delete_entry_in_page(table_id, parent_pagenum, 0, key_between_two);
+    // Delete the key pointing the internal page in the parent page, the next page on the path.
+    path.pop_back();
+    return delete_entry_in_page(table_id, path, 0, key_between_two);
 }
 
 // Move some entries from the neighbor page to the leaf page.
-int redistribute_leaf_pages(table_id_t table_id, pagenum_t leaf_pagenum, pagenum_t neighbor_pagenum, int branch_index_between_two) {
+int redistribute_leaf_pages(table_id_t table_id, const std::vector<pagenum_t>& path, pagenum_t neighbor_pagenum, int branch_index_between_two) {
 
     int leaf_bufnum, neighbor_bufnum, parent_bufnum;
     node_page_t *leaf_page, *neighbor_page;
-    pagenum_t parent_pagenum;
+    pagenum_t leaf_pagenum, parent_pagenum;
     node_page_t* parent_page;
     slot_t temp_slot;
     char* temp_value;
+    bool is_neighbor_left;
+    page::key_t key_between_two;
+
+    // The parent page is the one before the leaf page on the path.
+    leaf_pagenum = path.back();
+    parent_pagenum = path[path.size() - 2];
     
     if (verbose) {
         printf("\n|redistribute_leaf_pages(nei -idx- leaf) %ld -%d- %ld \n", neighbor_pagenum, branch_index_between_two, leaf_pagenum);
@@ -1049,53 +1374,44 @@ int redistribute_leaf_pages(table_id_t table_id, pagenum_t leaf_pagenum, pagenum
     }
 
     // Request the pages.
-    buffer_request_page(table_id, leaf_pagenum, leaf_page, &leaf_bufnum);
-    buffer_request_page(table_id, neighbor_pagenum, neighbor_page, &neighbor_bufnum);
+    buffer_request_page(table_id, leaf_pagenum, leaf_page, &leaf_bufnum, kLatchShared);
+    buffer_request_page(table_id, neighbor_pagenum, neighbor_page, &neighbor_bufnum, kLatchShared);
 
     // I. neighbor -branch- leaf
-    if (neighbor_page->slots[0].key < leaf_page->slots[0].key) {
-        // Pull some entries from the neighbor page to the leaf page.
-        while (leaf_page->header.amount_of_free_space >= THRESHOLD) {
-            // Insert the neighbor's last slots and pointed value into the leaf page.
-            temp_slot = neighbor_page->slots[neighbor_page->header.number_of_keys - 1];
-            temp_value = (char*)malloc(temp_slot.size);
-            memcpy(temp_value, &neighbor_page->values[VALUE_OFFSET(temp_slot.offset)], temp_slot.size);
-            insert_into_leaf_page(table_id, leaf_pagenum, temp_slot, temp_value);
-
-            // Remove the neighbor's last slots and pointed value in the neighbor page.
-            remove_entry_from_leaf_page(table_id, neighbor_pagenum, temp_slot.key);
-        }
-        
-        // Update the branch in the parent page. (Read, modify, write)
-        parent_pagenum = leaf_page->header.parent_pagenum;
-        buffer_request_page(table_id, parent_pagenum, parent_page, &parent_bufnum);
-        parent_page->branchs[branch_index_between_two].key = leaf_page->slots[0].key;
-        buffer_release_page(parent_bufnum, true);
-    }
     // II. leaf -branch- neighbor : leaf_pagenum == branch_first_pagenum in parent_page.
-    else {
-        // Pull some entries from the neighbor page to the leaf page.
-        while (leaf_page->header.amount_of_free_space >= THRESHOLD) {
-            // Insert the neighbor's first slots and pointed value into the leaf page.
-            temp_slot = neighbor_page->slots[0];
-            temp_value = (char*)malloc(temp_slot.size);
-            memcpy(temp_value, &neighbor_page->values[VALUE_OFFSET(temp_slot.offset)], temp_slot.size);
-            insert_into_leaf_page(table_id, leaf_pagenum, temp_slot, temp_value);
-
-            // Remove the neighbor's last slots and pointed value in the neighbor page.
-            remove_entry_from_leaf_page(table_id, neighbor_pagenum, temp_slot.key);
-        }
+    is_neighbor_left = (neighbor_page->slots[0].key < leaf_page->slots[0].key);
+
+    // Pull some entries from the neighbor page to the leaf page.
+    // The pages are latched again by insert_into_leaf_page() and remove_entry_from_leaf_page(). Release them before.
+    while (leaf_page->header.amount_of_free_space >= THRESHOLD) {
+        // Copy the neighbor's last (I) or first (II) slot and pointed value.
+        temp_slot = neighbor_page->slots[is_neighbor_left ? neighbor_page->header.number_of_keys - 1 : 0];
+        temp_value = (char*)malloc(temp_slot.size);
+        memcpy(temp_value, &neighbor_page->values[VALUE_OFFSET(temp_slot.offset)], temp_slot.size);
+        buffer_release_page(leaf_bufnum, false);
+        buffer_release_page(neighbor_bufnum, false);
 
-        // Update the branch in the parent page. (Read, modify, write)
-        parent_pagenum = leaf_page->header.parent_pagenum;
-        buffer_request_page(table_id, parent_pagenum, parent_page, &parent_bufnum);
-        parent_page->branchs[branch_index_between_two].key = neighbor_page->slots[0].key;
-        buffer_release_page(parent_bufnum, true);
+        // Insert them into the leaf page, and remove them in the neighbor page.
+        insert_into_leaf_page(table_id, leaf_pagenum, temp_slot, temp_value);
+        remove_entry_from_leaf_page(table_id, neighbor_pagenum, temp_slot.key);
+        free(temp_value);
+
+        // Renew the pages.
+        buffer_request_page(table_id, leaf_pagenum, leaf_page, &leaf_bufnum, kLatchShared);
+        buffer_request_page(table_id, neighbor_pagenum, neighbor_page, &neighbor_bufnum, kLatchShared);
     }
 
-    // Release and write the leaf and neighbor pages.
-    buffer_release_page(leaf_bufnum, true);
-    buffer_release_page(neighbor_bufnum, true);
+    // Get the new key between two pages, the first key of the right page.
+    key_between_two = is_neighbor_left ? leaf_page->slots[0].key : neighbor_page->slots[0].key;
+
+    // Release the leaf and neighbor pages.
+    buffer_release_page(leaf_bufnum, false);
+    buffer_release_page(neighbor_bufnum, false);
+
+    // Update the branch in the parent page. (Read, modify, write)
+    buffer_request_page(table_id, parent_pagenum, parent_page, &parent_bufnum);
+    parent_page->branchs[branch_index_between_two].key = key_between_two;
+    buffer_release_page(parent_bufnum, true);
 
     if (verbose) {
         printf("\tafter redist");
@@ -1107,14 +1423,18 @@ int redistribute_leaf_pages(table_id_t table_id, pagenum_t leaf_pagenum, pagenum
     return OP_SUCCESS;    
 }
 
-int redistribute_internal_pages(table_id_t table_id, pagenum_t internal_pagenum, pagenum_t neighbor_pagenum, int branch_index_between_two) {
+int redistribute_internal_pages(table_id_t table_id, const std::vector<pagenum_t>& path, pagenum_t neighbor_pagenum, int branch_index_between_two) {
     
-    int internal_bufnum, neighbor_bufnum, parent_bufnum, branch_bufnum;
+    int internal_bufnum, neighbor_bufnum, parent_bufnum;
     node_page_t *internal_page, *neighbor_page;
-    pagenum_t parent_pagenum;
-    node_page_t *parent_page, *branch_page;
+    pagenum_t internal_pagenum, parent_pagenum;
+    node_page_t *parent_page;
     int neighbor_index, internal_index;
 
+    // The parent page is the one before the internal page on the path.
+    internal_pagenum = path.back();
+    parent_pagenum = path[path.size() - 2];
+
     if (verbose) {
         printf("\n|redistribute_internal_pages(nei -idx- leaf) %ld -%d- %ld \n", neighbor_pagenum, branch_index_between_two, internal_pagenum);
         printf("\n\tbefore redist");
@@ -1127,7 +1447,6 @@ int redistribute_internal_pages(table_id_t table_id, pagenum_t internal_pagenum,
     buffer_request_page(table_id, neighbor_pagenum, neighbor_page, &neighbor_bufnum);
 
     // Read the parent page.
-    parent_pagenum = internal_page->header.parent_pagenum;
     buffer_request_page(table_id, parent_pagenum, parent_page, &parent_bufnum);
 
     // I. neighbor -branch- internal
@@ -1146,10 +1465,6 @@ int redistribute_internal_pages(table_id_t table_id, pagenum_t internal_pagenum,
 
         // Pull a pagenum neighbor -> internal.
         internal_page->header.branch_first_pagenum = neighbor_page->branchs[neighbor_page->header.number_of_keys - 1].pagenum;
-        // Update parent_pagenum of moved pagenum. (Read, modify, write)
-        buffer_request_page(table_id, internal_page->header.branch_first_pagenum, branch_page, &branch_bufnum);
-        branch_page->header.parent_pagenum = internal_pagenum;
-        buffer_release_page(branch_bufnum, true);
 
         // Modify the metadata in internal_page.
         internal_page->header.number_of_keys++;
@@ -1167,10 +1482,6 @@ int redistribute_internal_pages(table_id_t table_id, pagenum_t internal_pagenum,
 
         // Pull a pagenum internal <- neighbor.
         internal_page->branchs[internal_page->header.number_of_keys].pagenum = neighbor_page->header.branch_first_pagenum;
-        // Update parent_pagenum of moved pagenum. (Read, modify, write)
-        buffer_request_page(table_id, internal_page->branchs[internal_page->header.number_of_keys].pagenum, branch_page, &branch_bufnum);
-        branch_page->header.parent_pagenum = internal_pagenum;
-        buffer_release_page(branch_bufnum, true);
 
         // Modify the metadata in internal_page.
         internal_page->header.number_of_keys++;
@@ -1199,17 +1510,18 @@ int redistribute_internal_pages(table_id_t table_id, pagenum_t internal_pagenum,
 }
 
 // Delete the key in the page.
-int delete_entry_in_page(table_id_t table_id, pagenum_t pagenum, int is_leaf, page::key_t key) {
+int delete_entry_in_page(table_id_t table_id, std::vector<pagenum_t>& path, int is_leaf, page::key_t key) {
 
-    int bufnum, header_bufnum, neighbor_bufnum, parent_bufnum;
+    int bufnum, neighbor_bufnum, parent_bufnum;
     node_page_t *page;
-    header_page_t *header_page;
-    pagenum_t root_pagenum;
+    pagenum_t pagenum;
     pagenum_t neighbor_pagenum, parent_pagenum;
     node_page_t *neighbor_page, *parent_page;
     int branch_index, branch_index_between_two;
     page::key_t key_between_two;
 
+    pagenum = path.back();
+
     if (verbose) {
         printf("\n|delete_entry_in_page %ld in %ld ", key, pagenum);
     }
@@ -1219,18 +1531,13 @@ int delete_entry_in_page(table_id_t table_id, pagenum_t pagenum, int is_leaf, pa
     else 
         remove_entry_from_internal_page(table_id, pagenum, key);
     
-    // Get the root page number from the header page.
-    buffer_request_page(table_id, 0, header_page, &header_bufnum);
-    root_pagenum = header_page->root_pagenum;
-    buffer_release_page(header_bufnum, false);
-
-    // I. the page is root page.
-    if (pagenum == root_pagenum) 
-        return adjust_root_page(table_id, root_pagenum);
+    // I. the page is root page, the first page of the path.
+    if (path.size() == 1) 
+        return adjust_root_page(table_id, pagenum);
 
     // II. the page is not the root page. (nothing | merge | redistribution)
     // Request the page.
-    buffer_request_page(table_id, pagenum, page, &bufnum);
+    buffer_request_page(table_id, pagenum, page, &bufnum, kLatchShared);
 
     // II-1. The page is a leaf page.
     if (is_leaf == 1) {
@@ -1242,9 +1549,9 @@ int delete_entry_in_page(table_id_t table_id, pagenum_t pagenum, int is_leaf, pa
         }
         // ii. free_space >= threshold, structure modification needed.
         else {
-            // Request the parent page for getting neighbor_pagenum.
-            parent_pagenum = page->header.parent_pagenum;
-            buffer_request_page(table_id, parent_pagenum, parent_page, &parent_bufnum);
+            // Request the parent page for getting neighbor_pagenum. It is the one before the page on the path.
+            parent_pagenum = path[path.size() - 2];
+            buffer_request_page(table_id, parent_pagenum, parent_page, &parent_bufnum, kLatchShared);
 
             // Get the neighbor page number. (left branch pagenum except the case the page is leftmost page.)
             if (pagenum == parent_page->header.branch_first_pagenum) {
@@ -1267,21 +1574,21 @@ int delete_entry_in_page(table_id_t table_id, pagenum_t pagenum, int is_leaf, pa
             buffer_release_page(parent_bufnum, false);
 
             // Reqest the neighbor page.
-            buffer_request_page(table_id, neighbor_pagenum, neighbor_page, &neighbor_bufnum);
+            buffer_request_page(table_id, neighbor_pagenum, neighbor_page, &neighbor_bufnum, kLatchShared);
             
             // ii-1. Merge
             if ((INITIAL_FREE_SPACE - page->header.amount_of_free_space) + (INITIAL_FREE_SPACE - neighbor_page->header.amount_of_free_space) <= INITIAL_FREE_SPACE) {
                 // Release the pages.
                 buffer_release_page(bufnum, false);
                 buffer_release_page(neighbor_bufnum, false);
-                return coalesce_leaf_pages(table_id, pagenum, neighbor_pagenum, key_between_two);
+                return coalesce_leaf_pages(table_id, path, neighbor_pagenum, key_between_two);
             }
             // ii-2. Redistribute
             else {
                 // Release the pages.
                 buffer_release_page(bufnum, false);
                 buffer_release_page(neighbor_bufnum, false);
-                return redistribute_leaf_pages(table_id, pagenum, neighbor_pagenum, branch_index_between_two);
+                return redistribute_leaf_pages(table_id, path, neighbor_pagenum, branch_index_between_two);
             }
         }
     }
@@ -1295,9 +1602,9 @@ int delete_entry_in_page(table_id_t table_id, pagenum_t pagenum, int is_leaf, pa
         }
         // ii. few keys, structure modification needed.
         else {
-            // Request the parent page for getting neighbor_pagenum.
-            parent_pagenum = page->header.parent_pagenum;
-            buffer_request_page(table_id, parent_pagenum, parent_page, &parent_bufnum);
+            // Request the parent page for getting neighbor_pagenum. It is the one before the page on the path.
+            parent_pagenum = path[path.size() - 2];
+            buffer_request_page(table_id, parent_pagenum, parent_page, &parent_bufnum, kLatchShared);
 
             // Get the neighbor page number. (left branch pagenum except the case the page is leftmost page.)
             if (pagenum == parent_page->header.branch_first_pagenum) {
@@ -1320,7 +1627,7 @@ int delete_entry_in_page(table_id_t table_id, pagenum_t pagenum, int is_leaf, pa
             buffer_release_page(parent_bufnum, false);
 
             // Reqest the neighbor page.
-            buffer_request_page(table_id, neighbor_pagenum, neighbor_page, &neighbor_bufnum);
+            buffer_request_page(table_id, neighbor_pagenum, neighbor_page, &neighbor_bufnum, kLatchShared);
 
             // ii-1. Merge
             // If merged, the key between two pages will be appended. Therefore -1.
@@ -1328,14 +1635,14 @@ int delete_entry_in_page(table_id_t table_id, pagenum_t pagenum, int is_leaf, pa
                 // Release the pages.
                 buffer_release_page(bufnum, false);
                 buffer_release_page(neighbor_bufnum, false);
-                return coalesce_internal_pages(table_id, pagenum, neighbor_pagenum, key_between_two);
+                return coalesce_internal_pages(table_id, path, neighbor_pagenum, key_between_two);
             }
             // ii-2. Redistribute
             else {
                 // Release the pages.
                 buffer_release_page(bufnum, false);
                 buffer_release_page(neighbor_bufnum, false);
-                return redistribute_internal_pages(table_id, pagenum, neighbor_pagenum, branch_index_between_two);
+                return redistribute_internal_pages(table_id, path, neighbor_pagenum, branch_index_between_two);
             }
         }
     }
@@ -1343,11 +1650,10 @@ int delete_entry_in_page(table_id_t table_id, pagenum_t pagenum, int is_leaf, pa
 
 int db_delete(int64_t table_id, int64_t key) {
 
-    int header_bufnum, leaf_bufnum;
-    header_page_t* header_page;
+    int leaf_bufnum;
     pagenum_t root_pagenum, leaf_pagenum;
+    std::vector<pagenum_t> path;
     node_page_t* leaf_page;
-    int slot_index;
     bool delete_flag = false;
 
     if (verbose) {
@@ -1358,25 +1664,20 @@ int db_delete(int64_t table_id, int64_t key) {
         return OP_FAILURE;
 
     // Get the root page number from the header page.
-    buffer_request_page(table_id, 0, header_page, &header_bufnum);
-    root_pagenum = header_page->root_pagenum;
-    buffer_release_page(header_bufnum, false);
+    root_pagenum = file_get_root_pagenum(table_id);
 
-    // Get the leaf page number which may contain the key.
-    leaf_pagenum = find_leaf_pagenum(table_id, root_pagenum, key);
+    // Get the leaf page number which may contain the key, and the path to it.
+    leaf_pagenum = find_leaf_path(table_id, root_pagenum, key, path);
 
     // I. the tree does not exist.
     if (leaf_pagenum == 0)
         return OP_FAILURE;
     
     // Request the leaf page.
-    buffer_request_page(table_id, leaf_pagenum, leaf_page, &leaf_bufnum);
+    buffer_request_page(table_id, leaf_pagenum, leaf_page, &leaf_bufnum, kLatchShared);
     // Find the key in the tree.
-    for (slot_index = 0; slot_index < leaf_page->header.number_of_keys; slot_index++)
-        if (key == leaf_page->slots[slot_index].key) {
-            delete_flag = true;
-            break;
-        }
+    if (search_slots(leaf_page->slots, leaf_page->header.number_of_keys, key) >= 0)
+        delete_flag = true;
     // Release the leaf page. 
     buffer_release_page(leaf_bufnum, false);   
 
@@ -1393,22 +1694,306 @@ int db_delete(int64_t table_id, int64_t key) {
     if (delete_flag == false)
         return OP_FAILURE;
     // III. the key exists in the tree.
-    else 
-        return delete_entry_in_page(table_id, leaf_pagenum, 1, key);
+    // The remembered leaf page may be freed by the deletion. Forget it.
+    append_set_leaf_pagenum(table_id, 0, 0);
+    return delete_entry_in_page(table_id, path, 1, key);
+}
+
+// Bulk load
+int db_bulk_load(int64_t table_id, bulk_load_next_t next, void* arg, int fill_percent) {
+
+    bulk_load_t loader;
+    bulk_load_level_t* level;
+    page::key_t key, last_key = 0;
+    char value[INITIAL_FREE_SPACE];
+    uint16_t val_size;
+    uint64_t number_of_records = 0;
+    pagenum_t root_pagenum;
+    int64_t LSN;
+    bool is_failed = false;
+    int i;
+
+    if (verbose) {
+        printf("|db_bulk_load");
+    }
+
+    // Check the table_id is valid, and the table is empty.
+    if (file_is_valid_table_id(table_id) == false || file_get_root_pagenum(table_id) != 0)
+        return OP_FAILURE;
+    if (fill_percent <= 0 || fill_percent > 100)
+        return OP_FAILURE;
+
+    append_set_leaf_pagenum(table_id, 0, 0);
+    loader.table_id = table_id;
+    loader.leaf_fill = std::max(BULK_LOAD_MIN_LEAF_FILL, INITIAL_FREE_SPACE * fill_percent / 100);
+    loader.internal_fill = std::max(2, (ORDER - 1) * fill_percent / 100);
+    loader.batch_size = 0;
+    loader.batch = (page_t*)aligned_alloc(PAGE_SIZE, (size_t)PAGE_SIZE * BULK_LOAD_BATCH_PAGES);
+    if (loader.batch == NULL) {
+        perror("Memory allocation error");
+        exit(EXIT_FAILURE);
+    }
+
+    // I. Fill the leaf pages in the order of the input, and the internal pages as their children are filled.
+    while (next(arg, &key, value, &val_size) == 0) {
+        // Not sorted, or too large for a leaf page.
+        if ((number_of_records > 0 && key <= last_key) || SLOT_SIZE + val_size > loader.leaf_fill) {
+            is_failed = true;
+            break;
+        }
+        bulk_load_append_record(&loader, key, value, val_size);
+        last_key = key;
+        number_of_records++;
+    }
+
+    // II. Failed. Drop the pages.
+    if (is_failed == true) {
+        loader.batch_size = 0;
+        for (i = 0; i < (int)loader.pagenums.size(); i++)
+            buffer_free_page(table_id, loader.pagenums[i]);
+        root_pagenum = INVALID_PAGENUM;
+    }
+    // III. Complete the upper levels, and force the pages before the log.
+    else {
+        root_pagenum = number_of_records > 0 ? bulk_load_finish(&loader) : 0;
+        bulk_load_flush(&loader);
+        if (root_pagenum != 0) {
+            file_sync_table_file(table_id);
+            file_set_root_pagenum(table_id, root_pagenum);
+            LSN = log_create(kBulkLoad, table_id, root_pagenum, number_of_records);
+            log_flush(LSN);
+        }
+    }
+
+    for (i = 0; i < (int)loader.levels.size(); i++) {
+        level = &loader.levels[i];
+        free(level->page);
+        free(level->pending_page);
+    }
+    free(loader.batch);
+
+    if (verbose) {
+        printf("(records: %ld, pages: %ld, root: %ld)|", number_of_records, loader.pagenums.size(), root_pagenum);
+    }
+
+    return root_pagenum == INVALID_PAGENUM ? OP_FAILURE : OP_SUCCESS;
 }
 
-int init_db(int num_buf, int flag, int log_num, char* log_path, char* logmsg_path) {
-    buffer_init(num_buf);
-    file_init();
+pagenum_t bulk_load_alloc_page(bulk_load_t* loader) {
+    pagenum_t pagenum;
+
+    // Next to the last page, so that the pages are contiguous.
+    pagenum = file_alloc_page(loader->table_id, loader->pagenums.empty() == true ? 0 : loader->pagenums.back());
+    loader->pagenums.push_back(pagenum);
+    return pagenum;
+}
+
+void bulk_load_init_page(node_page_t* page, int is_leaf) {
+    memset(page, 0, PAGE_SIZE);
+    page->header.is_leaf = is_leaf;
+    page->header.number_of_keys = 0;
+    page->header.amount_of_free_space = INITIAL_FREE_SPACE;
+}
+
+void bulk_load_append_record(bulk_load_t* loader, page::key_t key, char* value, uint16_t val_size) {
+    bulk_load_level_t* leaf_level;
+    node_page_t* leaf_page;
+    pagenum_t new_leaf_pagenum;
+    slot_t slot;
+
+    // The first record.
+    if (loader->levels.empty() == true) {
+        loader->levels.resize(1);
+        leaf_level = &loader->levels[0];
+        leaf_level->page = (node_page_t*)aligned_alloc(PAGE_SIZE, PAGE_SIZE);
+        leaf_level->pending_page = NULL;
+        if (leaf_level->page == NULL) {
+            perror("Memory allocation error");
+            exit(EXIT_FAILURE);
+        }
+        leaf_level->pagenum = bulk_load_alloc_page(loader);
+        leaf_level->pending_pagenum = 0;
+        bulk_load_init_page(leaf_level->page, 1);
+        leaf_level->low_key = key;
+    }
+    leaf_level = &loader->levels[0];
+    leaf_page = leaf_level->page;
+
+    // The leaf page is filled. Pass it to the parent, and start the right sibling.
+    if (INITIAL_FREE_SPACE - (int)leaf_page->header.amount_of_free_space + SLOT_SIZE + val_size > loader->leaf_fill) {
+        new_leaf_pagenum = bulk_load_alloc_page(loader);
+        leaf_page->header.right_sibling_pagenum = new_leaf_pagenum;
+        bulk_load_append_child(loader, 1, leaf_level->low_key, leaf_level->pagenum, leaf_page);
+
+        leaf_level = &loader->levels[0];
+        leaf_page = leaf_level->page;
+        leaf_level->pagenum = new_leaf_pagenum;
+        bulk_load_init_page(leaf_page, 1);
+        leaf_level->low_key = key;
+    }
+
+    // Append the slot and value. The values are placed from the end of the page.
+    slot = make_slot(key, val_size);
+    slot.trx_id = 0;
+    slot.offset = PAGE_HEADER_SIZE + SLOT_SIZE * leaf_page->header.number_of_keys + leaf_page->header.amount_of_free_space - slot.size;
+    leaf_page->slots[leaf_page->header.number_of_keys] = slot;
+    memcpy(&leaf_page->values[VALUE_OFFSET(slot.offset)], value, slot.size);
+    // Modify the metadata.
+    leaf_page->header.number_of_keys++;
+    leaf_page->header.amount_of_free_space -= (SLOT_SIZE + slot.size);
+}
+
+void bulk_load_append_child(bulk_load_t* loader, int level_num, page::key_t low_key, pagenum_t child_pagenum, node_page_t* child_page) {
+    bulk_load_level_t* level;
+    node_page_t* temp_page;
+
+    // A new level above the others.
+    if (level_num == (int)loader->levels.size()) {
+        loader->levels.resize(level_num + 1);
+        level = &loader->levels[level_num];
+        level->page = (node_page_t*)aligned_alloc(PAGE_SIZE, PAGE_SIZE);
+        level->pending_page = (node_page_t*)aligned_alloc(PAGE_SIZE, PAGE_SIZE);
+        if (level->page == NULL || level->pending_page == NULL) {
+            perror("Memory allocation error");
+            exit(EXIT_FAILURE);
+        }
+        level->pagenum = 0;
+        level->pending_pagenum = 0;
+    }
+    level = &loader->levels[level_num];
+
+    // I. Start the first internal page of the level.
+    if (level->pagenum == 0) {
+        level->pagenum = bulk_load_alloc_page(loader);
+        bulk_load_init_page(level->page, 0);
+        level->page->header.branch_first_pagenum = child_pagenum;
+        level->low_key = low_key;
+    }
+    // II. The internal page is filled. Keep it pending, and start the next one.
+    else if (level->page->header.number_of_keys == loader->internal_fill) {
+        temp_page = level->pending_page;
+        level->pending_page = level->page;
+        level->pending_pagenum = level->pagenum;
+        level->pending_low_key = level->low_key;
+
+        level->page = temp_page;
+        level->pagenum = bulk_load_alloc_page(loader);
+        bulk_load_init_page(level->page, 0);
+        level->page->header.branch_first_pagenum = child_pagenum;
+        level->low_key = low_key;
+    }
+    // III. Append the branch.
+    else {
+        level->page->branchs[level->page->header.number_of_keys].key = low_key;
+        level->page->branchs[level->page->header.number_of_keys].pagenum = child_pagenum;
+        level->page->header.number_of_keys++;
+    }
+
+    // Write the child.
+    bulk_load_write_page(loader, child_pagenum, child_page);
+
+    // The page being filled has a key. Pass the pending page to the parent.
+    if (level->pending_pagenum != 0 && level->page->header.number_of_keys > 0) {
+        bulk_load_append_child(loader, level_num + 1, level->pending_low_key, level->pending_pagenum, level->pending_page);
+        level = &loader->levels[level_num];
+        level->pending_pagenum = 0;
+    }
+}
+
+pagenum_t bulk_load_finish(bulk_load_t* loader) {
+    bulk_load_level_t* level;
+    node_page_t* pending_page;
+    node_page_t* page;
+    branch_t moved_branch;
+    pagenum_t root_pagenum = 0;
+    int level_num;
+
+    // I. The last leaf page.
+    level = &loader->levels[0];
+    level->page->header.right_sibling_pagenum = 0;
+    if (loader->levels.size() == 1) {
+        // The only leaf page is the root.
+        bulk_load_write_page(loader, level->pagenum, level->page);
+        return level->pagenum;
+    }
+    bulk_load_append_child(loader, 1, level->low_key, level->pagenum, level->page);
+
+    // II. The internal levels from the bottom. A level may be added above while completing.
+    for (level_num = 1; level_num < (int)loader->levels.size(); level_num++) {
+        level = &loader->levels[level_num];
+        page = level->page;
+
+        // i. The last page has only one branch. Move the last branch of the pending page to it.
+        if (level->pending_pagenum != 0) {
+            pending_page = level->pending_page;
+            moved_branch = pending_page->branchs[pending_page->header.number_of_keys - 1];
+            pending_page->header.number_of_keys--;
+
+            page->branchs[0].key = level->low_key;
+            page->branchs[0].pagenum = page->header.branch_first_pagenum;
+            page->header.branch_first_pagenum = moved_branch.pagenum;
+            page->header.number_of_keys = 1;
+            level->low_key = moved_branch.key;
+
+            bulk_load_append_child(loader, level_num + 1, level->pending_low_key, level->pending_pagenum, level->pending_page);
+            level = &loader->levels[level_num];
+            level->pending_pagenum = 0;
+        }
+
+        // ii. The only page of the top level is the root.
+        if (level_num + 1 == (int)loader->levels.size()) {
+            bulk_load_write_page(loader, level->pagenum, level->page);
+            root_pagenum = level->pagenum;
+        }
+        // iii. Pass the last page to the parent.
+        else {
+            bulk_load_append_child(loader, level_num + 1, level->low_key, level->pagenum, level->page);
+        }
+    }
+
+    return root_pagenum;
+}
+
+void bulk_load_write_page(bulk_load_t* loader, pagenum_t pagenum, node_page_t* page) {
+    if (loader->batch_size == BULK_LOAD_BATCH_PAGES)
+        bulk_load_flush(loader);
+
+    memcpy(&loader->batch[loader->batch_size], page, PAGE_SIZE);
+    loader->ios[loader->batch_size].table_id = loader->table_id;
+    loader->ios[loader->batch_size].pagenum = pagenum;
+    loader->ios[loader->batch_size].page = &loader->batch[loader->batch_size];
+    loader->batch_size++;
+}
+
+void bulk_load_flush(bulk_load_t* loader) {
+    int i;
+
+    // Write the pages first. A frame loaded (prefetched while free) before that is dropped.
+    file_write_pages(loader->ios, loader->batch_size);
+    for (i = 0; i < loader->batch_size; i++)
+        buffer_discard_page(loader->table_id, loader->ios[i].pagenum);
+    loader->batch_size = 0;
+}
+
+int init_db(int num_buf, int flag, int log_num, char* log_path, char* logmsg_path, int num_buf_instances, ReplacementPolicy replacement_policy, IOBackendType io_backend, bool direct_io) {
+    search_init();
+    buffer_init(num_buf, num_buf_instances, replacement_policy);
+    file_init(io_backend, direct_io);
     trx_init();
     log_init(flag, log_num, log_path, logmsg_path);
 
+    pthread_mutex_lock(&append_latch);
+    append_hints.clear();
+    pthread_mutex_unlock(&append_latch);
+
     verbose = false;
     verbose2 = false;
     return OP_SUCCESS;
 }
 int shutdown_db(void) {
+    log_checkpointer_stop();
     buffer_close_table_files();
+    log_shutdown();
     file_close_table_files();
 
     return OP_SUCCESS;
@@ -1420,9 +2005,9 @@ void print_page(table_id_t table_id, pagenum_t pagenum) {
     node_page_t* page;
     int i;
 
-    buffer_request_page(table_id, pagenum, page, &bufnum);
+    buffer_request_page(table_id, pagenum, page, &bufnum, kLatchShared);
     
-    printf("\n[page %ld buffer %d]-------num_keys: %d----------parent_pn: %ld-----------\n", pagenum, bufnum, page->header.number_of_keys, page->header.parent_pagenum);
+    printf("\n[page %ld buffer %d]-------num_keys: %d-----------\n", pagenum, bufnum, page->header.number_of_keys);
     if (pagenum <= 0 || bufnum == INVALID_BUFNUM) {
         printf("(wrong pn or bn");
         getchar();
@@ -1448,23 +2033,20 @@ void print_page(table_id_t table_id, pagenum_t pagenum) {
 
 int64_t get_root_pagenum(int64_t table_id) {
     
-    int header_bufnum;
-    header_page_t *header_page;
     pagenum_t root_pagenum;
 
-    buffer_request_page(table_id, 0, header_page, &header_bufnum);
-    root_pagenum = header_page->root_pagenum;
-    buffer_release_page(header_bufnum, false);
+    root_pagenum = file_get_root_pagenum(table_id);
 
     return root_pagenum;    
 }
 
 // Project 5 APIs
 pagenum_t find_leaf_pagenum(table_id_t table_id, pagenum_t root_pagenum, page::key_t key, int trx_id) {
-    int branch_index;
+    int branch_index, number_of_locks;
     int node_bufnum;
     node_page_t* node_page;
     pagenum_t node_pagenum = root_pagenum;
+    page::key_t lock_keys[ORDER - 1];
 
     if (verbose)
         printf(" |find_leaf_pagenum");
@@ -1474,24 +2056,28 @@ pagenum_t find_leaf_pagenum(table_id_t table_id, pagenum_t root_pagenum, page::k
         return 0;
     
     // Request the root page.
-    buffer_request_page(table_id, root_pagenum, node_page, &node_bufnum);
+    buffer_request_page(table_id, root_pagenum, node_page, &node_bufnum, kLatchShared);
     
     // Find the leaf page which may contain the key.
     while (node_page->header.is_leaf == 0) {
-        // Find the child page number which may contain the key.
-        for (branch_index = 0; branch_index < node_page->header.number_of_keys; branch_index++) {
-            buffer_release_page(node_bufnum, false);
-            if (lock_acquire(table_id, node_pagenum, node_page->branchs[branch_index].key, trx_id, kLockShared) == NULL) {
+        // Lock the keys in order, up to the first key greater than the key.
+        branch_index = search_branchs(node_page->branchs, node_page->header.number_of_keys, key);
+        number_of_locks = std::min(branch_index + 1, node_page->header.number_of_keys);
+        for (branch_index = 0; branch_index < number_of_locks; branch_index++)
+            lock_keys[branch_index] = node_page->branchs[branch_index].key;
+        buffer_release_page(node_bufnum, false);
+        for (branch_index = 0; branch_index < number_of_locks; branch_index++) {
+            if (lock_acquire(table_id, node_pagenum, lock_keys[branch_index], trx_id, kLockShared) == NULL) {
                 if (trx_abort(trx_id) != trx_id) {
                     return OP_FAILURE;
                 }
                 return OP_FAILURE;
             }
-            buffer_request_page(table_id, node_pagenum, node_page, &node_bufnum);
-            if (key < node_page->branchs[branch_index].key) 
-                break;
         }
-        branch_index--;
+        buffer_request_page(table_id, node_pagenum, node_page, &node_bufnum, kLatchShared);
+
+        // Find the child page number which may contain the key.
+        branch_index = search_branchs(node_page->branchs, node_page->header.number_of_keys, key) - 1;
         if (branch_index == -1)
             node_pagenum = node_page->header.branch_first_pagenum;
         else
@@ -1501,7 +2087,7 @@ pagenum_t find_leaf_pagenum(table_id_t table_id, pagenum_t root_pagenum, page::k
         buffer_release_page(node_bufnum, false);
 
         // Request the child page.
-        buffer_request_page(table_id, node_pagenum, node_page, &node_bufnum);
+        buffer_request_page(table_id, node_pagenum, node_page, &node_bufnum, kLatchShared);
 
     }
 
@@ -1519,9 +2105,8 @@ pagenum_t find_leaf_pagenum(table_id_t table_id, pagenum_t root_pagenum, page::k
 // The caller must allocate ret_val and val_size.
 int db_find(table_id_t table_id, int64_t key, char *ret_val, uint16_t *val_size, int trx_id) {
 
-    int slot_index;
-    int header_bufnum;
-    header_page_t *header_page;
+    int slot_index, number_of_locks;
+    page::key_t lock_keys[64];
     pagenum_t root_pagenum, leaf_pagenum;
     int leaf_bufnum;
     node_page_t *leaf_page;
@@ -1540,9 +2125,7 @@ int db_find(table_id_t table_id, int64_t key, char *ret_val, uint16_t *val_size,
     //     return OP_FAILURE;
     
     // Get the root_pagenum.
-    buffer_request_page(table_id, 0, header_page, &header_bufnum);
-    root_pagenum = header_page->root_pagenum;
-    buffer_release_page(header_bufnum, false);
+    root_pagenum = file_get_root_pagenum(table_id);
 
     // Find the leaf page number which may contain the key in the tree.
     leaf_pagenum = find_leaf_pagenum(table_id, root_pagenum, key);
@@ -1556,27 +2139,30 @@ int db_find(table_id_t table_id, int64_t key, char *ret_val, uint16_t *val_size,
     }
 
     // Request the leaf page.
-    buffer_request_page(table_id, leaf_pagenum, leaf_page, &leaf_bufnum);
-
-    // Find the key in the leaf page.
-    for (slot_index = 0; slot_index < leaf_page->header.number_of_keys; slot_index++) {
+    buffer_request_page(table_id, leaf_pagenum, leaf_page, &leaf_bufnum, kLatchShared);
 
-        buffer_release_page(leaf_bufnum, false);
-        if (lock_acquire(table_id, leaf_pagenum, leaf_page->slots[slot_index].key, trx_id, kLockShared) == NULL) {
+    // Lock the keys in order, up to the key or the first key greater than it.
+    slot_index = search_slots_lower_bound(leaf_page->slots, leaf_page->header.number_of_keys, key);
+    number_of_locks = std::min(slot_index + 1, leaf_page->header.number_of_keys);
+    for (slot_index = 0; slot_index < number_of_locks; slot_index++)
+        lock_keys[slot_index] = leaf_page->slots[slot_index].key;
+    buffer_release_page(leaf_bufnum, false);
+    for (slot_index = 0; slot_index < number_of_locks; slot_index++) {
+        if (lock_acquire(table_id, leaf_pagenum, lock_keys[slot_index], trx_id, kLockShared) == NULL) {
             if (trx_abort(trx_id) != trx_id) {
                 return OP_FAILURE;
             }
             return OP_FAILURE;
         }
-        buffer_request_page(table_id, leaf_pagenum, leaf_page, &leaf_bufnum);
+    }
+    buffer_request_page(table_id, leaf_pagenum, leaf_page, &leaf_bufnum, kLatchShared);
 
-        // Store the value and size, if exist.
-        if (leaf_page->slots[slot_index].key == key) {
-            existence_flag = true;
-            memcpy(ret_val, &(leaf_page->values[VALUE_OFFSET(leaf_page->slots[slot_index].offset)]), leaf_page->slots[slot_index].size);
-            *val_size = leaf_page->slots[slot_index].size;
-            break;
-        }
+    // Find the key in the leaf page. Store the value and size, if exist.
+    slot_index = search_slots(leaf_page->slots, leaf_page->header.number_of_keys, key);
+    if (slot_index >= 0) {
+        existence_flag = true;
+        memcpy(ret_val, &(leaf_page->values[VALUE_OFFSET(leaf_page->slots[slot_index].offset)]), leaf_page->slots[slot_index].size);
+        *val_size = leaf_page->slots[slot_index].size;
     }
     
     // Release the leaf page.
@@ -1592,10 +2178,141 @@ int db_find(table_id_t table_id, int64_t key, char *ret_val, uint16_t *val_size,
         return OP_FAILURE;
 }
 
+int db_find_batch(int64_t table_id, const int64_t* keys, int n, char** out_vals, uint16_t* out_sizes, int trx_id) {
+
+    std::vector<int> order;
+    std::vector<int64_t> leaf_keys;
+    std::vector<find_batch_path_t> path;
+    pagenum_t leaf_pagenum;
+    page::key_t high_key;
+    bool is_bounded;
+    int leaf_bufnum;
+    node_page_t* leaf_page;
+    int first, last, key_index, slot_index, i;
+    int number_of_locked, number_of_found = 0;
+
+    if (verbose) {
+        printf("|db_find_batch %d ", n);
+    }
+
+    // Check the table_id is valid.
+    if (file_is_valid_table_id(table_id) == false)
+        return OP_FAILURE;
+
+    for (i = 0; i < n; i++)
+        out_sizes[i] = 0;
+
+    // Sort the keys by their index.
+    order.resize(n);
+    for (i = 0; i < n; i++)
+        order[i] = i;
+    std::sort(order.begin(), order.end(), [keys](int a, int b) { return keys[a] < keys[b]; });
+
+    for (first = 0; first < n; first = last) {
+        // I. Find the leaf page, and the keys in the range of the leaf page: order[first, last).
+        leaf_pagenum = find_batch_leaf_pagenum(table_id, path, keys[order[first]]);
+        // Tree does not exist.
+        if (leaf_pagenum == 0)
+            break;
+        high_key = path.back().high_key;
+        is_bounded = path.back().is_bounded;
+
+        leaf_keys.clear();
+        for (last = first; last < n && (is_bounded == false || keys[order[last]] < high_key); last++) {
+            if (leaf_keys.empty() == true || leaf_keys.back() != keys[order[last]])
+                leaf_keys.push_back(keys[order[last]]);
+        }
+
+        // II. Lock the keys of the leaf page in a batch. A conflicting key waits alone, and the batch continues after it.
+        if (trx_id != 0) {
+            for (key_index = 0; key_index < (int)leaf_keys.size(); key_index++) {
+                number_of_locked = lock_acquire_batch(table_id, leaf_pagenum, &leaf_keys[key_index], leaf_keys.size() - key_index, trx_id, kLockShared);
+                key_index += number_of_locked;
+                if (key_index == (int)leaf_keys.size())
+                    break;
+                if (lock_acquire(table_id, leaf_pagenum, leaf_keys[key_index], trx_id, kLockShared) == NULL) {
+                    trx_abort(trx_id);
+                    return OP_FAILURE;
+                }
+            }
+        }
+
+        // III. Read the values in the leaf page once.
+        buffer_request_page(table_id, leaf_pagenum, leaf_page, &leaf_bufnum, kLatchShared);
+        slot_index = 0;
+        for (i = first; i < last; i++) {
+            key_index = order[i];
+            slot_index += search_slots_lower_bound(&leaf_page->slots[slot_index], leaf_page->header.number_of_keys - slot_index, keys[key_index]);
+            if (slot_index < leaf_page->header.number_of_keys && leaf_page->slots[slot_index].key == keys[key_index]) {
+                memcpy(out_vals[key_index], &(leaf_page->values[VALUE_OFFSET(leaf_page->slots[slot_index].offset)]), leaf_page->slots[slot_index].size);
+                out_sizes[key_index] = leaf_page->slots[slot_index].size;
+                number_of_found++;
+            }
+        }
+        buffer_release_page(leaf_bufnum, false);
+    }
+
+    if (verbose) {
+        printf("(found: %d)|", number_of_found);
+    }
+
+    return number_of_found;
+}
+
+pagenum_t find_batch_leaf_pagenum(table_id_t table_id, std::vector<find_batch_path_t>& path, page::key_t key) {
+
+    find_batch_path_t child;
+    node_page_t* node_page;
+    int node_bufnum;
+    int branch_index;
+    bool is_leaf = false;
+
+    // I. Keep the pages of the path which cover the key. The root page always does.
+    while (path.empty() == false && path.back().is_bounded == true && key >= path.back().high_key)
+        path.pop_back();
+
+    if (path.empty() == true) {
+        child.pagenum = file_get_root_pagenum(table_id);
+        // Tree does not exist.
+        if (child.pagenum == 0)
+            return 0;
+        child.high_key = 0;
+        child.is_bounded = false;
+        path.push_back(child);
+    }
+
+    // II. Descend from the lowest page covering the key.
+    while (true) {
+        buffer_request_page(table_id, path.back().pagenum, node_page, &node_bufnum, kLatchShared);
+        is_leaf = node_page->header.is_leaf;
+        if (is_leaf == false) {
+            // The child is bounded by the next branch, or by the bound of the page.
+            branch_index = search_branchs(node_page->branchs, node_page->header.number_of_keys, key) - 1;
+            if (branch_index == -1)
+                child.pagenum = node_page->header.branch_first_pagenum;
+            else
+                child.pagenum = node_page->branchs[branch_index].pagenum;
+            if (branch_index + 1 < node_page->header.number_of_keys) {
+                child.high_key = node_page->branchs[branch_index + 1].key;
+                child.is_bounded = true;
+            } else {
+                child.high_key = path.back().high_key;
+                child.is_bounded = path.back().is_bounded;
+            }
+        }
+        buffer_release_page(node_bufnum, false);
+
+        if (is_leaf == true)
+            break;
+        path.push_back(child);
+    }
+
+    return path.back().pagenum;
+}
+
 int db_update(int64_t table_id, int64_t key, char* values, uint16_t new_val_size, uint16_t* old_val_size, int trx_id) {
 
-    int header_bufnum, leaf_bufnum;
-    header_page_t* header_page;
+    int leaf_bufnum;
     pagenum_t root_pagenum, leaf_pagenum;
     node_page_t* leaf_page;
     int slot_index;
@@ -1612,9 +2329,7 @@ int db_update(int64_t table_id, int64_t key, char* values, uint16_t new_val_size
     //     return OP_FAILURE;
     
     // Get the root page number from the header page.
-    buffer_request_page(table_id, 0, header_page, &header_bufnum);
-    root_pagenum = header_page->root_pagenum;
-    buffer_release_page(header_bufnum, false);
+    root_pagenum = file_get_root_pagenum(table_id);
 
     // Get the leaf page number which may contain the key.
     leaf_pagenum = find_leaf_pagenum(table_id, root_pagenum, key, trx_id);
@@ -1628,55 +2343,171 @@ int db_update(int64_t table_id, int64_t key, char* values, uint16_t new_val_size
     
     // Find the key in the leaf page.
     buffer_request_page(table_id, leaf_pagenum, leaf_page, &leaf_bufnum);
-    for (slot_index = 0; slot_index < leaf_page->header.number_of_keys; slot_index++) {
-        if (key == leaf_page->slots[slot_index].key) {
+    slot_index = search_slots(leaf_page->slots, leaf_page->header.number_of_keys, key);
+    if (slot_index >= 0) {
 #if IMPLICIT_LOCKING
-            if (is_alive_trx(leaf_page->slots[slot_index].trx_id) == false && lock_exists(table_id, leaf_pagenum, key, trx_id) == false) {
-                leaf_page->slots[slot_index].trx_id = trx_id;
-            } else {
-                buffer_release_page(leaf_bufnum, false);
-                lock = lock_acquire(table_id, leaf_pagenum, leaf_page->slots[slot_index].key, trx_id, kLockExclusive);
-                if(lock == NULL) {
-                    if (trx_abort(trx_id) != trx_id) {
-                        return OP_FAILURE;
-                    }
-                    return OP_FAILURE;
-                }
-                buffer_request_page(table_id, leaf_pagenum, leaf_page, &leaf_bufnum);
-            }
-#else
+        if (is_alive_trx(leaf_page->slots[slot_index].trx_id) == false && lock_exists(table_id, leaf_pagenum, key, trx_id) == false) {
+            leaf_page->slots[slot_index].trx_id = trx_id;
+        } else {
+            buffer_release_page(leaf_bufnum, false);
             lock = lock_acquire(table_id, leaf_pagenum, leaf_page->slots[slot_index].key, trx_id, kLockExclusive);
             if(lock == NULL) {
-                trx_abort(trx_id);
+                if (trx_abort(trx_id) != trx_id) {
+                    return OP_FAILURE;
+                }
                 return OP_FAILURE;
             }
+            buffer_request_page(table_id, leaf_pagenum, leaf_page, &leaf_bufnum);
+        }
+#else
+        lock = lock_acquire(table_id, leaf_pagenum, leaf_page->slots[slot_index].key, trx_id, kLockExclusive);
+        if(lock == NULL) {
+            trx_abort(trx_id);
+            return OP_FAILURE;
+        }
 
 #endif
 
-            existence_flag = true;
-            
-            // Remain log for abort.
-            leaf_page->header.LSN = log_create(kUpdate, trx_id, table_id, leaf_pagenum, leaf_page->slots[slot_index].offset, new_val_size, &leaf_page->values[VALUE_OFFSET(leaf_page->slots[slot_index].offset)], values);
-            if (leaf_page->header.LSN < 0) {
-                perror("Log create failure: negative LSN");
-                exit(OP_FAILURE);
-            }
-            
-            // Push the log into the trx for abort.
-            trx_push_log_to_queue(leaf_page->header.LSN, trx_id);
-
-            // Update the value and its size.
-            *old_val_size = leaf_page->slots[slot_index].size;
-            memcpy(&(leaf_page->values[VALUE_OFFSET(leaf_page->slots[slot_index].offset)]), values, new_val_size);
-            leaf_page->slots[slot_index].size = new_val_size;
-            break;
+        existence_flag = true;
+        
+        // Remain log for abort.
+        leaf_page->header.LSN = log_create(kUpdate, trx_id, table_id, leaf_pagenum, leaf_page->slots[slot_index].offset, new_val_size, &leaf_page->values[VALUE_OFFSET(leaf_page->slots[slot_index].offset)], values);
+        if (leaf_page->header.LSN < 0) {
+            perror("Log create failure: negative LSN");
+            exit(OP_FAILURE);
         }
+        
+        // Push the log into the trx for abort.
+        trx_push_log_to_queue(leaf_page->header.LSN, trx_id);
+
+        // Update the value and its size.
+        *old_val_size = leaf_page->slots[slot_index].size;
+        memcpy(&(leaf_page->values[VALUE_OFFSET(leaf_page->slots[slot_index].offset)]), values, new_val_size);
+        leaf_page->slots[slot_index].size = new_val_size;
     }
-    buffer_release_page(leaf_bufnum, false);
+    buffer_release_page(leaf_bufnum, existence_flag);
 
     if (existence_flag)
         return OP_SUCCESS;
     else   
         return OP_FAILURE;
     
-}
\ No newline at end of file
+}
+
+// Range scan
+scan_cursor_t* db_scan_open(int64_t table_id, int64_t lo, int64_t hi, int trx_id) {
+
+    scan_cursor_t* cursor;
+    pagenum_t root_pagenum;
+
+    if (verbose) {
+        printf("|db_scan_open [%ld, %ld] ", lo, hi);
+    }
+
+    // Check the table_id is valid.
+    if (file_is_valid_table_id(table_id) == false)
+        return NULL;
+
+    cursor = (scan_cursor_t*)malloc(sizeof(scan_cursor_t));
+    if (cursor == NULL) {
+        perror("Memory allocation error");
+        exit(EXIT_FAILURE);
+    }
+    cursor->table_id = table_id;
+    cursor->trx_id = trx_id;
+    cursor->next_key = lo;
+    cursor->hi = hi;
+
+    // Find the leaf page which may contain lo. The range is empty, if the tree does not exist.
+    cursor->free_count = file_get_free_count(table_id);
+    root_pagenum = file_get_root_pagenum(table_id);
+    if (lo > hi)
+        cursor->leaf_pagenum = 0;
+    else
+        cursor->leaf_pagenum = find_leaf_pagenum(table_id, root_pagenum, lo);
+
+    return cursor;
+}
+
+int db_scan_next(scan_cursor_t* cursor, int64_t* key, char* ret_val, uint16_t* val_size) {
+
+    int leaf_bufnum;
+    node_page_t* leaf_page;
+    pagenum_t right_sibling_pagenum;
+    page::key_t slot_key;
+    int slot_index;
+
+    if (verbose) {
+        printf("|db_scan_next %ld ", cursor->next_key);
+    }
+
+    while (cursor->leaf_pagenum != 0) {
+        // 0. A page is freed since the leaf page was found. It may be the leaf page, so descend again.
+        if (file_get_free_count(cursor->table_id) != cursor->free_count) {
+            cursor->free_count = file_get_free_count(cursor->table_id);
+            cursor->leaf_pagenum = find_leaf_pagenum(cursor->table_id, file_get_root_pagenum(cursor->table_id), cursor->next_key);
+            continue;
+        }
+
+        buffer_request_page(cursor->table_id, cursor->leaf_pagenum, leaf_page, &leaf_bufnum, kLatchShared);
+        slot_index = search_slots_lower_bound(leaf_page->slots, leaf_page->header.number_of_keys, cursor->next_key);
+
+        // I. No more record in the leaf page. Move to the right sibling.
+        if (slot_index == leaf_page->header.number_of_keys) {
+            right_sibling_pagenum = leaf_page->header.right_sibling_pagenum;
+            buffer_release_page(leaf_bufnum, false);
+            cursor->leaf_pagenum = right_sibling_pagenum;
+            continue;
+        }
+
+        // II. Out of the range.
+        slot_key = leaf_page->slots[slot_index].key;
+        if (slot_key > cursor->hi) {
+            buffer_release_page(leaf_bufnum, false);
+            cursor->leaf_pagenum = 0;
+            break;
+        }
+
+        // III. Lock the record without the latch, and find it again.
+        if (cursor->trx_id != 0) {
+            buffer_release_page(leaf_bufnum, false);
+            if (lock_acquire(cursor->table_id, cursor->leaf_pagenum, slot_key, cursor->trx_id, kLockShared) == NULL) {
+                trx_abort(cursor->trx_id);
+                cursor->leaf_pagenum = 0;
+                return OP_FAILURE;
+            }
+            buffer_request_page(cursor->table_id, cursor->leaf_pagenum, leaf_page, &leaf_bufnum, kLatchShared);
+            slot_index = search_slots(leaf_page->slots, leaf_page->header.number_of_keys, slot_key);
+            // Deleted, moved or freed while unlatched. Search from the same position.
+            if (slot_index < 0 || file_get_free_count(cursor->table_id) != cursor->free_count) {
+                buffer_release_page(leaf_bufnum, false);
+                continue;
+            }
+        }
+
+        // IV. Store the record, and move the position after it.
+        *key = slot_key;
+        memcpy(ret_val, &(leaf_page->values[VALUE_OFFSET(leaf_page->slots[slot_index].offset)]), leaf_page->slots[slot_index].size);
+        *val_size = leaf_page->slots[slot_index].size;
+        buffer_release_page(leaf_bufnum, false);
+
+        if (slot_key == cursor->hi)
+            cursor->leaf_pagenum = 0;
+        else
+            cursor->next_key = slot_key + 1;
+
+        if (verbose) {
+            printf("|");
+        }
+        return OP_SUCCESS;
+    }
+
+    if (verbose) {
+        printf("end|");
+    }
+    return SCAN_END;
+}
+
+void db_scan_close(scan_cursor_t* cursor) {
+    free(cursor);
+}
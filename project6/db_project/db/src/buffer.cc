@@ -4,46 +4,75 @@
 #include <stdio.h>
 #include <string.h>
 #include <pthread.h>
+#include <sched.h>          // for sched_yield()
+#include <time.h>
+
+#include <algorithm>
 
 #include "page.h"
 #include "file.h"
 #include "log.h"
 
 // Data Structures used in buffer management layer.
-buffer_info_t buffer_info;
+// The frames are partitioned into independent buffer instances.
+// Each instance owns a contiguous range of bufnums.
+buffer_info_t *buffer_instances;
+int number_of_buffer_instances;
 buffer_cntl_block_t *buffer_cntl_blocks;
 page_t *frames;
-pthread_mutex_t buffer_manager_latch;
+buffer_policy_t buffer_policy;
+
+// Page cleaner
+pthread_t cleaner_thread;
+pthread_mutex_t cleaner_latch;
+pthread_cond_t cleaner_cond;
+bool is_cleaner_running;
+
+// Read-ahead
+pthread_t readahead_thread;
+pthread_mutex_t readahead_latch;
+pthread_cond_t readahead_cond;
+bool is_readahead_running;
+std::deque<readahead_request_t> readahead_queue;
+std::unordered_map<table_id_t, readahead_state_t> readahead_states;
+// (table_id, cluster number) -> number of misses
+std::unordered_map<buffer_page_id_t, int, BufferPageHash> readahead_cluster_misses;
 
 extern bool verbose;
 extern bool verbose2;
 
-pagenum_t buffer_alloc_page(table_id_t table_id) {
+pagenum_t buffer_alloc_page(table_id_t table_id, pagenum_t near_pagenum) {
     
     pagenum_t pagenum;
+    buffer_info_t* instance;
     int bufnum = INVALID_BUFNUM;
-    int header_bufnum;
-    header_page_t* header_page;
 
     if (verbose) {
         printf(" |buffer_alloc_page");
     }
 
     // Allocate a new page number.
-    pagenum = file_alloc_page(table_id);
-    // Maintain consistency of the header page with disk and buffer.
-    for (header_bufnum = buffer_info.LRU_head_bufnum; header_bufnum != INVALID_BUFNUM; header_bufnum = buffer_cntl_blocks[header_bufnum].LRU_next_bufnum) 
-        if (table_id == buffer_cntl_blocks[header_bufnum].table_id && 0 == buffer_cntl_blocks[header_bufnum].pagenum) {
-            file_read_page(table_id, 0, &frames[header_bufnum]);
-            if (verbose) {
-                header_page = (header_page_t*)(&frames[header_bufnum]);
-                printf(" (header_page(%ld %ld %ld) sync.ed imm.)", header_page->first_free_pagenum, header_page->number_of_pages, header_page->root_pagenum);
-            }
-            break;
-        }
+    pagenum = file_alloc_page(table_id, near_pagenum);
+    // The header page is cached in the file layer, not in the buffer.
+
+    // Load the new page into the buffer, initialized.
+    // The page may have been prefetched while free, and the disk keeps the freed image.
+    instance = buffer_get_instance(table_id, pagenum);
+    pthread_mutex_lock(&instance->instance_latch);
+    bufnum = buffer_lookup_page(instance, table_id, pagenum);
+    if (bufnum == INVALID_BUFNUM)
+        bufnum = get_new_bufnum(instance, table_id, pagenum, false);
+    buffer_cntl_blocks[bufnum].number_of_pins++;
+    pthread_mutex_unlock(&instance->instance_latch);
 
-    // Load the new page into the buffer.
-    bufnum = get_new_bufnum(table_id, pagenum);
+    // A prefetch of the page holds the latch until its read completes. Wait for it,
+    // not to have the zeroed frame overwritten by the freed image.
+    pthread_rwlock_wrlock(&buffer_cntl_blocks[bufnum].page_latch);
+    memset(&frames[bufnum], 0, PAGE_SIZE);
+    // Not to read the freed image again, if evicted before the caller requests it.
+    buffer_cntl_blocks[bufnum].is_dirty = true;
+    pthread_rwlock_unlock(&buffer_cntl_blocks[bufnum].page_latch);
+    buffer_cntl_blocks[bufnum].number_of_pins--;
 
     if (verbose) {
         printf("\tpagenum: %ld, bufnum: %d", pagenum, bufnum);
@@ -54,11 +83,11 @@ pagenum_t buffer_alloc_page(table_id_t table_id) {
 
 void buffer_free_page(table_id_t table_id, pagenum_t pagenum) {
 
+    buffer_info_t* instance;
     int bufnum;
-    int header_bufnum;
-    header_page_t* header_page;
 
-    pthread_mutex_lock(&buffer_manager_latch);
+    instance = buffer_get_instance(table_id, pagenum);
+    pthread_mutex_lock(&instance->instance_latch);
 
     if (verbose) {
         printf(" |buffer_free_page p: %ld", pagenum);
@@ -68,45 +97,40 @@ void buffer_free_page(table_id_t table_id, pagenum_t pagenum) {
         printf("\n0.buf free");
         getchar();
     }
-    // TODO: what if num_pins != 0
+    // The caller must have released the page.
+    // Wait for the page cleaner to unpin the page, not to write it after freed.
+    bufnum = buffer_lookup_page(instance, table_id, pagenum);
+    while (bufnum != INVALID_BUFNUM && buffer_cntl_blocks[bufnum].number_of_pins.load() != 0) {
+        pthread_mutex_unlock(&instance->instance_latch);
+        sched_yield();
+        pthread_mutex_lock(&instance->instance_latch);
+        bufnum = buffer_lookup_page(instance, table_id, pagenum);
+    }
     // If the page exists in buffer, free the buffer.
-    for (bufnum = buffer_info.LRU_head_bufnum; bufnum != INVALID_BUFNUM; bufnum = buffer_cntl_blocks[bufnum].LRU_next_bufnum)
-        if (table_id == buffer_cntl_blocks[bufnum].table_id && pagenum == buffer_cntl_blocks[bufnum].pagenum) {
-            if (verbose2) {
-                printf("(b: (%d)-%d-(%d), dirty: %d)", buffer_cntl_blocks[bufnum].LRU_prev_bufnum, bufnum, buffer_cntl_blocks[bufnum].LRU_next_bufnum, buffer_cntl_blocks[bufnum].is_dirty);
-                getchar();
-            }
-            // Remove from the LRU list.
-            if (bufnum == buffer_info.LRU_tail_bufnum) {
-                if (verbose2) {
-                    printf("(LRU tail)");
-                    getchar();
-                }
-                buffer_info.LRU_tail_bufnum = buffer_cntl_blocks[bufnum].LRU_prev_bufnum;
-                buffer_cntl_blocks[buffer_info.LRU_tail_bufnum].LRU_next_bufnum = INVALID_BUFNUM;
-            } else if (bufnum == buffer_info.LRU_head_bufnum) {
-                if (verbose2) {
-                    printf("(LRU head)");
-                    getchar();
-                }
-                buffer_info.LRU_head_bufnum = buffer_cntl_blocks[bufnum].LRU_next_bufnum;
-                buffer_cntl_blocks[buffer_info.LRU_head_bufnum].LRU_prev_bufnum = INVALID_BUFNUM;
-            } else {
-                buffer_cntl_blocks[buffer_cntl_blocks[bufnum].LRU_prev_bufnum].LRU_next_bufnum = buffer_cntl_blocks[bufnum].LRU_next_bufnum;
-                buffer_cntl_blocks[buffer_cntl_blocks[bufnum].LRU_next_bufnum].LRU_prev_bufnum = buffer_cntl_blocks[bufnum].LRU_prev_bufnum;
-            }
-            // Write the page if dirty.
-            if (buffer_cntl_blocks[bufnum].is_dirty == true) {
-                file_write_page(buffer_cntl_blocks[bufnum].table_id, buffer_cntl_blocks[bufnum].pagenum, &frames[bufnum]);
-            }
-            // for tidiness
-            memset(&frames[bufnum], 0, PAGE_SIZE);
-
-            // Push the buffer into the free buffer list.
-            buffer_cntl_blocks[bufnum].free_next_bufnum = buffer_info.first_free_bufnum;
-            buffer_info.first_free_bufnum = bufnum;
-            break;
+    if (bufnum != INVALID_BUFNUM) {
+        if (verbose2) {
+            printf("(b: (%d)-%d-(%d), dirty: %d)", buffer_cntl_blocks[bufnum].LRU_prev_bufnum, bufnum, buffer_cntl_blocks[bufnum].LRU_next_bufnum, buffer_cntl_blocks[bufnum].is_dirty.load());
+            getchar();
         }
+        // Remove from the replacement policy.
+        buffer_policy.on_remove(instance, bufnum);
+        // Write the page if dirty.
+        if (buffer_cntl_blocks[bufnum].is_dirty == true) {
+            file_write_page(buffer_cntl_blocks[bufnum].table_id, buffer_cntl_blocks[bufnum].pagenum, &frames[bufnum]);
+            buffer_cntl_blocks[bufnum].is_dirty = false;
+        }
+        buffer_cntl_blocks[bufnum].recLSN = -1;
+        // for tidiness
+        memset(&frames[bufnum], 0, PAGE_SIZE);
+
+        // Remove from the page table.
+        instance->page_table.erase(buffer_page_id_t(table_id, pagenum));
+
+        // Push the buffer into the free buffer list.
+        buffer_cntl_blocks[bufnum].free_next_bufnum = instance->first_free_bufnum;
+        instance->first_free_bufnum = bufnum;
+    }
+    pthread_mutex_unlock(&instance->instance_latch);
 
     if (verbose2) {
         printf("\n1. free buf");
@@ -121,29 +145,42 @@ void buffer_free_page(table_id_t table_id, pagenum_t pagenum) {
         getchar();
     }
 
-    // Maintain consistency of the header page with disk and buffer.
-    for (header_bufnum = buffer_info.LRU_head_bufnum; header_bufnum != INVALID_BUFNUM; header_bufnum = buffer_cntl_blocks[header_bufnum].LRU_next_bufnum) 
-        if (table_id == buffer_cntl_blocks[header_bufnum].table_id && 0 == buffer_cntl_blocks[header_bufnum].pagenum) {
-            file_read_page(table_id, 0, &frames[header_bufnum]);
-            if (verbose) {
-                header_page = (header_page_t*)(&frames[header_bufnum]);
-                printf(" (header_page(%ld %ld %ld) sync.ed imm.)", header_page->first_free_pagenum, header_page->number_of_pages, header_page->root_pagenum);
-            }
-            break;
-        }
-
-    if (verbose2) {
-        printf("\n3. sync header");
-        getchar();
-    }
     if (verbose) {
         printf("|");
     }
+}
+
+void buffer_discard_page(table_id_t table_id, pagenum_t pagenum) {
 
-    pthread_mutex_unlock(&buffer_manager_latch);
+    buffer_info_t* instance;
+    int bufnum;
+
+    instance = buffer_get_instance(table_id, pagenum);
+    pthread_mutex_lock(&instance->instance_latch);
+
+    // Wait for the reader to unpin the page. A frame loaded after this reads the page on disk.
+    bufnum = buffer_lookup_page(instance, table_id, pagenum);
+    while (bufnum != INVALID_BUFNUM && buffer_cntl_blocks[bufnum].number_of_pins.load() != 0) {
+        pthread_mutex_unlock(&instance->instance_latch);
+        sched_yield();
+        pthread_mutex_lock(&instance->instance_latch);
+        bufnum = buffer_lookup_page(instance, table_id, pagenum);
+    }
+    // Drop the frame without writing.
+    if (bufnum != INVALID_BUFNUM) {
+        buffer_policy.on_remove(instance, bufnum);
+        buffer_cntl_blocks[bufnum].is_dirty = false;
+        buffer_cntl_blocks[bufnum].recLSN = -1;
+        instance->page_table.erase(buffer_page_id_t(table_id, pagenum));
+
+        // Push the buffer into the free buffer list.
+        buffer_cntl_blocks[bufnum].free_next_bufnum = instance->first_free_bufnum;
+        instance->first_free_bufnum = bufnum;
+    }
+    pthread_mutex_unlock(&instance->instance_latch);
 }
 
-int get_new_bufnum(table_id_t table_id, pagenum_t pagenum) {
+int get_new_bufnum(buffer_info_t* instance, table_id_t table_id, pagenum_t pagenum, bool is_read) {
     int bufnum = INVALID_BUFNUM;
     
     if (verbose) {
@@ -151,216 +188,955 @@ int get_new_bufnum(table_id_t table_id, pagenum_t pagenum) {
     }
     // Otherwise, call disk manager for read.
     // I. there are some free buffers.
-    if (buffer_info.first_free_bufnum != INVALID_BUFNUM) {
+    if (instance->first_free_bufnum != INVALID_BUFNUM) {
         if (verbose) {
             printf(" in free list");
         }
         // Get the first free buffer number.
-        bufnum = buffer_info.first_free_bufnum;
-        buffer_info.first_free_bufnum = buffer_cntl_blocks[bufnum].free_next_bufnum;
+        bufnum = instance->first_free_bufnum;
+        instance->first_free_bufnum = buffer_cntl_blocks[bufnum].free_next_bufnum;
     }
-    // II. buffer is full. LRU policy
+    // II. buffer is full. Replacement policy
     else {
         if (verbose) {
-            printf(" in LRU list");
+            printf(" by replacement");
         }
         // TODO: The case buffer pool is full and there is no unpinned buffer.
         // 1. return OP_FAILURE
         // 2. 가능 버퍼가 생길 때까지 반복
         // 현재로써는 roll-back algorithm을 구현할 수 없다고 생각하여 2안 선택
-        while (bufnum == INVALID_BUFNUM) {
-            for (bufnum = buffer_info.LRU_tail_bufnum; bufnum != INVALID_BUFNUM; bufnum = buffer_cntl_blocks[bufnum].LRU_prev_bufnum)
-                // Get unpinned LRU buffer number.
-                // if (buffer_cntl_blocks[bufnum].number_of_pins == 0) {
-                if (pthread_mutex_trylock(&buffer_cntl_blocks[bufnum].page_latch) == 0) {
-                    // Update the buffer LRU list.
-                    if (bufnum == buffer_info.LRU_tail_bufnum) {
-                        buffer_info.LRU_tail_bufnum = buffer_cntl_blocks[bufnum].LRU_prev_bufnum;
-                        buffer_cntl_blocks[buffer_info.LRU_tail_bufnum].LRU_next_bufnum = INVALID_BUFNUM;
-                    } else if (bufnum == buffer_info.LRU_head_bufnum) {
-                        buffer_info.LRU_head_bufnum = buffer_cntl_blocks[bufnum].LRU_next_bufnum;
-                        buffer_cntl_blocks[buffer_info.LRU_head_bufnum].LRU_prev_bufnum = INVALID_BUFNUM;
-                    } else {
-                        buffer_cntl_blocks[buffer_cntl_blocks[bufnum].LRU_prev_bufnum].LRU_next_bufnum = buffer_cntl_blocks[bufnum].LRU_next_bufnum;
-                        buffer_cntl_blocks[buffer_cntl_blocks[bufnum].LRU_next_bufnum].LRU_prev_bufnum = buffer_cntl_blocks[bufnum].LRU_prev_bufnum;
-                    }
-                    break;
-                }
-        }
-        // Flush the LRU buffer. Write the page, if dirty.
-        if (buffer_cntl_blocks[bufnum].is_dirty == true)
+        // New pins are made only under instance_latch, so an unpinned victim stays unpinned.
+        while (bufnum == INVALID_BUFNUM)
+            bufnum = buffer_policy.pick_victim(instance);
+
+        // Flush the victim buffer. Write the page, if dirty.
+        // The page cleaner fell behind, wake it up.
+        if (buffer_cntl_blocks[bufnum].is_dirty == true) {
             file_write_page(buffer_cntl_blocks[bufnum].table_id, buffer_cntl_blocks[bufnum].pagenum, &frames[bufnum]);
+            pthread_cond_signal(&cleaner_cond);
+        }
+        // Remove the evicted page from the page table.
+        instance->page_table.erase(buffer_page_id_t(buffer_cntl_blocks[bufnum].table_id, buffer_cntl_blocks[bufnum].pagenum));
     }
 
     // Initialize the buffer_cntl_block.
     buffer_cntl_blocks[bufnum].table_id = table_id;
     buffer_cntl_blocks[bufnum].pagenum = pagenum;
     buffer_cntl_blocks[bufnum].is_dirty = false;
-    // buffer_cntl_blocks[bufnum].number_of_pins = 0;
-    pthread_mutex_unlock(&buffer_cntl_blocks[bufnum].page_latch);
+    buffer_cntl_blocks[bufnum].recLSN = -1;
 
     // Read the page into the frame..
-    file_read_page(table_id, pagenum, &frames[bufnum]);
+    if (is_read == true)
+        file_read_page(table_id, pagenum, &frames[bufnum]);
+    // Register the page in the page table.
+    instance->page_table[buffer_page_id_t(table_id, pagenum)] = bufnum;
 
-    // Engueue LRU list.
-    // I. no empty LRU list
-    if (buffer_info.LRU_head_bufnum != INVALID_BUFNUM) {
-        buffer_cntl_blocks[buffer_info.LRU_head_bufnum].LRU_prev_bufnum = bufnum;
-        buffer_cntl_blocks[bufnum].LRU_next_bufnum = buffer_info.LRU_head_bufnum;
-        buffer_cntl_blocks[bufnum].LRU_prev_bufnum = INVALID_BUFNUM;
-        buffer_info.LRU_head_bufnum = bufnum;
-    } 
-    // II. empty LRU list
-    else {
-        buffer_cntl_blocks[bufnum].LRU_next_bufnum = INVALID_BUFNUM;
-        buffer_cntl_blocks[bufnum].LRU_prev_bufnum = INVALID_BUFNUM;
-        buffer_info.LRU_head_bufnum = bufnum;
-        buffer_info.LRU_tail_bufnum = bufnum;
-    }
+    // Hand over to the replacement policy.
+    buffer_policy.on_load(instance, bufnum);
 
     return bufnum;
 }
-int buffer_request_page(table_id_t table_id, pagenum_t pagenum, header_page_t*& page, int* bufnum) {
+int buffer_request_page(table_id_t table_id, pagenum_t pagenum, node_page_t*& page, int* bufnum, PageLatchMode latch_mode) {
 
+    buffer_info_t* instance;
     int temp_bufnum;
+    bool is_miss = false;
 
-    pthread_mutex_lock(&buffer_manager_latch);
+    instance = buffer_get_instance(table_id, pagenum);
+    pthread_mutex_lock(&instance->instance_latch);
 
     if (verbose) {
         printf(" |bufReq");
     }
-
     // Get the bufnum.
     // I. if the page exists in buffer, return it.
-    for (temp_bufnum = buffer_info.LRU_head_bufnum; temp_bufnum != INVALID_BUFNUM; temp_bufnum = buffer_cntl_blocks[temp_bufnum].LRU_next_bufnum)
-        if (table_id == buffer_cntl_blocks[temp_bufnum].table_id && pagenum == buffer_cntl_blocks[temp_bufnum].pagenum) {
-            break;
-        }
-    // II. otherwise, get the new buffer number.
-    if (temp_bufnum == INVALID_BUFNUM) 
-        temp_bufnum = get_new_bufnum(table_id, pagenum);
-    
-    // Store the page and bufnum to parameter.
-    *bufnum = temp_bufnum;
-    page = (header_page_t*)(&frames[temp_bufnum]);
-
-    // Pin the buffer.
-    pthread_mutex_lock(&buffer_cntl_blocks[temp_bufnum].page_latch);
-    // buffer_cntl_blocks[temp_bufnum].number_of_pins++;
-
-    if (verbose) {
-        printf(" p: %ld, b: %d", pagenum, *bufnum);
-        printf("|");
+    temp_bufnum = buffer_lookup_page(instance, table_id, pagenum);
+    if (temp_bufnum != INVALID_BUFNUM) {
+        instance->number_of_hits++;
+        buffer_policy.on_hit(instance, temp_bufnum);
     }
-
-    pthread_mutex_unlock(&buffer_manager_latch);
-
-    return OP_SUCCESS;
-}
-int buffer_request_page(table_id_t table_id, pagenum_t pagenum, node_page_t*& page, int* bufnum) {
-
-    int temp_bufnum;
-
-    pthread_mutex_lock(&buffer_manager_latch);
-
-    if (verbose) {
-        printf(" |bufReq");
-    }
-    // Get the bufnum.
-    // I. if the page exists in buffer, return it.
-    for (temp_bufnum = buffer_info.LRU_head_bufnum; temp_bufnum != INVALID_BUFNUM; temp_bufnum = buffer_cntl_blocks[temp_bufnum].LRU_next_bufnum)
-        if (table_id == buffer_cntl_blocks[temp_bufnum].table_id && pagenum == buffer_cntl_blocks[temp_bufnum].pagenum) {
-            break;
-        }
     // II. otherwise, get the new buffer number.
-    if (temp_bufnum == INVALID_BUFNUM) 
-        temp_bufnum = get_new_bufnum(table_id, pagenum);
+    else {
+        instance->number_of_misses++;
+        temp_bufnum = get_new_bufnum(instance, table_id, pagenum);
+        is_miss = true;
+    }
     
     // Store the page and bufnu m to parameter.
     *bufnum = temp_bufnum;
     page = (node_page_t*)(&frames[temp_bufnum]);
 
-    // Pin the buffer.
-    pthread_mutex_lock(&buffer_cntl_blocks[temp_bufnum].page_latch);
-    // buffer_cntl_blocks[temp_bufnum].number_of_pins++;
+    // Pin the buffer, so that it is not evicted after instance_latch is released.
+    buffer_cntl_blocks[temp_bufnum].number_of_pins++;
 
     if (verbose) {
         printf(" p: %ld, b: %d", pagenum, *bufnum);
         printf("-");
     }
     
-    pthread_mutex_unlock(&buffer_manager_latch);
+    pthread_mutex_unlock(&instance->instance_latch);
+
+    // Latch the buffer. Readers share the page.
+    if (latch_mode == kLatchShared) {
+        pthread_rwlock_rdlock(&buffer_cntl_blocks[temp_bufnum].page_latch);
+    } else {
+        pthread_rwlock_wrlock(&buffer_cntl_blocks[temp_bufnum].page_latch);
+        // Logs of the modification follow the next LSN.
+        if (buffer_cntl_blocks[temp_bufnum].recLSN.load() < 0) {
+            buffer_cntl_blocks[temp_bufnum].recLSN = log_get_next_LSN();
+            buffer_cntl_blocks[temp_bufnum].is_recLSN_by_latch = true;
+        }
+    }
+
+    // Detect the access pattern for read-ahead.
+    if (is_miss == true)
+        buffer_readahead_on_miss(table_id, pagenum);
+    if (page->header.is_leaf == 1)
+        buffer_readahead_on_leaf(table_id, pagenum, page->header.right_sibling_pagenum);
+
     return OP_SUCCESS;
 }
 
 void buffer_release_page(int bufnum, bool is_dirty) {
-    header_page_t* header_page;
 
     if (verbose) {
         printf("-bufRel %d", bufnum);
     }
 
-    // I. Write the page, if header page
-    if (buffer_cntl_blocks[bufnum].pagenum == 0 && is_dirty == true) {
-        if (verbose) {
-            header_page = (header_page_t*)(&frames[bufnum]);
-            printf(" (header_page(%ld %ld %ld) flushed imm.)", header_page->first_free_pagenum, header_page->number_of_pages, header_page->root_pagenum);
-        }
-        file_write_page(buffer_cntl_blocks[bufnum].table_id, 0, &frames[bufnum]);
+    // Remain the page dirty in buffer.
+    if (is_dirty == true) {
+        buffer_cntl_blocks[bufnum].is_dirty = true;
+    }
+    // The page on disk is still up to date.
+    if (buffer_cntl_blocks[bufnum].is_recLSN_by_latch == true) {
+        if (is_dirty == false)
+            buffer_cntl_blocks[bufnum].recLSN = -1;
+        buffer_cntl_blocks[bufnum].is_recLSN_by_latch = false;
     }
-    // II. Remain the page dirty in buffer.
-    else
-        buffer_cntl_blocks[bufnum].is_dirty |= is_dirty;
     
-    // Unpin the buffer.
-    pthread_mutex_unlock(&buffer_cntl_blocks[bufnum].page_latch);
-    // buffer_cntl_blocks[bufnum].number_of_pins--;
+    // Unlatch and unpin the buffer.
+    pthread_rwlock_unlock(&buffer_cntl_blocks[bufnum].page_latch);
+    buffer_cntl_blocks[bufnum].number_of_pins--;
     
     if (verbose) {
-        // printf("(pin %d)", buffer_cntl_blocks[bufnum].number_of_pins);
+        printf("(pin %d)", buffer_cntl_blocks[bufnum].number_of_pins.load());
         printf("|");
     }
 }
 
-void buffer_init(int num_buf) {
+void buffer_init(int num_buf, int num_instances, ReplacementPolicy policy) {
+    buffer_info_t* instance;
+    int instance_num;
     int bufnum;
+    int first_bufnum = 0;
 
     if (verbose) {
         printf(" |buffer_init");
     }
-    buffer_info.LRU_head_bufnum = INVALID_BUFNUM;
-    buffer_info.LRU_tail_bufnum = INVALID_BUFNUM;
-    buffer_info.first_free_bufnum = 0;
+
+    // Every instance owns at least one frame.
+    if (num_instances < 1)
+        num_instances = 1;
+    if (num_instances > num_buf)
+        num_instances = num_buf;
+    number_of_buffer_instances = num_instances;
+
+    switch (policy) {
+        case kPolicyClock:
+            buffer_policy.on_load = clock_on_load;
+            buffer_policy.on_hit = clock_on_hit;
+            buffer_policy.on_remove = clock_on_remove;
+            buffer_policy.pick_victim = clock_pick_victim;
+            buffer_policy.get_victim_candidates = clock_get_victim_candidates;
+            break;
+        case kPolicy2Q:
+            buffer_policy.on_load = two_q_on_load;
+            buffer_policy.on_hit = two_q_on_hit;
+            buffer_policy.on_remove = two_q_on_remove;
+            buffer_policy.pick_victim = two_q_pick_victim;
+            buffer_policy.get_victim_candidates = two_q_get_victim_candidates;
+            break;
+        case kPolicyLRU:
+        default:
+            buffer_policy.on_load = LRU_on_load;
+            buffer_policy.on_hit = LRU_on_hit;
+            buffer_policy.on_remove = LRU_on_remove;
+            buffer_policy.pick_victim = LRU_pick_victim;
+            buffer_policy.get_victim_candidates = LRU_get_victim_candidates;
+            break;
+    }
 
     buffer_cntl_blocks = (buffer_cntl_block_t*)malloc(num_buf * sizeof(buffer_cntl_block_t));
     if (buffer_cntl_blocks == NULL) {
         perror("Memory allocation error");
         exit(EXIT_FAILURE);
     }
-    // free buffer list
-    for (bufnum = 0; bufnum < num_buf - 1; bufnum++)
-        buffer_cntl_blocks[bufnum].free_next_bufnum = bufnum + 1;
-    // The last buffer has no next free buffer.
-    buffer_cntl_blocks[bufnum].free_next_bufnum = INVALID_BUFNUM;
+    for (bufnum = 0; bufnum < num_buf; bufnum++) {
+        buffer_cntl_blocks[bufnum].is_referenced = false;
+        buffer_cntl_blocks[bufnum].is_in_A1in = false;
+        buffer_cntl_blocks[bufnum].A1in_tick = 0;
+        buffer_cntl_blocks[bufnum].is_dirty.store(false);
+        buffer_cntl_blocks[bufnum].recLSN.store(-1);
+        buffer_cntl_blocks[bufnum].is_recLSN_by_latch = false;
+        buffer_cntl_blocks[bufnum].number_of_pins.store(0);
+        pthread_rwlock_init(&buffer_cntl_blocks[bufnum].page_latch, NULL);
+    }
 
-    frames = (page_t*)malloc(num_buf * PAGE_SIZE);
+    frames = (page_t*)aligned_alloc(PAGE_SIZE, num_buf * PAGE_SIZE);
     if (frames == NULL) {
         perror("Memory allocation error");
         exit(EXIT_FAILURE);
     }
 
+    buffer_instances = new buffer_info_t[num_instances];
+    for (instance_num = 0; instance_num < num_instances; instance_num++) {
+        instance = &buffer_instances[instance_num];
+
+        // Split the frames as evenly as possible.
+        instance->first_bufnum = first_bufnum;
+        instance->number_of_bufs = num_buf / num_instances + (instance_num < num_buf % num_instances ? 1 : 0);
+        first_bufnum += instance->number_of_bufs;
+
+        instance->LRU_head_bufnum = INVALID_BUFNUM;
+        instance->LRU_tail_bufnum = INVALID_BUFNUM;
+        instance->first_free_bufnum = instance->first_bufnum;
+        instance->clock_hand_bufnum = instance->first_bufnum;
+        instance->A1in_head_bufnum = INVALID_BUFNUM;
+        instance->A1in_tail_bufnum = INVALID_BUFNUM;
+        instance->number_of_A1in_bufs = 0;
+        instance->A1out_seq = 0;
+        instance->number_of_hits = 0;
+        instance->number_of_misses = 0;
+        instance->page_table.reserve(instance->number_of_bufs);
+        pthread_mutex_init(&instance->instance_latch, NULL);
+
+        // free buffer list
+        for (bufnum = instance->first_bufnum; bufnum < instance->first_bufnum + instance->number_of_bufs - 1; bufnum++)
+            buffer_cntl_blocks[bufnum].free_next_bufnum = bufnum + 1;
+        // The last buffer has no next free buffer.
+        buffer_cntl_blocks[bufnum].free_next_bufnum = INVALID_BUFNUM;
+    }
+
+    buffer_cleaner_start();
+    buffer_readahead_start();
+
     if (verbose) {
         printf("|");
     }
 }
 
 void buffer_close_table_files(void) {
+    buffer_info_t* instance;
+    std::unordered_map<buffer_page_id_t, int, BufferPageHash>::iterator it;
+    int instance_num;
     int bufnum;
-    // Write all dirty pages
-    for (bufnum = buffer_info.LRU_head_bufnum; bufnum != INVALID_BUFNUM; bufnum = buffer_cntl_blocks[bufnum].LRU_next_bufnum)
-        if (buffer_cntl_blocks[bufnum].is_dirty == true) {
-            file_write_page(buffer_cntl_blocks[bufnum].table_id, buffer_cntl_blocks[bufnum].pagenum, &frames[bufnum]);
+
+    buffer_readahead_stop();
+    buffer_cleaner_stop();
+
+    // by WAL, flush all logs first.
+    log_flush();
+
+    for (instance_num = 0; instance_num < number_of_buffer_instances; instance_num++) {
+        instance = &buffer_instances[instance_num];
+        pthread_mutex_lock(&instance->instance_latch);
+        // Write all dirty pages
+        for (it = instance->page_table.begin(); it != instance->page_table.end(); it++) {
+            bufnum = it->second;
+            if (buffer_cntl_blocks[bufnum].is_dirty == true) {
+                file_write_page(buffer_cntl_blocks[bufnum].table_id, buffer_cntl_blocks[bufnum].pagenum, &frames[bufnum]);
+            }
         }
+        pthread_mutex_unlock(&instance->instance_latch);
+        pthread_mutex_destroy(&instance->instance_latch);
+    }
+    // Force the pages written without sync.
+    file_sync_table_files();
+
+    delete[] buffer_instances;
+    buffer_instances = NULL;
+    number_of_buffer_instances = 0;
     free(buffer_cntl_blocks);
     free(frames);
-}
\ No newline at end of file
+}
+
+buffer_info_t* buffer_get_instance(table_id_t table_id, pagenum_t pagenum) {
+    uint64_t hash;
+
+    // Mix the page id, so that the neighboring pages are spread over instances.
+    hash = (((uint64_t)table_id << 48) ^ pagenum) * 0x9E3779B97F4A7C15ULL;
+    return &buffer_instances[(hash >> 32) % number_of_buffer_instances];
+}
+
+int buffer_lookup_page(buffer_info_t* instance, table_id_t table_id, pagenum_t pagenum) {
+    std::unordered_map<buffer_page_id_t, int, BufferPageHash>::iterator it;
+
+    it = instance->page_table.find(buffer_page_id_t(table_id, pagenum));
+    if (it == instance->page_table.end())
+        return INVALID_BUFNUM;
+    return it->second;
+}
+
+void buffer_unlink(int* head_bufnum, int* tail_bufnum, int bufnum) {
+    int prev_bufnum = buffer_cntl_blocks[bufnum].LRU_prev_bufnum;
+    int next_bufnum = buffer_cntl_blocks[bufnum].LRU_next_bufnum;
+
+    if (prev_bufnum != INVALID_BUFNUM)
+        buffer_cntl_blocks[prev_bufnum].LRU_next_bufnum = next_bufnum;
+    else
+        *head_bufnum = next_bufnum;
+
+    if (next_bufnum != INVALID_BUFNUM)
+        buffer_cntl_blocks[next_bufnum].LRU_prev_bufnum = prev_bufnum;
+    else
+        *tail_bufnum = prev_bufnum;
+}
+
+void buffer_link_to_head(int* head_bufnum, int* tail_bufnum, int bufnum) {
+    // I. no empty list
+    if (*head_bufnum != INVALID_BUFNUM) {
+        buffer_cntl_blocks[*head_bufnum].LRU_prev_bufnum = bufnum;
+        buffer_cntl_blocks[bufnum].LRU_next_bufnum = *head_bufnum;
+        buffer_cntl_blocks[bufnum].LRU_prev_bufnum = INVALID_BUFNUM;
+        *head_bufnum = bufnum;
+    } 
+    // II. empty list
+    else {
+        buffer_cntl_blocks[bufnum].LRU_next_bufnum = INVALID_BUFNUM;
+        buffer_cntl_blocks[bufnum].LRU_prev_bufnum = INVALID_BUFNUM;
+        *head_bufnum = bufnum;
+        *tail_bufnum = bufnum;
+    }
+}
+
+// Page cleaner
+void buffer_cleaner_start(void) {
+    pthread_mutex_init(&cleaner_latch, NULL);
+    pthread_cond_init(&cleaner_cond, NULL);
+    is_cleaner_running = true;
+    if (pthread_create(&cleaner_thread, NULL, buffer_cleaner_main, NULL) != 0) {
+        perror("Thread creation failure");
+        exit(EXIT_FAILURE);
+    }
+}
+
+void buffer_cleaner_stop(void) {
+    pthread_mutex_lock(&cleaner_latch);
+    is_cleaner_running = false;
+    pthread_cond_signal(&cleaner_cond);
+    pthread_mutex_unlock(&cleaner_latch);
+
+    pthread_join(cleaner_thread, NULL);
+    pthread_cond_destroy(&cleaner_cond);
+    pthread_mutex_destroy(&cleaner_latch);
+}
+
+void* buffer_cleaner_main(void*) {
+    page_t* temp_frames;
+    struct timespec wake_time;
+    int instance_num;
+    int max_target = 1;
+
+    for (instance_num = 0; instance_num < number_of_buffer_instances; instance_num++)
+        max_target = std::max(max_target, buffer_instances[instance_num].number_of_bufs * CLEANER_TARGET_PERCENT / 100);
+    temp_frames = (page_t*)aligned_alloc(PAGE_SIZE, max_target * sizeof(page_t));
+    if (temp_frames == NULL) {
+        perror("Memory allocation error");
+        exit(EXIT_FAILURE);
+    }
+
+    pthread_mutex_lock(&cleaner_latch);
+    while (is_cleaner_running == true) {
+        // Sleep for the interval, or until a miss writes a dirty victim.
+        clock_gettime(CLOCK_REALTIME, &wake_time);
+        wake_time.tv_nsec += CLEANER_INTERVAL_MS * 1000000L;
+        wake_time.tv_sec += wake_time.tv_nsec / 1000000000L;
+        wake_time.tv_nsec %= 1000000000L;
+        pthread_cond_timedwait(&cleaner_cond, &cleaner_latch, &wake_time);
+        if (is_cleaner_running == false)
+            break;
+        pthread_mutex_unlock(&cleaner_latch);
+
+        for (instance_num = 0; instance_num < number_of_buffer_instances; instance_num++)
+            buffer_clean_instance(&buffer_instances[instance_num], temp_frames);
+
+        pthread_mutex_lock(&cleaner_latch);
+    }
+    pthread_mutex_unlock(&cleaner_latch);
+
+    free(temp_frames);
+    return NULL;
+}
+
+void buffer_clean_instance(buffer_info_t* instance, page_t* temp_frames) {
+    std::vector<int> candidates;
+    std::vector<int> batch;
+    int target;
+    int i;
+    int bufnum;
+
+    target = std::max(1, instance->number_of_bufs * CLEANER_TARGET_PERCENT / 100);
+    candidates.reserve(target);
+
+    // I. Pin the dirty pages to be evicted next.
+    pthread_mutex_lock(&instance->instance_latch);
+    buffer_policy.get_victim_candidates(instance, target, candidates);
+    for (i = 0; i < (int)candidates.size(); i++) {
+        bufnum = candidates[i];
+        if (buffer_cntl_blocks[bufnum].is_dirty == true && buffer_cntl_blocks[bufnum].number_of_pins.load() == 0) {
+            buffer_cntl_blocks[bufnum].number_of_pins++;
+            batch.push_back(bufnum);
+        }
+    }
+    pthread_mutex_unlock(&instance->instance_latch);
+
+    buffer_write_batch(batch, temp_frames);
+}
+
+void buffer_write_batch(std::vector<int>& batch, page_t* temp_frames) {
+    std::vector<file_page_io_t> ios;
+    int64_t max_LSN = -1;
+    int i;
+    int bufnum;
+
+    if (batch.empty() == true)
+        return;
+
+    // II. Write in the order of the pages in the file.
+    std::sort(batch.begin(), batch.end(), [](int a, int b) {
+        return buffer_page_id_t(buffer_cntl_blocks[a].table_id, buffer_cntl_blocks[a].pagenum)
+            < buffer_page_id_t(buffer_cntl_blocks[b].table_id, buffer_cntl_blocks[b].pagenum);
+    });
+
+    // III. Copy the pages. A page modified after the copy becomes dirty again.
+    for (i = 0; i < (int)batch.size(); i++) {
+        bufnum = batch[i];
+        pthread_rwlock_rdlock(&buffer_cntl_blocks[bufnum].page_latch);
+        memcpy(&temp_frames[i], &frames[bufnum], PAGE_SIZE);
+        buffer_cntl_blocks[bufnum].is_dirty = false;
+        pthread_rwlock_unlock(&buffer_cntl_blocks[bufnum].page_latch);
+        max_LSN = std::max(max_LSN, ((node_page_t*)&temp_frames[i])->header.LSN);
+    }
+
+    // IV. by WAL, flush the log up to the last LSN of the batch.
+    log_flush(max_LSN);
+
+    // V. Write the batch in one submission and force each table file once.
+    ios.resize(batch.size());
+    for (i = 0; i < (int)batch.size(); i++) {
+        bufnum = batch[i];
+        ios[i].table_id = buffer_cntl_blocks[bufnum].table_id;
+        ios[i].pagenum = buffer_cntl_blocks[bufnum].pagenum;
+        ios[i].page = &temp_frames[i];
+    }
+    file_write_pages(ios.data(), ios.size());
+    for (i = 0; i < (int)batch.size(); i++)
+        if (i + 1 == (int)batch.size() || ios[i + 1].table_id != ios[i].table_id)
+            file_sync_table_file(ios[i].table_id);
+
+    // VI. The pages not modified since the copy are up to date on disk. Unpin.
+    for (i = 0; i < (int)batch.size(); i++) {
+        bufnum = batch[i];
+        pthread_rwlock_rdlock(&buffer_cntl_blocks[bufnum].page_latch);
+        if (buffer_cntl_blocks[bufnum].is_dirty == false)
+            buffer_cntl_blocks[bufnum].recLSN = -1;
+        pthread_rwlock_unlock(&buffer_cntl_blocks[bufnum].page_latch);
+        buffer_cntl_blocks[bufnum].number_of_pins--;
+    }
+}
+
+void buffer_flush_old_pages(int64_t LSN) {
+    buffer_info_t* instance;
+    page_t* temp_frames;
+    std::vector<int> batch;
+    int instance_num;
+    int bufnum;
+
+    temp_frames = (page_t*)aligned_alloc(PAGE_SIZE, CHECKPOINT_BATCH_SIZE * sizeof(page_t));
+    if (temp_frames == NULL) {
+        perror("Memory allocation error");
+        exit(EXIT_FAILURE);
+    }
+
+    for (instance_num = 0; instance_num < number_of_buffer_instances; instance_num++) {
+        instance = &buffer_instances[instance_num];
+        for (bufnum = instance->first_bufnum; bufnum < instance->first_bufnum + instance->number_of_bufs; bufnum++) {
+            if (buffer_cntl_blocks[bufnum].recLSN.load() < 0 || buffer_cntl_blocks[bufnum].recLSN.load() >= LSN)
+                continue;
+
+            // Pin the page. A pinned page is skipped, until the next checkpoint.
+            pthread_mutex_lock(&instance->instance_latch);
+            if (buffer_cntl_blocks[bufnum].is_dirty == true && buffer_cntl_blocks[bufnum].number_of_pins.load() == 0) {
+                buffer_cntl_blocks[bufnum].number_of_pins++;
+                batch.push_back(bufnum);
+            }
+            pthread_mutex_unlock(&instance->instance_latch);
+
+            if ((int)batch.size() == CHECKPOINT_BATCH_SIZE) {
+                buffer_write_batch(batch, temp_frames);
+                batch.clear();
+            }
+        }
+    }
+    buffer_write_batch(batch, temp_frames);
+
+    free(temp_frames);
+}
+
+// Read-ahead
+void buffer_readahead_start(void) {
+    pthread_mutex_init(&readahead_latch, NULL);
+    pthread_cond_init(&readahead_cond, NULL);
+    readahead_queue.clear();
+    readahead_states.clear();
+    readahead_cluster_misses.clear();
+    is_readahead_running = true;
+    if (pthread_create(&readahead_thread, NULL, buffer_readahead_main, NULL) != 0) {
+        perror("Thread creation failure");
+        exit(EXIT_FAILURE);
+    }
+}
+
+void buffer_readahead_stop(void) {
+    pthread_mutex_lock(&readahead_latch);
+    is_readahead_running = false;
+    pthread_cond_signal(&readahead_cond);
+    pthread_mutex_unlock(&readahead_latch);
+
+    pthread_join(readahead_thread, NULL);
+    pthread_cond_destroy(&readahead_cond);
+    pthread_mutex_destroy(&readahead_latch);
+}
+
+void* buffer_readahead_main(void*) {
+    readahead_request_t request;
+    std::vector<pagenum_t> pagenums;
+    uint64_t number_of_pages;
+    pagenum_t pagenum;
+    int i;
+
+    pthread_mutex_lock(&readahead_latch);
+    while (true) {
+        while (readahead_queue.empty() == true && is_readahead_running == true)
+            pthread_cond_wait(&readahead_cond, &readahead_latch);
+        if (is_readahead_running == false)
+            break;
+        request = readahead_queue.front();
+        readahead_queue.pop_front();
+        pthread_mutex_unlock(&readahead_latch);
+
+        // I. along the right sibling chain.
+        if (request.type == kReadAheadLinear) {
+            // Leaves are often adjacent in the file.
+            file_advise_willneed(request.table_id, request.pagenum, READAHEAD_WINDOW);
+            pagenum = request.pagenum;
+            for (i = 0; i < READAHEAD_WINDOW && pagenum != 0; i++)
+                pagenum = buffer_prefetch_page(request.table_id, pagenum);
+        }
+        // II. the rest of the cluster.
+        else {
+            number_of_pages = file_get_number_of_pages(request.table_id);
+
+            // Read the cluster in one batch.
+            pagenums.clear();
+            for (pagenum = request.pagenum; pagenum < request.pagenum + RANDOM_READAHEAD_CLUSTER && pagenum < number_of_pages; pagenum++)
+                if (pagenum != 0)
+                    pagenums.push_back(pagenum);
+            buffer_prefetch_pages(request.table_id, pagenums);
+        }
+
+        pthread_mutex_lock(&readahead_latch);
+    }
+    pthread_mutex_unlock(&readahead_latch);
+
+    return NULL;
+}
+
+void buffer_readahead_on_leaf(table_id_t table_id, pagenum_t pagenum, pagenum_t right_sibling_pagenum) {
+    readahead_state_t* state;
+    readahead_request_t request;
+
+    // Detection is only a hint. Skip it under contention.
+    if (pthread_mutex_trylock(&readahead_latch) != 0)
+        return;
+
+    state = &readahead_states[table_id];
+    // Repeated requests of the same leaf are not counted.
+    if (pagenum != state->last_pagenum) {
+        if (pagenum == state->expected_pagenum) {
+            state->number_of_sequential++;
+        } else {
+            state->number_of_sequential = 1;
+            state->last_trigger = 0;
+        }
+        state->last_pagenum = pagenum;
+        state->expected_pagenum = right_sibling_pagenum;
+
+        // Prefetch the next window, when half of the last window is consumed.
+        if (right_sibling_pagenum != 0 && state->number_of_sequential >= READAHEAD_TRIGGER
+            && (state->last_trigger == 0 || state->number_of_sequential - state->last_trigger >= READAHEAD_WINDOW / 2)
+            && readahead_queue.size() < READAHEAD_QUEUE_SIZE) {
+            state->last_trigger = state->number_of_sequential;
+            request.type = kReadAheadLinear;
+            request.table_id = table_id;
+            request.pagenum = right_sibling_pagenum;
+            readahead_queue.push_back(request);
+            pthread_cond_signal(&readahead_cond);
+        }
+    }
+
+    pthread_mutex_unlock(&readahead_latch);
+}
+
+void buffer_readahead_on_miss(table_id_t table_id, pagenum_t pagenum) {
+    buffer_page_id_t cluster_id(table_id, pagenum / RANDOM_READAHEAD_CLUSTER);
+    readahead_request_t request;
+
+    // Detection is only a hint. Skip it under contention.
+    if (pthread_mutex_trylock(&readahead_latch) != 0)
+        return;
+
+    // Forget the old clusters.
+    if (readahead_cluster_misses.size() > 4 * READAHEAD_QUEUE_SIZE * RANDOM_READAHEAD_THRESHOLD)
+        readahead_cluster_misses.clear();
+
+    if (++readahead_cluster_misses[cluster_id] >= RANDOM_READAHEAD_THRESHOLD) {
+        readahead_cluster_misses.erase(cluster_id);
+        if (readahead_queue.size() < READAHEAD_QUEUE_SIZE) {
+            request.type = kReadAheadRandom;
+            request.table_id = table_id;
+            request.pagenum = cluster_id.second * RANDOM_READAHEAD_CLUSTER;
+            readahead_queue.push_back(request);
+            pthread_cond_signal(&readahead_cond);
+        }
+    }
+
+    pthread_mutex_unlock(&readahead_latch);
+}
+
+pagenum_t buffer_prefetch_page(table_id_t table_id, pagenum_t pagenum) {
+    buffer_info_t* instance;
+    int bufnum;
+    node_page_t* page;
+    pagenum_t right_sibling_pagenum;
+
+    // Read under instance_latch, so that a newer version of the page is never overwritten.
+    instance = buffer_get_instance(table_id, pagenum);
+    pthread_mutex_lock(&instance->instance_latch);
+    bufnum = buffer_lookup_page(instance, table_id, pagenum);
+    if (bufnum == INVALID_BUFNUM)
+        bufnum = get_new_bufnum(instance, table_id, pagenum);
+    buffer_cntl_blocks[bufnum].number_of_pins++;
+    pthread_mutex_unlock(&instance->instance_latch);
+
+    // Get the next leaf.
+    pthread_rwlock_rdlock(&buffer_cntl_blocks[bufnum].page_latch);
+    page = (node_page_t*)&frames[bufnum];
+    right_sibling_pagenum = page->header.is_leaf == 1 ? page->header.right_sibling_pagenum : 0;
+    pthread_rwlock_unlock(&buffer_cntl_blocks[bufnum].page_latch);
+    buffer_cntl_blocks[bufnum].number_of_pins--;
+
+    return right_sibling_pagenum;
+}
+
+void buffer_prefetch_pages(table_id_t table_id, std::vector<pagenum_t>& pagenums) {
+    buffer_info_t* instance;
+    std::vector<file_page_io_t> ios;
+    std::vector<int> bufnums;
+    // buffers held by the batch in each instance
+    std::unordered_map<buffer_info_t*, int> number_of_held_bufs;
+    file_page_io_t io;
+    int bufnum;
+    int i, j;
+
+    for (i = 0; i < (int)pagenums.size(); i++) {
+        // I. Take a buffer for the page if not resident. Hold it pinned and latched until read,
+        // so that a request of the page waits for the batch.
+        instance = buffer_get_instance(table_id, pagenums[i]);
+        pthread_mutex_lock(&instance->instance_latch);
+        if (buffer_lookup_page(instance, table_id, pagenums[i]) == INVALID_BUFNUM) {
+            bufnum = get_new_bufnum(instance, table_id, pagenums[i], false);
+            buffer_cntl_blocks[bufnum].number_of_pins++;
+            // Nobody else holds the latch of an unpinned buffer.
+            pthread_rwlock_wrlock(&buffer_cntl_blocks[bufnum].page_latch);
+            io.table_id = table_id;
+            io.pagenum = pagenums[i];
+            io.page = &frames[bufnum];
+            ios.push_back(io);
+            bufnums.push_back(bufnum);
+            number_of_held_bufs[instance]++;
+        }
+        pthread_mutex_unlock(&instance->instance_latch);
+
+        // II. Read the batch in one submission, at the end or before it holds half of an instance.
+        if (i + 1 == (int)pagenums.size() || number_of_held_bufs[instance] * 2 >= instance->number_of_bufs) {
+            file_read_pages(ios.data(), ios.size());
+            // Unlatch and unpin.
+            for (j = 0; j < (int)bufnums.size(); j++) {
+                pthread_rwlock_unlock(&buffer_cntl_blocks[bufnums[j]].page_latch);
+                buffer_cntl_blocks[bufnums[j]].number_of_pins--;
+            }
+            ios.clear();
+            bufnums.clear();
+            number_of_held_bufs.clear();
+        }
+    }
+}
+
+void buffer_get_dirty_pages(std::vector<dirty_page_entry_t>& dirty_pages) {
+    buffer_info_t* instance;
+    std::unordered_map<buffer_page_id_t, int, BufferPageHash>::iterator it;
+    dirty_page_entry_t entry;
+    int instance_num;
+
+    for (instance_num = 0; instance_num < number_of_buffer_instances; instance_num++) {
+        instance = &buffer_instances[instance_num];
+        pthread_mutex_lock(&instance->instance_latch);
+        for (it = instance->page_table.begin(); it != instance->page_table.end(); it++) {
+            entry.recLSN = buffer_cntl_blocks[it->second].recLSN.load();
+            if (entry.recLSN < 0)
+                continue;
+            entry.table_id = it->first.first;
+            entry.pagenum = it->first.second;
+            dirty_pages.push_back(entry);
+        }
+        pthread_mutex_unlock(&instance->instance_latch);
+    }
+}
+
+int buffer_get_number_of_frames(void) {
+    int number_of_frames = 0;
+    int instance_num;
+
+    for (instance_num = 0; instance_num < number_of_buffer_instances; instance_num++)
+        number_of_frames += buffer_instances[instance_num].number_of_bufs;
+    return number_of_frames;
+}
+
+void buffer_get_stats(uint64_t* hits, uint64_t* misses) {
+    buffer_info_t* instance;
+    int instance_num;
+
+    *hits = 0;
+    *misses = 0;
+    for (instance_num = 0; instance_num < number_of_buffer_instances; instance_num++) {
+        instance = &buffer_instances[instance_num];
+        pthread_mutex_lock(&instance->instance_latch);
+        *hits += instance->number_of_hits;
+        *misses += instance->number_of_misses;
+        pthread_mutex_unlock(&instance->instance_latch);
+    }
+}
+
+// Replacement policies
+
+// LRU
+void LRU_on_load(buffer_info_t* instance, int bufnum) {
+    buffer_link_to_head(&instance->LRU_head_bufnum, &instance->LRU_tail_bufnum, bufnum);
+}
+
+void LRU_on_hit(buffer_info_t* instance, int bufnum) {
+    // Move to the LRU head.
+    if (bufnum == instance->LRU_head_bufnum)
+        return;
+    buffer_unlink(&instance->LRU_head_bufnum, &instance->LRU_tail_bufnum, bufnum);
+    buffer_link_to_head(&instance->LRU_head_bufnum, &instance->LRU_tail_bufnum, bufnum);
+}
+
+void LRU_on_remove(buffer_info_t* instance, int bufnum) {
+    buffer_unlink(&instance->LRU_head_bufnum, &instance->LRU_tail_bufnum, bufnum);
+}
+
+int LRU_pick_victim(buffer_info_t* instance) {
+    int bufnum;
+
+    // Get unpinned LRU buffer number.
+    for (bufnum = instance->LRU_tail_bufnum; bufnum != INVALID_BUFNUM; bufnum = buffer_cntl_blocks[bufnum].LRU_prev_bufnum)
+        if (buffer_cntl_blocks[bufnum].number_of_pins.load() == 0) {
+            buffer_unlink(&instance->LRU_head_bufnum, &instance->LRU_tail_bufnum, bufnum);
+            return bufnum;
+        }
+    return INVALID_BUFNUM;
+}
+
+void LRU_get_victim_candidates(buffer_info_t* instance, int count, std::vector<int>& bufnums) {
+    int bufnum;
+
+    for (bufnum = instance->LRU_tail_bufnum; bufnum != INVALID_BUFNUM && count > 0; bufnum = buffer_cntl_blocks[bufnum].LRU_prev_bufnum, count--)
+        bufnums.push_back(bufnum);
+}
+
+// CLOCK
+// The frames of the instance form the clock. Victims are picked only when the free list is empty,
+// so every frame the hand passes holds a page.
+void clock_on_load(buffer_info_t*, int bufnum) {
+    buffer_cntl_blocks[bufnum].is_referenced = true;
+}
+
+void clock_on_hit(buffer_info_t*, int bufnum) {
+    buffer_cntl_blocks[bufnum].is_referenced = true;
+}
+
+void clock_on_remove(buffer_info_t*, int bufnum) {
+    buffer_cntl_blocks[bufnum].is_referenced = false;
+}
+
+int clock_pick_victim(buffer_info_t* instance) {
+    int bufnum;
+    int count;
+
+    // Two rounds are enough to clear every reference bit.
+    for (count = 0; count < 2 * instance->number_of_bufs; count++) {
+        bufnum = instance->clock_hand_bufnum;
+        instance->clock_hand_bufnum++;
+        if (instance->clock_hand_bufnum == instance->first_bufnum + instance->number_of_bufs)
+            instance->clock_hand_bufnum = instance->first_bufnum;
+
+        if (buffer_cntl_blocks[bufnum].number_of_pins.load() != 0)
+            continue;
+        // Give a second chance.
+        if (buffer_cntl_blocks[bufnum].is_referenced == true) {
+            buffer_cntl_blocks[bufnum].is_referenced = false;
+            continue;
+        }
+        return bufnum;
+    }
+    return INVALID_BUFNUM;
+}
+
+void clock_get_victim_candidates(buffer_info_t* instance, int count, std::vector<int>& bufnums) {
+    int bufnum = instance->clock_hand_bufnum;
+    int i;
+
+    // The frames ahead of the hand, unreferenced ones first.
+    for (i = 0; i < instance->number_of_bufs && (int)bufnums.size() < count; i++) {
+        if (buffer_cntl_blocks[bufnum].is_referenced == false)
+            bufnums.push_back(bufnum);
+        bufnum = (bufnum + 1 == instance->first_bufnum + instance->number_of_bufs) ? instance->first_bufnum : bufnum + 1;
+    }
+    for (i = 0; i < instance->number_of_bufs && (int)bufnums.size() < count; i++) {
+        if (buffer_cntl_blocks[bufnum].is_referenced == true)
+            bufnums.push_back(bufnum);
+        bufnum = (bufnum + 1 == instance->first_bufnum + instance->number_of_bufs) ? instance->first_bufnum : bufnum + 1;
+    }
+}
+
+// 2Q
+// A page enters A1in on its first reference and is promoted to Am (LRU list)
+// only if it is referenced again after the correlated reference period, or after being evicted from A1in.
+// Repeated requests of a page within one operation (e.g. a leaf in a scan) are correlated,
+// therefore a sequential scan only cycles through A1in.
+void two_q_on_load(buffer_info_t* instance, int bufnum) {
+    buffer_page_id_t page_id(buffer_cntl_blocks[bufnum].table_id, buffer_cntl_blocks[bufnum].pagenum);
+    std::unordered_map<buffer_page_id_t, uint64_t, BufferPageHash>::iterator it;
+
+    it = instance->A1out_table.find(page_id);
+    // I. recently evicted from A1in. Hot page, into Am.
+    if (it != instance->A1out_table.end()) {
+        instance->A1out_table.erase(it);
+        buffer_cntl_blocks[bufnum].is_in_A1in = false;
+        buffer_link_to_head(&instance->LRU_head_bufnum, &instance->LRU_tail_bufnum, bufnum);
+    }
+    // II. first reference, into A1in.
+    else {
+        buffer_cntl_blocks[bufnum].is_in_A1in = true;
+        buffer_cntl_blocks[bufnum].A1in_tick = instance->number_of_hits + instance->number_of_misses;
+        buffer_link_to_head(&instance->A1in_head_bufnum, &instance->A1in_tail_bufnum, bufnum);
+        instance->number_of_A1in_bufs++;
+    }
+}
+
+void two_q_on_hit(buffer_info_t* instance, int bufnum) {
+    uint64_t correlated_period;
+
+    // I. hit in A1in.
+    if (buffer_cntl_blocks[bufnum].is_in_A1in == true) {
+        // A hit within the correlated reference period is ignored.
+        correlated_period = instance->number_of_bufs * TWO_Q_A1IN_PERCENT / 100;
+        if (instance->number_of_hits + instance->number_of_misses - buffer_cntl_blocks[bufnum].A1in_tick <= correlated_period)
+            return;
+        // Promote to Am.
+        buffer_unlink(&instance->A1in_head_bufnum, &instance->A1in_tail_bufnum, bufnum);
+        instance->number_of_A1in_bufs--;
+        buffer_cntl_blocks[bufnum].is_in_A1in = false;
+        buffer_link_to_head(&instance->LRU_head_bufnum, &instance->LRU_tail_bufnum, bufnum);
+    }
+    // II. hit in Am. Move to the head.
+    else if (bufnum != instance->LRU_head_bufnum) {
+        buffer_unlink(&instance->LRU_head_bufnum, &instance->LRU_tail_bufnum, bufnum);
+        buffer_link_to_head(&instance->LRU_head_bufnum, &instance->LRU_tail_bufnum, bufnum);
+    }
+}
+
+void two_q_on_remove(buffer_info_t* instance, int bufnum) {
+    if (buffer_cntl_blocks[bufnum].is_in_A1in == true) {
+        buffer_unlink(&instance->A1in_head_bufnum, &instance->A1in_tail_bufnum, bufnum);
+        instance->number_of_A1in_bufs--;
+        buffer_cntl_blocks[bufnum].is_in_A1in = false;
+    } else {
+        buffer_unlink(&instance->LRU_head_bufnum, &instance->LRU_tail_bufnum, bufnum);
+    }
+}
+
+int two_q_pick_victim(buffer_info_t* instance) {
+    int bufnum;
+    int A1out_size;
+    buffer_page_id_t page_id;
+    bool is_A1in_first;
+
+    // Evict from A1in if it exceeds its share, otherwise from Am.
+    // If there is no unpinned buffer in that queue, try the other.
+    is_A1in_first = (instance->number_of_A1in_bufs * 100 > instance->number_of_bufs * TWO_Q_A1IN_PERCENT)
+        || instance->LRU_tail_bufnum == INVALID_BUFNUM;
+
+    if (is_A1in_first == true) {
+        for (bufnum = instance->A1in_tail_bufnum; bufnum != INVALID_BUFNUM; bufnum = buffer_cntl_blocks[bufnum].LRU_prev_bufnum)
+            if (buffer_cntl_blocks[bufnum].number_of_pins.load() == 0)
+                break;
+    } else {
+        for (bufnum = instance->LRU_tail_bufnum; bufnum != INVALID_BUFNUM; bufnum = buffer_cntl_blocks[bufnum].LRU_prev_bufnum)
+            if (buffer_cntl_blocks[bufnum].number_of_pins.load() == 0)
+                break;
+    }
+    if (bufnum == INVALID_BUFNUM) {
+        for (bufnum = (is_A1in_first ? instance->LRU_tail_bufnum : instance->A1in_tail_bufnum); bufnum != INVALID_BUFNUM; bufnum = buffer_cntl_blocks[bufnum].LRU_prev_bufnum)
+            if (buffer_cntl_blocks[bufnum].number_of_pins.load() == 0)
+                break;
+    }
+    if (bufnum == INVALID_BUFNUM)
+        return INVALID_BUFNUM;
+
+    // Remember the page evicted from A1in in A1out.
+    if (buffer_cntl_blocks[bufnum].is_in_A1in == true) {
+        page_id = buffer_page_id_t(buffer_cntl_blocks[bufnum].table_id, buffer_cntl_blocks[bufnum].pagenum);
+        instance->A1out_seq++;
+        instance->A1out_table[page_id] = instance->A1out_seq;
+        instance->A1out_queue.push_back(std::make_pair(page_id, instance->A1out_seq));
+
+        // Forget the oldest pages. Stale entries in the queue are skipped.
+        A1out_size = instance->number_of_bufs * TWO_Q_A1OUT_PERCENT / 100 + 1;
+        while ((int)instance->A1out_table.size() > A1out_size || instance->A1out_queue.size() > 2 * (size_t)A1out_size) {
+            std::unordered_map<buffer_page_id_t, uint64_t, BufferPageHash>::iterator it = instance->A1out_table.find(instance->A1out_queue.front().first);
+            if (it != instance->A1out_table.end() && it->second == instance->A1out_queue.front().second)
+                instance->A1out_table.erase(it);
+            instance->A1out_queue.pop_front();
+        }
+    }
+
+    two_q_on_remove(instance, bufnum);
+    return bufnum;
+}
+
+void two_q_get_victim_candidates(buffer_info_t* instance, int count, std::vector<int>& bufnums) {
+    int bufnum;
+    bool is_A1in_first;
+
+    // The same order as two_q_pick_victim.
+    is_A1in_first = (instance->number_of_A1in_bufs * 100 > instance->number_of_bufs * TWO_Q_A1IN_PERCENT)
+        || instance->LRU_tail_bufnum == INVALID_BUFNUM;
+
+    for (bufnum = (is_A1in_first ? instance->A1in_tail_bufnum : instance->LRU_tail_bufnum); bufnum != INVALID_BUFNUM && (int)bufnums.size() < count; bufnum = buffer_cntl_blocks[bufnum].LRU_prev_bufnum)
+        bufnums.push_back(bufnum);
+    for (bufnum = (is_A1in_first ? instance->LRU_tail_bufnum : instance->A1in_tail_bufnum); bufnum != INVALID_BUFNUM && (int)bufnums.size() < count; bufnum = buffer_cntl_blocks[bufnum].LRU_prev_bufnum)
+        bufnums.push_back(bufnum);
+}
@@ -1,17 +1,20 @@
 #include "file.h"
 
-#include <unistd.h>         // for read(), write(), fsync()
+#include <unistd.h>         // for read(), write(), fsync(), fdatasync()
 #include <fcntl.h>          // for open()
 #include <sys/types.h>
 #include <sys/stat.h>
 
+#include <pthread.h>
+#include <errno.h>
 #include <stdio.h>
-#include <stdlib.h>         // for exit()
+#include <stdlib.h>         // for exit(), aligned_alloc()
 #include <stdint.h>
 #include <vector>
 #include <string.h>         // for memset()
 #include <utility>
-#include <unordered_map>
+#include <algorithm>
+#include <atomic>
 
 #include "page.h"
 #include "log.h"
@@ -23,19 +26,23 @@ extern bool verbose;
 
 // Data structure used in disk space management layer.
 // std::vector< std::pair<const char*, int> > tid_vector_path_fd;
-std::unordered_map< int, int> map_tid_fd;
+// Registered tables indexed by table id. NULL, if not registered.
+std::atomic<file_table_t*> table_registry[MAX_TABLES];
+// Protect the registration and the fd pool.
+pthread_mutex_t table_registry_latch = PTHREAD_MUTEX_INITIALIZER;
+std::vector<table_id_t> registered_table_ids;
+// The fd pool. Tables whose file is open, and the CLOCK hand.
+std::vector<file_table_t*> open_tables;
+int open_tables_hand = 0;
+// Open the table files with O_DIRECT.
+bool is_direct_io = false;
 
 // Open existing database file or create one if not existed.
 // Return new table_id.
 int64_t file_open_table_file(const char* pathname) {
     
     table_id_t tid;
-    int is_new_file;
-    int fd;
-    file_manager_page_t *header_page;
-    pagenum_t free_pagenum;
-    file_manager_page_t *free_page;
-    int i;
+    file_table_t* table;
     char* end;
 
     if (verbose) {
@@ -44,90 +51,41 @@ int64_t file_open_table_file(const char* pathname) {
 
     // Get table id from pathname.
     tid = strtol(pathname + 4, &end, 10);
-    if (end != NULL) {
+    if (end == pathname + 4 || *end != '\0') {
         return -1;
     }
 
-    // // I. The table file is opened.
-    // for (tid = 0; tid < tid_vector_path_fd.size(); tid++)
-    //     if (strcmp(tid_vector_path_fd[tid].first, pathname) == 0)
-    //         return tid;
-
-    // // II. The table not yet opened. But the number of tables exceeds MAX_TABLES.
-    // if (tid_vector_path_fd.size() == MAX_TABLES)
-    //     return -1;
-    
-    // I. The table file is opened.
-    if (map_tid_fd.find(tid) != map_tid_fd.end())
-        return tid;
-    
-    // II. The table not yet opened. But the number of tables exceeds MAX_TABLES.
-    if (map_tid_fd.size() == MAX_TABLES)
+    // I. The table id is out of the registry.
+    if (tid < 0 || tid >= MAX_TABLES)
         return -1;
 
-    // III. Get the table file.
-    is_new_file = access(pathname, F_OK);
-    // III-1. Open the table file.
-    fd = open(pathname, O_RDWR|O_CREAT, 0777);
-    if (fd < 0) {
-        perror("File open failure");
-        exit(EXIT_FAILURE);
-    }
-
-    // III-2. Create the table file.
-    if (is_new_file != 0) {
-        if (verbose) {
-            printf("(newly created file");
-        }
-        // Update the metadata in the header page. (Alloc, modify, write)
-        header_page = (file_manager_page_t*)malloc(PAGE_SIZE);
-        if (header_page == NULL) {
-            perror("Memory allocation error");
-            exit(EXIT_FAILURE);
-        }
-        header_page->first_free_pagenum = 1;
-        header_page->number_of_pages = 2560;    // 10M / 4K
-        if (pwrite(fd, header_page, PAGE_SIZE, 0) != PAGE_SIZE) {
-            perror("File write failure");
-            exit(EXIT_FAILURE);
-        }
-        free(header_page);
+    // II. The table is registered.
+    if (table_registry[tid].load() != NULL)
+        return tid;
 
-        // Update the newly created free pages. (Alloc, modify, write)
-        free_page = (file_manager_page_t*)malloc(PAGE_SIZE);
-        if (free_page == NULL) {
-            perror("Memory allocation error");
-            exit(EXIT_FAILURE);
+    // III. Register the table, and open the table file.
+    pthread_mutex_lock(&table_registry_latch);
+    if (table_registry[tid].load() == NULL) {
+        table = new file_table_t;
+        table->pathname = pathname;
+        table->fd = -1;
+        table->number_of_users = 0;
+        table->is_referenced = true;
+        table->is_unsynced = false;
+        table->free_count = 0;
+        table->space = NULL;
+        // Loaded at the first open.
+        table->header.number_of_pages = 0;
+        if (file_open_fd(table) < 0) {
+            pthread_mutex_unlock(&table_registry_latch);
+            delete table;
             return -1;
         }
-        for (free_pagenum = 1; free_pagenum < 2559; free_pagenum++) {
-            if (verbose) {
-                printf(".");
-            }
-            free_page->next_free_pagenum = free_pagenum + 1;
-            if (pwrite(fd, free_page, PAGE_SIZE, PAGE_OFFSET(free_pagenum)) != PAGE_SIZE) {
-                perror("File write failure");
-                exit(EXIT_FAILURE);
-            }
-        }
-        // Update the last free page.
-        free_page->next_free_pagenum = 0;
-        if (pwrite(fd, free_page, PAGE_SIZE, PAGE_OFFSET(free_pagenum)) != PAGE_SIZE) {
-            perror("File write failure");
-            exit(EXIT_FAILURE);
-        }
-        free(free_page);
-    }
-
-    // Add table_id, pathname and opened fd to tid vector.
-    map_tid_fd[tid] = fd;
-    // tid = tid_vector_path_fd.size();
-    // tid_vector_path_fd.push_back(make_pair(pathname, fd));
 
-    if (fsync(fd)< 0) {
-        perror("File sync failure");
-        exit (EXIT_FAILURE);
+        registered_table_ids.push_back(tid);
+        table_registry[tid].store(table);
     }
+    pthread_mutex_unlock(&table_registry_latch);
     
     if (verbose) {
         printf("(tid: %ld)|", tid);
@@ -136,128 +94,112 @@ int64_t file_open_table_file(const char* pathname) {
     return tid;
 }
 
-// Allocate an on-disk page from the free page list.
-pagenum_t file_alloc_page(table_id_t table_id) {
+// Allocate an on-disk page.
+pagenum_t file_alloc_page(table_id_t table_id, pagenum_t near_pagenum) {
 
     int fd;
-    file_manager_page_t *header_page;
-    pagenum_t first_free_pagenum;
-    pagenum_t free_pagenum;
-    file_manager_page_t *free_page;
-    file_manager_page_t *first_free_page;
+    file_table_t* table;
+    file_space_t* space;
+    file_header_t* header;
+    pagenum_t pagenum;
+    uint64_t number_of_pages;
+    uint64_t old_number_of_pages;
+    uint64_t group;
 
     if (verbose) {
         printf("\t|file_alloc_page");
     }
 
-    // Convert the table id to the mapped file.
-    // fd = tid_vector_path_fd[table_id].second;
-    fd = file_convert_tid_to_fd(table_id);
-
-    // Read the header page.
-    wrapper_read(fd, 0, header_page);
-
-    // If there is no page in the free page list,
-    // Double the current file. Allocate as much as the current DB size.
-    if (header_page->first_free_pagenum == 0) {
+    // Convert the table id to the opened file.
+    fd = file_acquire_fd(table_id);
+    table = table_registry[table_id].load();
+    space = table->space;
+    header = &table->header;
+
+    pthread_mutex_lock(&space->space_latch);
+    number_of_pages = header->number_of_pages.load();
+
+    // I. Look for the free page next to near_pagenum, then from the first free page.
+    pagenum = INVALID_PAGENUM;
+    if (near_pagenum != 0)
+        pagenum = file_bitmap_find_free(space, near_pagenum + 1, std::min(near_pagenum + 1 + FILE_EXTENT_PAGES, number_of_pages));
+    if (pagenum == INVALID_PAGENUM)
+        pagenum = file_bitmap_find_free(space, header->first_free_pagenum.load(), number_of_pages);
+
+    // II. If there is no free page, double the current file in one call.
+    // Allocate as much as the current DB size, in extents.
+    if (pagenum == INVALID_PAGENUM) {
         if (verbose) {
-            printf("(no free page list)");
+            printf("(no free page)");
         }
-        // Modify the metadata in header page.
-        header_page->first_free_pagenum = header_page->number_of_pages;
-        header_page->number_of_pages *= 2;
-
-        // Update the newly created free pages. (Alloc, modify, write)
-        free_page = (file_manager_page_t*)malloc(PAGE_SIZE);
-        if (free_page == NULL) {
-            perror("Memory allocation error");
-            exit(EXIT_FAILURE);
-        }
-        for (free_pagenum = header_page->first_free_pagenum; free_pagenum < header_page->number_of_pages - 1; free_pagenum++ ) {
-            free_page->next_free_pagenum = free_pagenum + 1;
-            if (pwrite(fd, free_page, PAGE_SIZE, PAGE_OFFSET(free_pagenum)) != PAGE_SIZE) {
-                perror("File write failure");
-                exit(EXIT_FAILURE);
-            }
+        old_number_of_pages = number_of_pages;
+        number_of_pages = (old_number_of_pages * 2 + FILE_EXTENT_PAGES - 1) / FILE_EXTENT_PAGES * FILE_EXTENT_PAGES;
+        file_extend(fd, old_number_of_pages, number_of_pages);
+
+        // Add the bitmaps of the new groups. Each is written at its first allocation.
+        for (group = space->bitmaps.size(); group * PAGES_PER_BITMAP < number_of_pages; group++) {
+            space->bitmaps.resize(group + 1);
+            file_bitmap_init_group(space, group);
         }
-        // Update the last free page.
-        free_page->next_free_pagenum = 0;
-        if (pwrite(fd, free_page, PAGE_SIZE, PAGE_OFFSET(free_pagenum)) != PAGE_SIZE) {
-            perror("File write failure");
-            exit(EXIT_FAILURE);
-        }
-        free(free_page);
-    }
 
-    // Get the first free page number.
-    first_free_pagenum = header_page->first_free_pagenum;
-    // Read the first free page.
-    wrapper_read(fd, first_free_pagenum, first_free_page);
+        // Modify the metadata in the header page. Written at the next sync.
+        // A file larger than its header page is taken as is, when loaded.
+        header->number_of_pages = number_of_pages;
+        header->is_dirty = true;
 
-    // Modify the metadata in the header page.
-    header_page->first_free_pagenum = first_free_page->next_free_pagenum;
-    if (verbose) {
-        printf(" first_free_pn: %ld, next: %ld", first_free_pagenum, header_page->first_free_pagenum);
-    }
-    if (pwrite(fd, header_page, PAGE_SIZE, 0) != PAGE_SIZE) {
-        perror("File write failure");
-        exit(EXIT_FAILURE);
+        pagenum = file_bitmap_find_free(space, old_number_of_pages, number_of_pages);
     }
-    free(header_page);
 
-    // Initialize the first free page that will be allocated.
-    memset (first_free_page, 0, PAGE_SIZE);
-    if (pwrite(fd, first_free_page, PAGE_SIZE, PAGE_OFFSET(first_free_pagenum)) != PAGE_SIZE) {
-        perror("File write failure");
-        exit(EXIT_FAILURE);
-    }
-    free(first_free_page);
+    // III. Mark the page allocated.
+    // The bitmap page is not forced here. It reaches the disk with the next fsync of the file,
+    // which precedes any page pointing to the new page.
+    file_bitmap_set(space, pagenum, true);
+    file_write_bitmap(fd, space, pagenum / PAGES_PER_BITMAP);
+    table->is_unsynced = true;
+    if (pagenum == header->first_free_pagenum.load())
+        header->first_free_pagenum = pagenum + 1;
 
-    if (fsync(fd) < 0) {
-        perror("File sync failure");
-        exit(EXIT_FAILURE);
-    }
+    pthread_mutex_unlock(&space->space_latch);
 
     if (verbose) {
-        printf("|");;
+        printf(" pn: %ld, first_free_pn: %ld|", pagenum, header->first_free_pagenum.load());
     }
 
-    return first_free_pagenum;
+    file_release_fd(table_id);
+
+    return pagenum;
 }
 
-// Free an on-disk page to the free page list.
+// Free an on-disk page.
 void file_free_page(table_id_t table_id, pagenum_t pagenum) {
 
     int fd;
-    file_manager_page_t *header_page;
-    file_manager_page_t *new_free_page;
+    file_table_t* table;
+    file_space_t* space;
 
     if (verbose) {
         printf(" |file_free_page");
     }
-    // Convert the table id to the mapped file.
-    // fd = tid_vector_path_fd[table_id].second;
-    fd = file_convert_tid_to_fd(table_id);
+    // Convert the table id to the opened file.
+    fd = file_acquire_fd(table_id);
+    table = table_registry[table_id].load();
+    space = table->space;
 
-    // Read the pages.
-    wrapper_read(fd, 0, header_page);
-    wrapper_read(fd, pagenum, new_free_page);
+    pthread_mutex_lock(&space->space_latch);
 
-    // Add the page in free page list.
-    new_free_page->next_free_pagenum = header_page->first_free_pagenum;
-    header_page->first_free_pagenum = pagenum;
+    // Counted before the page may be allocated again.
+    table->free_count++;
 
-    // Write the pages.
-    if (pwrite(fd, header_page, PAGE_SIZE, 0) != PAGE_SIZE) {
-        perror("File write failure");
-        exit(EXIT_FAILURE);
-    }
-    free(header_page);
-    if (pwrite(fd, new_free_page, PAGE_SIZE, PAGE_OFFSET(pagenum)) != PAGE_SIZE) {
-        perror("File write failure");
-        exit(EXIT_FAILURE);
-    }
-    free(new_free_page);
+    // Clear the bit in the bitmap.
+    file_bitmap_set(space, pagenum, false);
+    file_write_bitmap(fd, space, pagenum / PAGES_PER_BITMAP);
+    table->is_unsynced = true;
+    if (pagenum < table->header.first_free_pagenum.load())
+        table->header.first_free_pagenum = pagenum;
+
+    pthread_mutex_unlock(&space->space_latch);
+
+    file_release_fd(table_id);
 
     if (verbose) {
         printf(" |");
@@ -267,44 +209,133 @@ void file_free_page(table_id_t table_id, pagenum_t pagenum) {
 // Read an on-disk page into the in-memory page structure(dest).
 void file_read_page(table_id_t table_id, pagenum_t pagenum, page_t* dest) {
     
-    int fd;
+    io_request_t request;
 
-    // Convert the table id to the mapped file.
-    // fd = tid_vector_path_fd[table_id].second;
-    fd = file_convert_tid_to_fd(table_id);
+    // Convert the table id to the opened file.
+    request.fd = file_acquire_fd(table_id);
+    request.is_write = false;
+    request.buf = dest;
+    request.length = PAGE_SIZE;
+    request.offset = PAGE_OFFSET(pagenum);
 
-    if (pread(fd, dest, PAGE_SIZE, PAGE_OFFSET(pagenum)) != PAGE_SIZE) {
-        perror("File read failure");
-        exit(EXIT_FAILURE);
-    }
+    io_submit_and_wait(&request, 1);
+
+    file_release_fd(table_id);
 }
 
 // Write an in-memory page(src) to the on-disk page.
 void file_write_page(table_id_t table_id, pagenum_t pagenum, const page_t* src){
 
-    int fd;
+    io_request_t request;
 
-    // Convert the table id to the mapped file.
-    // fd = tid_vector_path_fd[table_id].second;
-    fd = file_convert_tid_to_fd(table_id);
+    // For recovery, by WAL, flush the log up to the page LSN before writing.
+    log_flush(((const page_header_t*)src)->LSN);
 
-    // For recovery, by WAL, flush the log buffer before forcing.
-    log_flush();
+    // Convert the table id to the opened file.
+    request.fd = file_acquire_fd(table_id);
+    request.is_write = true;
+    request.buf = (void*)src;
+    request.length = PAGE_SIZE;
+    request.offset = PAGE_OFFSET(pagenum);
 
-    if (pwrite(fd, src, PAGE_SIZE, PAGE_OFFSET(pagenum)) != PAGE_SIZE) {
-        perror("File write failure");
-        exit(EXIT_FAILURE);
-    }
-    if (fsync(fd) < 0) {
+    io_submit_and_wait(&request, 1);
+#if FORCE_PAGE_WRITES
+    if (fdatasync(request.fd) < 0) {
         perror("File sync failure");
         exit (EXIT_FAILURE);
     }
+#else
+    table_registry[table_id].load()->is_unsynced = true;
+#endif
+
+    file_release_fd(table_id);
+}
+
+// Read the on-disk pages in one batch.
+void file_read_pages(file_page_io_t* ios, int count) {
+    std::vector<io_request_t> requests(count);
+    int i;
+
+    for (i = 0; i < count; i++) {
+        requests[i].fd = file_acquire_fd(ios[i].table_id);
+        requests[i].is_write = false;
+        requests[i].buf = ios[i].page;
+        requests[i].length = PAGE_SIZE;
+        requests[i].offset = PAGE_OFFSET(ios[i].pagenum);
+    }
+    io_submit_and_wait(requests.data(), count);
+
+    for (i = 0; i < count; i++)
+        file_release_fd(ios[i].table_id);
+}
+
+// Write the in-memory pages in one batch without forcing.
+void file_write_pages(file_page_io_t* ios, int count) {
+    std::vector<io_request_t> requests(count);
+    int i;
+
+    for (i = 0; i < count; i++) {
+        requests[i].fd = file_acquire_fd(ios[i].table_id);
+        requests[i].is_write = true;
+        requests[i].buf = ios[i].page;
+        requests[i].length = PAGE_SIZE;
+        requests[i].offset = PAGE_OFFSET(ios[i].pagenum);
+    }
+    io_submit_and_wait(requests.data(), count);
+
+    for (i = 0; i < count; i++) {
+        table_registry[ios[i].table_id].load()->is_unsynced = true;
+        file_release_fd(ios[i].table_id);
+    }
+}
+
+// Force the writes of the table file.
+void file_sync_table_file(table_id_t table_id) {
+    int fd;
+
+    fd = file_acquire_fd(table_id);
+    // A write after this is synced next time.
+    table_registry[table_id].load()->is_unsynced = false;
+    if (fdatasync(fd) < 0) {
+        perror("File sync failure");
+        exit(EXIT_FAILURE);
+    }
+    file_release_fd(table_id);
+}
+
+// Write the header pages and force the writes of every table file.
+// A file closed by the fd pool was forced when closed.
+void file_sync_table_files(void) {
+    int i;
+
+    // An fd is closed only under table_registry_latch.
+    pthread_mutex_lock(&table_registry_latch);
+    for (i = 0; i < (int)open_tables.size(); i++) {
+        file_write_header(open_tables[i], open_tables[i]->fd.load());
+        if (open_tables[i]->is_unsynced.exchange(false) == false)
+            continue;
+        if (fdatasync(open_tables[i]->fd.load()) < 0) {
+            perror("File sync failure");
+            exit(EXIT_FAILURE);
+        }
+    }
+    pthread_mutex_unlock(&table_registry_latch);
+}
+
+// Hint the kernel that the pages [pagenum, pagenum + count) will be read soon.
+void file_advise_willneed(table_id_t table_id, pagenum_t pagenum, int count) {
+    // Only a hint. Ignore the failure. The page cache is not used by direct I/O.
+    if (is_direct_io == true)
+        return;
+    posix_fadvise(file_acquire_fd(table_id), PAGE_OFFSET(pagenum), (off_t)count * PAGE_SIZE, POSIX_FADV_WILLNEED);
+    file_release_fd(table_id);
 }
 
 // Stop referencing the database file
 void file_close_table_files(void) {
 
-    table_id_t tid;
+    file_table_t* table;
+    int i;
     
     // for (tid = 0; tid < tid_vector_path_fd.size(); tid++)
     //     if ( close(tid_vector_path_fd[tid].second) < 0){
@@ -313,28 +344,340 @@ void file_close_table_files(void) {
     //     }
 
     // tid_vector_path_fd.clear();  
-    for(std::unordered_map< int, int>::iterator it = map_tid_fd.begin(); it != map_tid_fd.end(); it++) 
-        if (close(it->second) < 0) {
+    pthread_mutex_lock(&table_registry_latch);
+    for (i = 0; i < (int)registered_table_ids.size(); i++) {
+        table = table_registry[registered_table_ids[i]].load();
+        table_registry[registered_table_ids[i]].store(NULL);
+        if (table->fd.load() >= 0) {
+            if (close(table->fd.load()) < 0) {
+                perror("File close failure");
+                exit(EXIT_FAILURE);
+            }
+            pthread_mutex_destroy(&table->space->space_latch);
+            delete table->space;
+        }
+        delete table;
+    }
+    registered_table_ids.clear();
+    open_tables.clear();
+    open_tables_hand = 0;
+    pthread_mutex_unlock(&table_registry_latch);
+
+    io_shutdown();
+}
+bool file_is_valid_table_id(table_id_t table_id) {
+    return table_id >= 0 && table_id < MAX_TABLES && table_registry[table_id].load() != NULL;
+}
+
+void file_init(IOBackendType io_backend, bool direct_io) {
+    // tid_vector_path_fd.reserve(MAX_TABLES);
+    io_init(io_backend);
+    is_direct_io = direct_io;
+}
+
+// Table registry
+int file_acquire_fd(table_id_t table_id) {
+    file_table_t* table;
+    int fd;
+
+    table = table_registry[table_id].load(std::memory_order_acquire);
+    if (table == NULL) {
+        perror("Table not opened: in file_acquire_fd()");
+        exit(EXIT_FAILURE);
+    }
+
+    // Announce the use before reading the fd. The pool takes the fd before checking the users.
+    table->number_of_users++;
+    fd = table->fd.load();
+    // The file was closed by the fd pool. Reopen.
+    if (fd < 0) {
+        pthread_mutex_lock(&table_registry_latch);
+        fd = table->fd.load();
+        if (fd < 0)
+            fd = file_open_fd(table);
+        pthread_mutex_unlock(&table_registry_latch);
+    }
+    if (table->is_referenced.load(std::memory_order_relaxed) == false)
+        table->is_referenced.store(true, std::memory_order_relaxed);
+
+    return fd;
+}
+
+void file_release_fd(table_id_t table_id) {
+    table_registry[table_id].load(std::memory_order_acquire)->number_of_users--;
+}
+
+int file_open_fd(file_table_t* table) {
+    int fd;
+
+    // Make room in the pool.
+    if (open_tables.size() >= FILE_FD_POOL_SIZE)
+        file_close_lru_fd();
+
+    fd = open(table->pathname.c_str(), O_RDWR|O_CREAT|(is_direct_io == true ? O_DIRECT : 0), 0777);
+    // The file system does not support O_DIRECT.
+    if (fd < 0 && errno == EINVAL && is_direct_io == true)
+        fd = open(table->pathname.c_str(), O_RDWR|O_CREAT, 0777);
+    if (fd < 0) {
+        perror("File open failure");
+        exit(EXIT_FAILURE);
+    }
+
+    if (table->header.number_of_pages.load() == 0 && file_load_header(table, fd) != OP_SUCCESS) {
+        close(fd);
+        return -1;
+    }
+    table->space = file_load_space(fd, table->header.number_of_pages.load());
+    table->is_referenced = true;
+    open_tables.push_back(table);
+    table->fd.store(fd);
+
+    return fd;
+}
+
+bool file_close_lru_fd(void) {
+    file_table_t* table;
+    int fd;
+    int i;
+
+    // CLOCK, two rounds at most.
+    for (i = 0; i < 2 * (int)open_tables.size(); i++) {
+        open_tables_hand %= open_tables.size();
+        table = open_tables[open_tables_hand];
+        // Recently used. Give a second chance.
+        if (table->is_referenced.load() == true) {
+            table->is_referenced = false;
+            open_tables_hand++;
+            continue;
+        }
+        // Take the fd first, so that a new user reopens the file after it is closed.
+        fd = table->fd.exchange(-1);
+        if (table->number_of_users.load() > 0) {
+            table->fd.store(fd);
+            open_tables_hand++;
+            continue;
+        }
+
+        // Force the writes before closing, not to miss them at the next checkpoint.
+        file_write_header(table, fd);
+        if (table->is_unsynced.exchange(false) == true && fdatasync(fd) < 0) {
+            perror("File sync failure");
+            exit(EXIT_FAILURE);
+        }
+        if (close(fd) < 0) {
             perror("File close failure");
             exit(EXIT_FAILURE);
         }
+        pthread_mutex_destroy(&table->space->space_latch);
+        delete table->space;
+        table->space = NULL;
+
+        // Remove from the pool.
+        open_tables[open_tables_hand] = open_tables.back();
+        open_tables.pop_back();
+        return true;
+    }
+    return false;
+}
+
+int file_load_header(file_table_t* table, int fd) {
+    header_page_t* header_page;
+    struct stat st;
+
+    if (fstat(fd, &st) < 0) {
+        perror("fstat() failure: in file_load_header()");
+        exit(EXIT_FAILURE);
+    }
+
+    header_page = (header_page_t*)aligned_alloc(PAGE_SIZE, PAGE_SIZE);
+    if (header_page == NULL) {
+        perror("Memory allocation error");
+        exit(EXIT_FAILURE);
+    }
+
+    // I. Create the table file.
+    if (st.st_size == 0) {
+        if (verbose) {
+            printf("(newly created file");
+        }
+        // Create the initial size sparse in one call. No page is written until used.
+        table->header.number_of_pages = INITIAL_DB_FILE_SIZE / PAGE_SIZE;    // 10M / 4K
+        if (ftruncate(fd, PAGE_OFFSET(table->header.number_of_pages.load())) < 0) {
+            perror("File extension failure");
+            exit(EXIT_FAILURE);
+        }
+        table->header.root_pagenum = 0;
+        table->header.is_dirty = true;
+        file_write_header(table, fd);
+
+        if (fsync(fd) < 0) {
+            perror("File sync failure");
+            exit (EXIT_FAILURE);
+        }
+    }
+    // II. Cache the header page of the table file.
+    else {
+        if (pread(fd, header_page, PAGE_SIZE, 0) != PAGE_SIZE) {
+            perror("File read failure");
+            exit(EXIT_FAILURE);
+        }
+        // Not to read the pages of another format as bitmaps.
+        if (header_page->format_magic != FILE_FORMAT_MAGIC) {
+            if (verbose) {
+                printf("(not of the bitmap file format)");
+            }
+            free(header_page);
+            return OP_FAILURE;
+        }
+        // The file may have grown after the header page was written.
+        table->header.number_of_pages = std::max(header_page->number_of_pages, (uint64_t)st.st_size / PAGE_SIZE);
+        table->header.root_pagenum = header_page->root_pagenum;
+        table->header.is_dirty = false;
+    }
+    // No free page list. The bitmaps manage the free pages.
+    table->header.first_free_pagenum = 0;
+
+    free(header_page);
+    return OP_SUCCESS;
+}
+
+file_space_t* file_load_space(int fd, uint64_t number_of_pages) {
+    file_space_t* space;
+    uint64_t group;
     
-    map_tid_fd.clear();
+    space = new file_space_t;
+    pthread_mutex_init(&space->space_latch, NULL);
+
+    space->bitmaps.resize((number_of_pages + PAGES_PER_BITMAP - 1) / PAGES_PER_BITMAP);
+    for (group = 0; group < space->bitmaps.size(); group++) {
+        if (pread(fd, &space->bitmaps[group], PAGE_SIZE, PAGE_OFFSET(BITMAP_PAGENUM(group))) != PAGE_SIZE) {
+            perror("File read failure");
+            exit(EXIT_FAILURE);
+        }
+        // A bitmap page never written reads as zeros. Its own page is allocated anyway.
+        file_bitmap_set(space, BITMAP_PAGENUM(group), true);
+    }
+    file_bitmap_set(space, 0, true);
+
+    return space;
 }
-bool file_is_valid_table_id(table_id_t table_id) {
-    return map_tid_fd.find(table_id) != map_tid_fd.end();
+
+// Cached header page
+pagenum_t file_get_root_pagenum(table_id_t table_id) {
+    return table_registry[table_id].load(std::memory_order_acquire)->header.root_pagenum.load();
 }
 
-void file_init(void) {
-    // tid_vector_path_fd.reserve(MAX_TABLES);
+void file_set_root_pagenum(table_id_t table_id, pagenum_t root_pagenum) {
+    file_table_t* table;
+
+    // Keep the file open, so that the fd pool writes the header page when it closes the file.
+    file_acquire_fd(table_id);
+    table = table_registry[table_id].load();
+    table->header.root_pagenum = root_pagenum;
+    table->header.is_dirty = true;
+    file_release_fd(table_id);
+}
+
+uint64_t file_get_number_of_pages(table_id_t table_id) {
+    return table_registry[table_id].load(std::memory_order_acquire)->header.number_of_pages.load();
+}
+
+uint64_t file_get_free_count(table_id_t table_id) {
+    return table_registry[table_id].load(std::memory_order_acquire)->free_count.load();
+}
+
+void file_write_header(file_table_t* table, int fd) {
+    header_page_t* header_page;
+
+    if (table->header.is_dirty.exchange(false) == false)
+        return;
+
+    header_page = (header_page_t*)aligned_alloc(PAGE_SIZE, PAGE_SIZE);
+    if (header_page == NULL) {
+        perror("Memory allocation error");
+        exit(EXIT_FAILURE);
+    }
+    memset(header_page, 0, PAGE_SIZE);
+    header_page->first_free_pagenum = table->header.first_free_pagenum.load();
+    header_page->number_of_pages = table->header.number_of_pages.load();
+    header_page->root_pagenum = table->header.root_pagenum.load();
+    header_page->format_magic = FILE_FORMAT_MAGIC;
+
+    if (pwrite(fd, header_page, PAGE_SIZE, 0) != PAGE_SIZE) {
+        perror("File write failure");
+        exit(EXIT_FAILURE);
+    }
+    table->is_unsynced = true;
+
+    free(header_page);
+}
+
+// Free space management
+void file_extend(int fd, uint64_t old_number_of_pages, uint64_t new_number_of_pages) {
+    off_t offset = PAGE_OFFSET(old_number_of_pages);
+    off_t length = PAGE_OFFSET(new_number_of_pages) - offset;
+
+    // Reserve the blocks. If not supported by the file system, only set the size.
+    if (fallocate(fd, 0, offset, length) == 0)
+        return;
+    if (ftruncate(fd, offset + length) < 0) {
+        perror("File extension failure");
+        exit(EXIT_FAILURE);
+    }
+}
+
+void file_bitmap_init_group(file_space_t* space, uint64_t group) {
+    memset(&space->bitmaps[group], 0, PAGE_SIZE);
+    // The bitmap page, and the header page in the first group.
+    file_bitmap_set(space, BITMAP_PAGENUM(group), true);
+    if (group == 0)
+        file_bitmap_set(space, 0, true);
 }
 
-inline int file_convert_tid_to_fd(int64_t table_id) {
-    return map_tid_fd[table_id];
+bool file_bitmap_test(file_space_t* space, pagenum_t pagenum) {
+    uint64_t* words = (uint64_t*)&space->bitmaps[pagenum / PAGES_PER_BITMAP];
+    uint64_t bit = pagenum % PAGES_PER_BITMAP;
+
+    return (words[bit / 64] >> (bit % 64)) & 1;
+}
+
+void file_bitmap_set(file_space_t* space, pagenum_t pagenum, bool is_allocated) {
+    uint64_t* words = (uint64_t*)&space->bitmaps[pagenum / PAGES_PER_BITMAP];
+    uint64_t bit = pagenum % PAGES_PER_BITMAP;
+
+    if (is_allocated == true)
+        words[bit / 64] |= (uint64_t)1 << (bit % 64);
+    else
+        words[bit / 64] &= ~((uint64_t)1 << (bit % 64));
+}
+
+pagenum_t file_bitmap_find_free(file_space_t* space, pagenum_t start_pagenum, pagenum_t end_pagenum) {
+    uint64_t* words;
+    uint64_t word;
+    pagenum_t pagenum = start_pagenum;
+
+    while (pagenum < end_pagenum) {
+        words = (uint64_t*)&space->bitmaps[pagenum / PAGES_PER_BITMAP];
+        // Skip 64 allocated pages at once.
+        word = ~words[pagenum % PAGES_PER_BITMAP / 64] & (~(uint64_t)0 << (pagenum % 64));
+        if (word != 0) {
+            pagenum = pagenum / 64 * 64 + __builtin_ctzll(word);
+            return pagenum < end_pagenum ? pagenum : INVALID_PAGENUM;
+        }
+        pagenum = pagenum / 64 * 64 + 64;
+    }
+    return INVALID_PAGENUM;
+}
+
+void file_write_bitmap(int fd, file_space_t* space, uint64_t group) {
+    if (pwrite(fd, &space->bitmaps[group], PAGE_SIZE, PAGE_OFFSET(BITMAP_PAGENUM(group))) != PAGE_SIZE) {
+        perror("File write failure");
+        exit(EXIT_FAILURE);
+    }
 }
 
 inline void wrapper_read(int fd, pagenum_t pagenum, file_manager_page_t*& dst) {
-    dst = (file_manager_page_t*)malloc(PAGE_SIZE);
+    dst = (file_manager_page_t*)aligned_alloc(PAGE_SIZE, PAGE_SIZE);
     if (dst == NULL) {
         perror("Memory allocation error");
         exit(EXIT_FAILURE);
@@ -354,42 +697,21 @@ inline void wrapper_write(int fd, pagenum_t pagenum, file_manager_page_t*& src)
 }
 
 // test APIs
+// The header page on disk may be behind the cached one.
 pagenum_t file_test_get_ffpn (table_id_t tid) {
     
-    int fd;
-    file_manager_page_t *header_page;
-    pagenum_t ffpn;
-
     if (file_is_valid_table_id(tid) == false)
         return -1;
 
-    fd = map_tid_fd[tid];
-    wrapper_read(fd, 0, header_page);
-    ffpn = header_page->first_free_pagenum;
-
-    free(header_page);
-
-    return ffpn;
+    return table_registry[tid].load()->header.first_free_pagenum.load();
 }
 
 uint64_t file_test_get_np (table_id_t tid) {
 
-    int fd;
-    file_manager_page_t *header_page;
-    uint64_t number_of_pages;
-    
     if (file_is_valid_table_id(tid) == false)
         return -1;
 
-    // fd = tid_vector_path_fd[tid].second;
-    fd = map_tid_fd[tid];
-
-    wrapper_read(fd, 0, header_page);
-    number_of_pages = header_page->number_of_pages;
-
-    free(header_page);
-
-    return number_of_pages;
+    return file_get_number_of_pages(tid);
 }
 
 pagenum_t file_test_get_nfn(table_id_t tid, pagenum_t ffn) {
@@ -399,10 +721,11 @@ pagenum_t file_test_get_nfn(table_id_t tid, pagenum_t ffn) {
     pagenum_t nfn;
 
     // fd = tid_vector_path_fd[tid].second;
-    fd = map_tid_fd[tid];
+    fd = file_acquire_fd(tid);
 
     wrapper_read(fd, ffn , free_page);
     nfn = free_page->next_free_pagenum;
+    file_release_fd(tid);
 
     free(free_page);
 
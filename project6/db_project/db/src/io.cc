@@ -0,0 +1,285 @@
+#include "io.h"
+
+#include <unistd.h>         // for pread(), pwrite()
+#include <sys/mman.h>       // for mmap()
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// An io_uring ring, mapped from the kernel.
+typedef struct {
+    int ring_fd;
+
+    // submission queue
+    unsigned* sq_head;
+    unsigned* sq_tail;
+    unsigned* sq_ring_mask;
+    unsigned* sq_array;
+    struct io_uring_sqe* sqes;
+
+    // completion queue
+    unsigned* cq_head;
+    unsigned* cq_tail;
+    unsigned* cq_ring_mask;
+    struct io_uring_cqe* cqes;
+
+    // for unmapping
+    void* sq_ring_ptr;
+    size_t sq_ring_size;
+    void* cq_ring_ptr;
+    size_t cq_ring_size;
+    size_t sqes_size;
+} io_uring_t;
+
+// Data structures used in the I/O layer.
+io_backend_t io_backend;
+IOBackendType io_backend_type;
+// The ring of each thread. Destroyed at thread exit.
+pthread_key_t uring_key;
+pthread_once_t uring_key_once = PTHREAD_ONCE_INIT;
+
+// Utility
+io_uring_t* uring_create(void);
+void uring_destroy(void* arg);
+void uring_create_key(void);
+io_uring_t* uring_get_ring(void);
+
+void io_init(IOBackendType type) {
+    io_uring_t* ring;
+
+    io_backend_type = kIOBackendSync;
+    io_backend.submit_and_wait = sync_submit_and_wait;
+    io_backend.shutdown = sync_shutdown;
+
+    if (type == kIOBackendUring) {
+        // Probe the kernel with the ring of the calling thread.
+        pthread_once(&uring_key_once, uring_create_key);
+        ring = (io_uring_t*)pthread_getspecific(uring_key);
+        if (ring == NULL) {
+            ring = uring_create();
+            if (ring != NULL)
+                pthread_setspecific(uring_key, ring);
+        }
+        if (ring != NULL) {
+            io_backend_type = kIOBackendUring;
+            io_backend.submit_and_wait = uring_submit_and_wait;
+            io_backend.shutdown = uring_shutdown;
+        }
+    }
+}
+
+void io_shutdown(void) {
+    io_backend.shutdown();
+}
+
+IOBackendType io_get_backend_type(void) {
+    return io_backend_type;
+}
+
+void io_submit_and_wait(io_request_t* requests, int count) {
+    if (count > 0)
+        io_backend.submit_and_wait(requests, count);
+}
+
+// Synchronous backend
+void sync_submit_and_wait(io_request_t* requests, int count) {
+    ssize_t size;
+    int i;
+
+    for (i = 0; i < count; i++) {
+        if (requests[i].is_write == true) {
+            size = pwrite(requests[i].fd, requests[i].buf, requests[i].length, requests[i].offset);
+            if (size != (ssize_t)requests[i].length) {
+                perror("File write failure");
+                exit(EXIT_FAILURE);
+            }
+        } else {
+            size = pread(requests[i].fd, requests[i].buf, requests[i].length, requests[i].offset);
+            if (size != (ssize_t)requests[i].length) {
+                perror("File read failure");
+                exit(EXIT_FAILURE);
+            }
+        }
+    }
+}
+
+void sync_shutdown(void) {
+}
+
+// io_uring backend
+void uring_submit_and_wait(io_request_t* requests, int count) {
+    io_uring_t* ring;
+    struct io_uring_sqe* sqe;
+    struct io_uring_cqe* cqe;
+    io_request_t* request;
+    unsigned tail, head, index;
+    int number_of_submitted = 0;       // placed in the submission queue
+    int number_of_pending = 0;         // placed, but not yet consumed by the kernel
+    int number_of_completed = 0;
+    int ret;
+
+    ring = uring_get_ring();
+
+    while (number_of_completed < count) {
+        // I. Fill the submission queue, up to the queue depth in flight.
+        tail = *ring->sq_tail;
+        while (number_of_submitted < count && number_of_submitted - number_of_completed < IO_URING_QUEUE_DEPTH) {
+            request = &requests[number_of_submitted];
+            index = tail & *ring->sq_ring_mask;
+            sqe = &ring->sqes[index];
+            memset(sqe, 0, sizeof(*sqe));
+            sqe->opcode = request->is_write == true ? IORING_OP_WRITE : IORING_OP_READ;
+            sqe->fd = request->fd;
+            sqe->off = request->offset;
+            sqe->addr = (uint64_t)(uintptr_t)request->buf;
+            sqe->len = request->length;
+            sqe->user_data = number_of_submitted;
+            ring->sq_array[index] = index;
+            tail++;
+            number_of_submitted++;
+            number_of_pending++;
+        }
+        // Publish the entries to the kernel.
+        __atomic_store_n(ring->sq_tail, tail, __ATOMIC_RELEASE);
+
+        // II. Submit the batch in one system call, and wait for a completion.
+        ret = syscall(__NR_io_uring_enter, ring->ring_fd, number_of_pending, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+        if (ret < 0) {
+            if (errno == EINTR)
+                continue;
+            perror("io_uring_enter() failure");
+            exit(EXIT_FAILURE);
+        }
+        number_of_pending -= ret;
+
+        // III. Reap the completions.
+        head = *ring->cq_head;
+        while (head != __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE)) {
+            cqe = &ring->cqes[head & *ring->cq_ring_mask];
+            request = &requests[cqe->user_data];
+            if (cqe->res != (int)request->length) {
+                errno = cqe->res < 0 ? -cqe->res : EIO;
+                perror(request->is_write == true ? "File write failure" : "File read failure");
+                exit(EXIT_FAILURE);
+            }
+            head++;
+            number_of_completed++;
+        }
+        __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+    }
+}
+
+void uring_shutdown(void) {
+    io_uring_t* ring;
+
+    // The rings of the other threads are destroyed when they exit.
+    ring = (io_uring_t*)pthread_getspecific(uring_key);
+    if (ring != NULL) {
+        pthread_setspecific(uring_key, NULL);
+        uring_destroy(ring);
+    }
+}
+
+// Utility
+io_uring_t* uring_create(void) {
+    io_uring_t* ring;
+    struct io_uring_params params;
+    char* sq_ptr;
+    char* cq_ptr;
+
+    memset(&params, 0, sizeof(params));
+    ring = (io_uring_t*)calloc(1, sizeof(io_uring_t));
+    if (ring == NULL) {
+        perror("Memory allocation error");
+        exit(EXIT_FAILURE);
+    }
+
+    // Not supported by the kernel, or not permitted.
+    ring->ring_fd = syscall(__NR_io_uring_setup, IO_URING_QUEUE_DEPTH, &params);
+    if (ring->ring_fd < 0) {
+        free(ring);
+        return NULL;
+    }
+
+    // Map the submission queue, the completion queue and the submission entries.
+    ring->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        if (ring->cq_ring_size > ring->sq_ring_size)
+            ring->sq_ring_size = ring->cq_ring_size;
+        ring->cq_ring_size = ring->sq_ring_size;
+    }
+    ring->sq_ring_ptr = mmap(NULL, ring->sq_ring_size, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, ring->ring_fd, IORING_OFF_SQ_RING);
+    if (ring->sq_ring_ptr == MAP_FAILED) {
+        perror("mmap() failure: in uring_create()");
+        exit(EXIT_FAILURE);
+    }
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        ring->cq_ring_ptr = ring->sq_ring_ptr;
+    } else {
+        ring->cq_ring_ptr = mmap(NULL, ring->cq_ring_size, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, ring->ring_fd, IORING_OFF_CQ_RING);
+        if (ring->cq_ring_ptr == MAP_FAILED) {
+            perror("mmap() failure: in uring_create()");
+            exit(EXIT_FAILURE);
+        }
+    }
+    ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = (struct io_uring_sqe*)mmap(NULL, ring->sqes_size, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, ring->ring_fd, IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED) {
+        perror("mmap() failure: in uring_create()");
+        exit(EXIT_FAILURE);
+    }
+
+    sq_ptr = (char*)ring->sq_ring_ptr;
+    ring->sq_head = (unsigned*)(sq_ptr + params.sq_off.head);
+    ring->sq_tail = (unsigned*)(sq_ptr + params.sq_off.tail);
+    ring->sq_ring_mask = (unsigned*)(sq_ptr + params.sq_off.ring_mask);
+    ring->sq_array = (unsigned*)(sq_ptr + params.sq_off.array);
+
+    cq_ptr = (char*)ring->cq_ring_ptr;
+    ring->cq_head = (unsigned*)(cq_ptr + params.cq_off.head);
+    ring->cq_tail = (unsigned*)(cq_ptr + params.cq_off.tail);
+    ring->cq_ring_mask = (unsigned*)(cq_ptr + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe*)(cq_ptr + params.cq_off.cqes);
+
+    return ring;
+}
+
+void uring_destroy(void* arg) {
+    io_uring_t* ring = (io_uring_t*)arg;
+
+    munmap(ring->sqes, ring->sqes_size);
+    if (ring->cq_ring_ptr != ring->sq_ring_ptr)
+        munmap(ring->cq_ring_ptr, ring->cq_ring_size);
+    munmap(ring->sq_ring_ptr, ring->sq_ring_size);
+    close(ring->ring_fd);
+    free(ring);
+}
+
+void uring_create_key(void) {
+    if (pthread_key_create(&uring_key, uring_destroy) != 0) {
+        perror("pthread_key_create() failure");
+        exit(EXIT_FAILURE);
+    }
+}
+
+// Return the ring of the calling thread. Create it on the first I/O of the thread.
+io_uring_t* uring_get_ring(void) {
+    io_uring_t* ring;
+
+    ring = (io_uring_t*)pthread_getspecific(uring_key);
+    if (ring == NULL) {
+        ring = uring_create();
+        if (ring == NULL) {
+            perror("io_uring_setup() failure");
+            exit(EXIT_FAILURE);
+        }
+        pthread_setspecific(uring_key, ring);
+    }
+    return ring;
+}
@@ -2,16 +2,26 @@
 
 #include <unistd.h>         // for read(), write(), fsync()
 #include <fcntl.h>          // for open()
+#include <libgen.h>         // for dirname()
 #include <sys/types.h>
 #include <sys/stat.h>
 
 #include <pthread.h>
+#include <sched.h>          // for sched_yield()
+#include <stddef.h>         // for offsetof()
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
+#include <atomic>
+
+#include <map>
 #include <set>
+#include <vector>
+#include <utility>
+#include <unordered_map>
 #include <algorithm>
 
 #include "page.h"
@@ -22,142 +32,536 @@
 
 int log_file_fd;
 FILE* logmsg_file_fp;
-int64_t g_flushed_LSN;
 
-pthread_mutex_t log_buffer_latch;
+// The log buffer is a ring. The log of LSN is at log_buffer[LSN % LOG_BUFFER_SIZE].
+//      g_flushed_LSN <= g_filled_LSN <= g_LSN
+//      [g_flushed_LSN, g_filled_LSN): appended, not yet on disk.
+//      [g_filled_LSN, g_LSN): reserved, being copied.
+// A log reserves its space by fetch-add on g_LSN and is copied without any latch.
+// g_filled_LSN is advanced in LSN order, after the copy, so flushers only write completed logs.
 char* log_buffer;
-int64_t g_buffer_LSN;
-// TODO: 초기화 시에 적절히 numbering 해주기.
-// TODO: 뮤텍스로 보호해 줄 필요 없나?
-int64_t g_LSN;
+std::atomic<int64_t> g_LSN;
+std::atomic<int64_t> g_filled_LSN;
+std::atomic<int64_t> g_flushed_LSN;
+// LSN of the last filled log. Updated only by the log advancing g_filled_LSN.
+std::atomic<int64_t> g_last_LSN;
+
+// Log writer
+// log_buffer_latch protects only the flush. The writer writes and forces the log buffer
+// without log_buffer_latch, while the flushers wait for log_flushed_cond.
+pthread_mutex_t log_buffer_latch;
+pthread_cond_t log_flushed_cond;
+pthread_cond_t log_writer_cond;
+pthread_t log_writer_thread;
+bool is_log_writer_running;
+// The largest LSN requested by log_flush.
+int64_t g_flush_requested_LSN;
+
+// Group commit
+int group_commit_wait_us;
+// Flush requests waiting for the next group.
+uint64_t number_of_pending_flushes;
+// statistics
+uint64_t number_of_groups;
+uint64_t number_of_grouped_flushes;
+uint64_t max_group_size;
+
+// Checkpoint
+char checkpoint_path[512];
+// start_LSN of the last checkpoint. -1, if none.
+int64_t g_checkpoint_LSN;
+// checkpoint_latch serializes checkpoints.
+pthread_mutex_t checkpoint_latch;
+pthread_t checkpointer_thread;
+pthread_mutex_t checkpointer_latch;
+pthread_cond_t checkpointer_cond;
+bool is_checkpointer_running;
+
+// Recovery, set by analysis.
+// Dirty page table: (table_id, pagenum) -> recLSN
+std::unordered_map<buffer_page_id_t, int64_t, BufferPageHash> recovery_dirty_pages;
+// LSN of the begin log of each loser.
+std::unordered_map<int, int64_t> recovery_first_LSN;
+int64_t redo_start_LSN;
+int64_t undo_start_LSN;
 
 
 void log_init(int flag, int log_num, char* log_path, char* logmsg_path) {
-    log_buffer = (char*)malloc(sizeof(LOG_BUFFER_SIZE));
-    log_buffer_latch = PTHREAD_MUTEX_INITIALIZER;
-    log_file_fd = open(pathname, O_RDWR|O_CREAT, 0777);
+    log_buffer = (char*)malloc(LOG_BUFFER_SIZE);
+    if (log_buffer == NULL) {
+        perror("Memory allocation error");
+        exit(EXIT_FAILURE);
+    }
+    pthread_mutex_init(&log_buffer_latch, NULL);
+    pthread_cond_init(&log_flushed_cond, NULL);
+    pthread_cond_init(&log_writer_cond, NULL);
+    number_of_pending_flushes = 0;
+    number_of_groups = 0;
+    number_of_grouped_flushes = 0;
+    max_group_size = 0;
+    log_file_fd = open(log_path, O_RDWR|O_CREAT, 0777);
     // TODO: 언제 close 해주주지지이
     if(log_file_fd < 0) {
         perror("open() failure");
         exit(EXIT_FAILURE);
     }
-    logmsg_file_fp = fopen(logmsg_path, "wr");
+    logmsg_file_fp = fopen(logmsg_path, "w");
     if (logmsg_file_fp == NULL) {
         perror("fopen() failure");
         exit(EXIT_FAILURE);
     }
+    if (snprintf(checkpoint_path, sizeof(checkpoint_path), "%s%s", log_path, CHECKPOINT_SUFFIX) >= (int)sizeof(checkpoint_path)) {
+        perror("Log path too long");
+        exit(EXIT_FAILURE);
+    }
+    pthread_mutex_init(&checkpoint_latch, NULL);
+    g_checkpoint_LSN = -1;
 
     g_flushed_LSN = lseek(log_file_fd, 0, SEEK_END);
-    g_buffer_LSN = g_LSN = g_flushed_LSN;
+    g_filled_LSN.store(g_flushed_LSN.load());
+    g_LSN.store(g_flushed_LSN.load());
+    g_last_LSN = -1;
+    g_flush_requested_LSN = -1;
 
-    recover(flag, lognum);
+    log_writer_start();
+    recover(flag, log_num);
     // force all logs.
-    pthread_mutex_lock(&log_buffer_latch);
-    write_log_buffer_to_file(g_LSN - g_flushed_LSN);
-    g_flushed_LSN = g_LSN;
-    pthread_mutex_unlock(&log_buffer_latch);
+    log_flush();
+
+    // The next restart starts after the recovery.
+    log_checkpoint();
+    log_checkpointer_start();
+}
+
+void log_shutdown(void) {
+    log_checkpoint();
+    log_writer_stop();
+
+    close(log_file_fd);
+    fclose(logmsg_file_fp);
+    free(log_buffer);
+    pthread_mutex_destroy(&checkpoint_latch);
+    pthread_mutex_destroy(&log_buffer_latch);
+    pthread_cond_destroy(&log_flushed_cond);
+    pthread_cond_destroy(&log_writer_cond);
 }
 
 int64_t log_create(LogType type, int trx_id) {
+    trx_log_t log;
 
     // Make a new log.
-    trx_log_t* log = (trx_log_t*)malloc(sizeof(trx_log_t));
-    if (log == NULL) {
-        perror("Memory allocation error");
-        exit(EXIT_FAILURE);
-    }
-    log->log_size = TRX_LOG_SIZE;
-    log->trx_id = trx_id;
-    log->type = type;
-    
+    log.log_size = TRX_LOG_SIZE;
+    log.trx_id = trx_id;
+    log.type = type;
+
     // Append the new log to the log buffer.
-    pthread_mutex_lock(&log_buffer_latch);
-    log->prev_LSN = g_LSN;
-    g_LSN += log->log_size;
-    log->LSN = g_LSN;
+    append_log(&log, log.log_size);
+    return log.LSN;
+}
+int64_t log_create(LogType type, int trx_id, table_id_t table_id, pagenum_t page_id, uint16_t offset, uint16_t data_length, char* old_img, char* new_img) {
+    update_log_t log;
 
-    append(log, log->log_size);
+    if (data_length > MAX_LOG_DATA_LENGTH)
+        return OP_FAILURE;
+    log.log_size = UPDATE_LOG_SIZE(data_length);
+    log.trx_id = trx_id;
+    log.type = type;
 
-    pthread_mutex_unlock(&log_buffer_latch);
-    return log->LSN;
+    log.table_id = table_id;
+    log.page_id = page_id;
+    log.offset = offset;
+    log.data_length = data_length;
+    memcpy(LOG_OLD_IMG(&log), old_img, data_length);
+    memcpy(LOG_NEW_IMG(&log), new_img, data_length);
+
+    // Append the new log to the log buffer.
+    append_log(&log, log.log_size);
+
+    return log.LSN;
 }
-int64_t log_create(LogType type, int trx_id, table_id_t table_id, pagenum_t page_id, uint16_t offset, uint16_t data_length, char* old_img, char* new_img) {
-    update_log_t* log = (update_log_t*)malloc(sizeof(update_log_t));
-    if (log == NULL) {
-        perror("Memory allocation error");
-        exit(EXIT_FAILURE);
-    }
-    log->trx_id = trx_id;
-    log->type = type;
+int64_t log_create(LogType type, int trx_id, table_id_t table_id, pagenum_t page_id, uint16_t offset, uint16_t data_length, char* old_img, char* new_img, int64_t next_undo_LSN) {
+    compensate_log_t log;
+
+    if (data_length > MAX_LOG_DATA_LENGTH)
+        return OP_FAILURE;
+    log.log_size = COMPENSATE_LOG_SIZE(data_length);
+    log.trx_id = trx_id;
+    log.type = type;
+
+    log.table_id = table_id;
+    log.page_id = page_id;
+    log.offset = offset;
+    log.data_length = data_length;
+    memcpy(LOG_OLD_IMG(&log), old_img, data_length);
+    memcpy(LOG_NEW_IMG(&log), new_img, data_length);
+    log.next_undo_LSN = next_undo_LSN;
 
-    log->table_id = table_id;
-    log->page_id = page_id;
-    log->offset = offset;
-    log->data_length = data_length;
-    memcpy(log->old_img, old_img, data_length);
-    memcpy(log->new_img, new_img, data_length);
+    // Append the new log to the log buffer.
+    append_log(&log, log.log_size);
+
+    return log.LSN;
+}
+
+int64_t log_create(LogType type, table_id_t table_id, pagenum_t root_pagenum, uint64_t number_of_records) {
+    bulk_load_log_t log;
+
+    // Make a new log.
+    log.log_size = BULK_LOAD_LOG_SIZE;
+    log.trx_id = 0;
+    log.type = type;
+
+    log.table_id = table_id;
+    log.root_pagenum = root_pagenum;
+    log.number_of_records = number_of_records;
 
     // Append the new log to the log buffer.
-    pthread_mutex_lock(log_buffer_latch);
-    log->log_size = 264;
-    log->prev_LSN = g_LSN;
-    g_LSN += 264;
-    log->LSN = g_LSN;
+    append_log(&log, log.log_size);
+
+    return log.LSN;
+}
 
-    append_log(log, log->log_size);
+int log_flush(void) {
+    return log_flush(g_LSN.load() - 1);
+}
+int log_flush(int64_t LSN) {
+    pthread_mutex_lock(&log_buffer_latch);
+    // Already on disk, or no log at the LSN. (A page never logged has LSN 0.)
+    if (LSN < g_flushed_LSN || LSN >= g_LSN.load()) {
+        pthread_mutex_unlock(&log_buffer_latch);
+        return OP_SUCCESS;
+    }
 
+    // Join the next group, and wait for the writer.
+    number_of_pending_flushes++;
+    g_flush_requested_LSN = std::max(g_flush_requested_LSN, LSN);
+    pthread_cond_signal(&log_writer_cond);
+    while (LSN >= g_flushed_LSN)
+        pthread_cond_wait(&log_flushed_cond, &log_buffer_latch);
     pthread_mutex_unlock(&log_buffer_latch);
 
-    return log->LSN;
+    return OP_SUCCESS;
 }
-int64_t log_create(LogType type, int trx_id, table_id_t table_id, pagenum_t page_id, uint16_t offset, uint16_t data_length, char* old_img, char* new_img, int64_t next_undo_LSN) {
-    update_log_t* log = (update_log_t*)malloc(sizeof(update_log_t));
-    if (log == NULL) {
-        perror("Memory allocation error");
+
+// Log writer
+void log_writer_start(void) {
+    is_log_writer_running = true;
+    if (pthread_create(&log_writer_thread, NULL, log_writer_main, NULL) != 0) {
+        perror("Thread creation failure");
         exit(EXIT_FAILURE);
     }
-    log->trx_id = trx_id;
-    log->type = type;
+}
 
-    log->table_id = table_id;
-    log->page_id = page_id;
-    log->offset = offset;
-    log->data_length = data_length;
-    memcpy(log->old_img, old_img, data_length);
-    memcpy(log->new_img, new_img, data_length);
+void log_writer_stop(void) {
+    pthread_mutex_lock(&log_buffer_latch);
+    is_log_writer_running = false;
+    pthread_cond_signal(&log_writer_cond);
+    pthread_mutex_unlock(&log_buffer_latch);
+
+    pthread_join(log_writer_thread, NULL);
+}
+
+void* log_writer_main(void*) {
+    struct timespec wake_time;
+    int64_t start_LSN;
+    int64_t end_LSN;
+    uint64_t group_size;
+    bool is_requested;
 
-    // Append the new log to the log buffer.
     pthread_mutex_lock(&log_buffer_latch);
-    log->log_size = 272;
-    log->prev_LSN = g_LSN;
-    g_LSN += 272;
-    log->LSN = g_LSN;
-    log->next_undo_LSN = next_undo_LSN;
+    while (true) {
+        is_requested = g_flush_requested_LSN >= g_flushed_LSN;
+        // I. Sleep for the interval, or until a flush is requested.
+        if (is_requested == false && is_log_writer_running == true) {
+            clock_gettime(CLOCK_REALTIME, &wake_time);
+            wake_time.tv_nsec += LOG_WRITER_INTERVAL_MS * 1000000L;
+            wake_time.tv_sec += wake_time.tv_nsec / 1000000000L;
+            wake_time.tv_nsec %= 1000000000L;
+            pthread_cond_timedwait(&log_writer_cond, &log_buffer_latch, &wake_time);
+            is_requested = g_flush_requested_LSN >= g_flushed_LSN;
+        }
 
-    append_log(log, log->log_size);
+        // Wait for more flush requests to join the group.
+        if (is_requested == true && group_commit_wait_us > 0) {
+            pthread_mutex_unlock(&log_buffer_latch);
+            usleep(group_commit_wait_us);
+            pthread_mutex_lock(&log_buffer_latch);
+        }
 
+        // II. Write the completed logs with a single fsync.
+        // The ring is not overwritten until g_flushed_LSN passes, so appenders keep filling the rest.
+        start_LSN = g_flushed_LSN.load();
+        end_LSN = g_filled_LSN.load();
+        if (end_LSN == start_LSN) {
+            if (is_log_writer_running == false && end_LSN == g_LSN.load())
+                break;
+            // A requested log is still being copied.
+            if (is_requested == true || is_log_writer_running == false) {
+                pthread_mutex_unlock(&log_buffer_latch);
+                sched_yield();
+                pthread_mutex_lock(&log_buffer_latch);
+            }
+            continue;
+        }
+        // Flush requests from now on join the next group.
+        group_size = number_of_pending_flushes;
+        pthread_mutex_unlock(&log_buffer_latch);
+        write_log_to_file(start_LSN, end_LSN - start_LSN);
+        pthread_mutex_lock(&log_buffer_latch);
+
+        // III. Wake up the flushers.
+        if (group_size > 0) {
+            number_of_pending_flushes -= group_size;
+            number_of_groups++;
+            number_of_grouped_flushes += group_size;
+            max_group_size = std::max(max_group_size, group_size);
+        }
+        g_flushed_LSN = end_LSN;
+        pthread_cond_broadcast(&log_flushed_cond);
+    }
     pthread_mutex_unlock(&log_buffer_latch);
 
-    return log->LSN;
+    return NULL;
 }
 
-int log_flush(void) {
+void log_set_group_commit_wait(int wait_us) {
+    group_commit_wait_us = wait_us;
+}
+
+void log_get_group_commit_stats(uint64_t* groups, uint64_t* grouped_flushes, uint64_t* max_size) {
     pthread_mutex_lock(&log_buffer_latch);
-    write_log_buffer_to_file(g_LSN - g_flushed_LSN);
-    g_flushed_LSN = g_LSN;
+    *groups = number_of_groups;
+    *grouped_flushes = number_of_grouped_flushes;
+    *max_size = max_group_size;
     pthread_mutex_unlock(&log_buffer_latch);
 }
-void log_get_update_log(update_log_t* log,int64_t LSN) {
-    get_log(log, LSN, 272);
+void log_get_update_log(update_log_t* log, int64_t LSN) {
+    get_log(log, LSN, TRX_LOG_SIZE);
+    get_log(log, LSN, log->log_size);
 }
 
-// Utility
-void append_log(void*bfzedc log, int log_size) {
-    if ((log->LSN - g_buffer_LSN) + log_size) > LOG_BUFFER_SIZE) {
-        write_log_buffer_to_file(log->LSN - g_buffer_LSN);
-        g_buffer_LSN = g_flushed_LSN = log->LSN;
+int64_t log_get_next_LSN(void) {
+    return g_LSN.load();
+}
+
+int64_t log_get_filled_LSN(int64_t* last_LSN) {
+    int64_t filled_LSN;
+
+    while (true) {
+        filled_LSN = g_filled_LSN.load(std::memory_order_acquire);
+        *last_LSN = g_last_LSN.load();
+        // g_last_LSN is set before g_filled_LSN. If not behind, the next log is advancing.
+        if (*last_LSN < filled_LSN && g_filled_LSN.load(std::memory_order_acquire) == filled_LSN)
+            return filled_LSN;
+        sched_yield();
     }
-    memcpy(&log_buffer[log->LSN - g_buffer_LSN], log, log->log_size);
+}
+
+// Checkpoint
+void log_checkpoint(void) {
+    checkpoint_header_t header;
+    std::vector< std::pair<int, int64_t> > active_trxs;
+    std::vector<checkpoint_trx_entry_t> trx_entries;
+    std::vector<dirty_page_entry_t> dirty_pages;
+    checkpoint_trx_entry_t trx_entry;
+    char temp_path[sizeof(checkpoint_path) + 4];
+    char dir_path[sizeof(checkpoint_path)];
+    ssize_t size;
+    int fd;
+    int i;
+
+    pthread_mutex_lock(&checkpoint_latch);
+
+    // I. Bound the redo of the next restart by the previous checkpoint.
+    if (g_checkpoint_LSN > 0)
+        buffer_flush_old_pages(g_checkpoint_LSN);
+
+    // II. A page dirtied by a log before start_LSN is in the dirty page table,
+    // because recLSN is set before the log, and reset only after the page is forced.
+    header.start_LSN = trx_get_active_trxs(active_trxs, &header.last_LSN);
+    buffer_get_dirty_pages(dirty_pages);
+    for (i = 0; i < (int)active_trxs.size(); i++) {
+        trx_entry.trx_id = active_trxs[i].first;
+        trx_entry.first_LSN = active_trxs[i].second;
+        trx_entries.push_back(trx_entry);
+    }
+    header.number_of_dirty_pages = dirty_pages.size();
+    header.number_of_active_trxs = trx_entries.size();
+
+    // III. The checkpoint is valid only if the logs before start_LSN are on disk,
+    // and the pages written out of the dirty page table are on disk. (no-force page writes)
+    log_flush(header.start_LSN - 1);
+    file_sync_table_files();
+
+    sprintf(temp_path, "%s.tmp", checkpoint_path);
+    fd = open(temp_path, O_WRONLY|O_CREAT|O_TRUNC, 0777);
+    if (fd < 0) {
+        perror("open() failure: in log_checkpoint()");
+        exit(EXIT_FAILURE);
+    }
+    size = sizeof(header);
+    if (write(fd, &header, sizeof(header)) != size) {
+        perror("File write failure: in log_checkpoint()");
+        exit(EXIT_FAILURE);
+    }
+    size = dirty_pages.size() * sizeof(dirty_page_entry_t);
+    if (size > 0 && write(fd, dirty_pages.data(), size) != size) {
+        perror("File write failure: in log_checkpoint()");
+        exit(EXIT_FAILURE);
+    }
+    size = trx_entries.size() * sizeof(checkpoint_trx_entry_t);
+    if (size > 0 && write(fd, trx_entries.data(), size) != size) {
+        perror("File write failure: in log_checkpoint()");
+        exit(EXIT_FAILURE);
+    }
+    if (fsync(fd) < 0) {
+        perror("File sync failure: in log_checkpoint()");
+        exit(EXIT_FAILURE);
+    }
+    close(fd);
+    // Replace the last checkpoint atomically.
+    if (rename(temp_path, checkpoint_path) < 0) {
+        perror("rename() failure: in log_checkpoint()");
+        exit(EXIT_FAILURE);
+    }
+    // The rename is durable only when the directory entry is.
+    strcpy(dir_path, checkpoint_path);
+    fd = open(dirname(dir_path), O_RDONLY|O_DIRECTORY);
+    if (fd < 0) {
+        perror("open() failure: in log_checkpoint()");
+        exit(EXIT_FAILURE);
+    }
+    if (fsync(fd) < 0) {
+        perror("Directory sync failure: in log_checkpoint()");
+        exit(EXIT_FAILURE);
+    }
+    close(fd);
+
+    g_checkpoint_LSN = header.start_LSN;
+    pthread_mutex_unlock(&checkpoint_latch);
+}
+
+void log_checkpointer_start(void) {
+    pthread_mutex_init(&checkpointer_latch, NULL);
+    pthread_cond_init(&checkpointer_cond, NULL);
+    is_checkpointer_running = true;
+    if (pthread_create(&checkpointer_thread, NULL, log_checkpointer_main, NULL) != 0) {
+        perror("Thread creation failure");
+        exit(EXIT_FAILURE);
+    }
+}
+
+void log_checkpointer_stop(void) {
+    pthread_mutex_lock(&checkpointer_latch);
+    is_checkpointer_running = false;
+    pthread_cond_signal(&checkpointer_cond);
+    pthread_mutex_unlock(&checkpointer_latch);
+
+    pthread_join(checkpointer_thread, NULL);
+    pthread_cond_destroy(&checkpointer_cond);
+    pthread_mutex_destroy(&checkpointer_latch);
+}
+
+void* log_checkpointer_main(void*) {
+    struct timespec wake_time;
+
+    pthread_mutex_lock(&checkpointer_latch);
+    while (is_checkpointer_running == true) {
+        clock_gettime(CLOCK_REALTIME, &wake_time);
+        wake_time.tv_nsec += CHECKPOINT_INTERVAL_MS % 1000 * 1000000L;
+        wake_time.tv_sec += CHECKPOINT_INTERVAL_MS / 1000 + wake_time.tv_nsec / 1000000000L;
+        wake_time.tv_nsec %= 1000000000L;
+        pthread_cond_timedwait(&checkpointer_cond, &checkpointer_latch, &wake_time);
+        if (is_checkpointer_running == false)
+            break;
+        pthread_mutex_unlock(&checkpointer_latch);
+
+        log_checkpoint();
+
+        pthread_mutex_lock(&checkpointer_latch);
+    }
+    pthread_mutex_unlock(&checkpointer_latch);
+
+    return NULL;
+}
+
+bool read_checkpoint(checkpoint_header_t* header, std::vector<dirty_page_entry_t>& dirty_pages, std::vector<checkpoint_trx_entry_t>& active_trxs) {
+    ssize_t size;
+    int fd;
+
+    fd = open(checkpoint_path, O_RDONLY);
+    if (fd < 0)
+        return false;
+    if (read(fd, header, sizeof(checkpoint_header_t)) != (ssize_t)sizeof(checkpoint_header_t)
+        || header->number_of_dirty_pages < 0 || header->number_of_active_trxs < 0
+        // The log file does not reach the checkpoint.
+        || header->start_LSN > g_flushed_LSN.load()) {
+        close(fd);
+        return false;
+    }
+    dirty_pages.resize(header->number_of_dirty_pages);
+    active_trxs.resize(header->number_of_active_trxs);
+    size = dirty_pages.size() * sizeof(dirty_page_entry_t);
+    if (size > 0 && read(fd, dirty_pages.data(), size) != size) {
+        close(fd);
+        return false;
+    }
+    size = active_trxs.size() * sizeof(checkpoint_trx_entry_t);
+    if (size > 0 && read(fd, active_trxs.data(), size) != size) {
+        close(fd);
+        return false;
+    }
+    close(fd);
+
+    return true;
+}
+
+// Utility
+int64_t append_log(void* log, int log_size) {
+    trx_log_t* header = (trx_log_t*)log;
+    int64_t LSN;
+
+    // I. Reserve the space.
+    LSN = g_LSN.fetch_add(log_size);
+    header->LSN = LSN;
+    header->prev_LSN = -1;
+
+    // II. Wait until the ring has room. The region must not overwrite logs not yet on disk.
+    if (LSN + log_size - g_flushed_LSN.load() > LOG_BUFFER_SIZE)
+        log_flush(LSN + log_size - LOG_BUFFER_SIZE - 1);
+
+    // III. Copy in parallel with the other logs.
+    copy_to_log_buffer(LSN, log, log_size);
+
+    // IV. Advance the filled watermark in LSN order.
+    while (g_filled_LSN.load(std::memory_order_acquire) != LSN)
+        sched_yield();
+    // Now the previous log is filled. Chain it.
+    header->prev_LSN = g_last_LSN.load();
+    copy_to_log_buffer(LSN + offsetof(trx_log_t, prev_LSN), &header->prev_LSN, sizeof(int64_t));
+    g_last_LSN = LSN;
+    g_filled_LSN.store(LSN + log_size, std::memory_order_release);
+
+    return LSN;
+}
+
+void copy_to_log_buffer(int64_t LSN, const void* src, int size) {
+    int offset = LSN % LOG_BUFFER_SIZE;
+    int first_size = std::min(size, LOG_BUFFER_SIZE - offset);
+
+    memcpy(&log_buffer[offset], src, first_size);
+    // Wrap around.
+    if (first_size < size)
+        memcpy(log_buffer, (const char*)src + first_size, size - first_size);
+}
+
+void copy_from_log_buffer(void* dest, int64_t LSN, int size) {
+    int offset = LSN % LOG_BUFFER_SIZE;
+    int first_size = std::min(size, LOG_BUFFER_SIZE - offset);
+
+    memcpy(dest, &log_buffer[offset], first_size);
+    // Wrap around.
+    if (first_size < size)
+        memcpy((char*)dest + first_size, log_buffer, size - first_size);
 }
 
 void recover(int flag, int log_num) {
@@ -175,259 +579,316 @@ void recover(int flag, int log_num) {
         redo(0);
         undo(set_loser_trx_id, log_num);
     }
+
+    // Write the recovered pages. Their recLSN is after the logs redone.
+    buffer_flush_old_pages(g_LSN.load() + 1);
 }
 
 std::set<int> analysis(void) {
     int64_t LSN;
+    int64_t end_LSN;
     std::set<int> loser_list;
     std::set<int> winner_list;
-    trx_log_t* trx_log;
-    update_log_t* update_log;
-    compensate_log_t* compensate_log;
+    compensate_log_t log;
+    trx_log_t* trx_log = (trx_log_t*)&log;
+    update_log_t* update_log = (update_log_t*)&log;
+    checkpoint_header_t header;
+    std::vector<dirty_page_entry_t> dirty_pages;
+    std::vector<checkpoint_trx_entry_t> active_trxs;
+    buffer_page_id_t page_id;
+    // The first bulk load log after the checkpoint. Redo must see it.
+    int64_t bulk_load_LSN;
+    int i;
 
     fprintf(logmsg_file_fp, "[ANALYSIS] Analysis pass start\n");
-    
-    LSN = 0;
-    while (LSN < g_flushed_LSN) {
-        read_log_file_to_buffer(LSN);
-        while (LSN + TRX_LOG_SIZE) <= LOG_BUFFER_SIZE) {
-            mempcy(trx_log, &log_buffer[LSN], TRX_LOG_SIZE);
-            if (trx_log->type == kBegin) {
-                loser_list.insert(trx_log->trx_id);
-            } else if (trx_log->type == kCommit || trx_log->type == kRollback) {
-                loser_list.erase(trx_log->trx_id);
-                winner_list.insert(trx_log->trx_id);
-            }
-            LSN += trx_log->log_size;
+
+    end_LSN = g_flushed_LSN;
+    recovery_dirty_pages.clear();
+    recovery_first_LSN.clear();
+    bulk_load_LSN = end_LSN;
+
+    // I. Start from the last checkpoint, if any.
+    if (read_checkpoint(&header, dirty_pages, active_trxs) == true) {
+        for (i = 0; i < (int)dirty_pages.size(); i++)
+            recovery_dirty_pages[buffer_page_id_t(dirty_pages[i].table_id, dirty_pages[i].pagenum)] = dirty_pages[i].recLSN;
+        for (i = 0; i < (int)active_trxs.size(); i++) {
+            loser_list.insert(active_trxs[i].trx_id);
+            recovery_first_LSN[active_trxs[i].trx_id] = active_trxs[i].first_LSN;
         }
+        LSN = header.start_LSN;
+        g_last_LSN = header.last_LSN;
+        fprintf(logmsg_file_fp, "[ANALYSIS] Checkpoint LSN %ld, %d dirty pages, %d active trxs\n", header.start_LSN, header.number_of_dirty_pages, header.number_of_active_trxs);
+    } else {
+        LSN = 0;
+        g_last_LSN = -1;
     }
 
+    // II. Update the trx table and the dirty page table.
+    for (; LSN < end_LSN; LSN += trx_log->log_size) {
+        get_log(trx_log, LSN, TRX_LOG_SIZE);
+        if (trx_log->type == kBegin) {
+            loser_list.insert(trx_log->trx_id);
+            recovery_first_LSN[trx_log->trx_id] = LSN;
+        } else if (trx_log->type == kCommit || trx_log->type == kRollback) {
+            loser_list.erase(trx_log->trx_id);
+            recovery_first_LSN.erase(trx_log->trx_id);
+            winner_list.insert(trx_log->trx_id);
+        } else if (trx_log->type == kUpdate || trx_log->type == kCompensate) {
+            get_log(update_log, LSN, UPDATE_LOG_HEADER_SIZE);
+            page_id = buffer_page_id_t(update_log->table_id, update_log->page_id);
+            if (recovery_dirty_pages.find(page_id) == recovery_dirty_pages.end())
+                recovery_dirty_pages[page_id] = LSN;
+        } else if (trx_log->type == kBulkLoad) {
+            bulk_load_LSN = std::min(bulk_load_LSN, LSN);
+        }
+        g_last_LSN = LSN;
+    }
+
+    // III. Redo from the oldest recLSN, and undo from the oldest begin log of the losers.
+    redo_start_LSN = bulk_load_LSN;
+    for (std::unordered_map<buffer_page_id_t, int64_t, BufferPageHash>::iterator it = recovery_dirty_pages.begin(); it != recovery_dirty_pages.end(); it++)
+        redo_start_LSN = std::min(redo_start_LSN, it->second);
+    undo_start_LSN = end_LSN;
+    for (std::unordered_map<int, int64_t>::iterator it = recovery_first_LSN.begin(); it != recovery_first_LSN.end(); it++)
+        undo_start_LSN = std::min(undo_start_LSN, it->second);
+
     fprintf(logmsg_file_fp, "[ANALYSIS] Analysis success. Winner:");
-    for (std::vector<int>::iterator it = winner_list.begin(); it != winner_list.end(); it++) 
-        fpinrtf(logmsg_file_fp, " %d", *it);
+    for (std::set<int>::iterator it = winner_list.begin(); it != winner_list.end(); it++)
+        fprintf(logmsg_file_fp, " %d", *it);
     fprintf(logmsg_file_fp, ", Loser:");
-    for (std::vector<int>::iterator it = loser_list.begin(); it != loser_list.end(); it++)
+    for (std::set<int>::iterator it = loser_list.begin(); it != loser_list.end(); it++)
         fprintf(logmsg_file_fp, " %d", *it);
-    fprintf("\n");
+    fprintf(logmsg_file_fp, "\n");
+    fprintf(logmsg_file_fp, "[ANALYSIS] Redo from LSN %ld, undo from LSN %ld\n", redo_start_LSN, undo_start_LSN);
 
     return loser_list;
 }
 int redo(int log_num) {
     int64_t LSN;
-    trx_log_t* trx_log;
-    update_log_t* update_log;
-    compensate_log_t* compensate_log;
+    int64_t end_LSN;
+    compensate_log_t log;
+    trx_log_t* trx_log = (trx_log_t*)&log;
+    update_log_t* update_log = (update_log_t*)&log;
+    compensate_log_t* compensate_log = &log;
+    bulk_load_log_t* bulk_load_log = (bulk_load_log_t*)&log;
     int leaf_bufnum;
     node_page_t* leaf_page;
     int log_count = 0;
-    bool update_flag
+    bool update_flag;
+    std::unordered_map<buffer_page_id_t, int64_t, BufferPageHash>::iterator dirty_page;
 
     fprintf(logmsg_file_fp, "[REDO] Redo pass start\n");
 
-    LSN = 0;
-    while (LSN < g_flushed_LSN) {
-        read_log_file_to_buffer(LSN);
-        while(LSN + TRX_LOG_SIZE <= LOG_BUFFER_SIZE) {
-            if (log_num != 0 && log_count == log_num) {
-                return OP_SUCCESS;
-            }
-            memcpy(trx_log, &log_buffer[LSN], TRX_LOG_SIZE);
-            if (trx_log->type == kBegin) {
-                frpintf(logmsg_file_fp, "LSN %lu [BEGIN] Transaction id %d\n", trx_log->LSN, trx_log->trx_id);
-                log_count += 1;
-            } else if (trx_log->type == kCommit) {
-                fprintf(logmsg_file_fp, "LSN %lu [COMMIT] Transaction id %d\n", trx_log->LSN, trx_log->trx_id);
-                log_count += 1;
-            } else if (trx_log->type == kRollback) {
-                fprintf(logmsg_file_fp, "LSN %lu [ROLLBACK] Transaction id %d\n", trx_log->LSN, trx_log->trx_id);
-                log_count += 1;
-            } else if (trx_log->type == kUpdate) {
-                memcpy(update_log, &log_buffer[LSN], trx_log->log_size);
-                // Redo.
-                buffer_request_page(update_log->table_id, update_log->page_id, leaf_page, &leaf_bufnum);
-                if (update_log->LSN > leaf_page->header.LSN) {
-                    memcpy(&leaf_page->values[VALUE_OFFSET(update_log->offset)], update_log->new_img, update_log->data_length);
-                    leaf_page->header.LSN = update_log->LSN;
-                    fprintf(logmsg_file_fp, "LSN %lu [UPDATE] Transaction id %d redo apply\n", update_log->LSN, update_log->trx_id);
-                } else {
-                    fprintf(logmsg_file_fp, "LSN %lu [CONSIDER-REDO] Transaction id %d\n", update_log->LSN, update_log->trx_id);
-                }
+    prefetch_redo_pages();
+
+    end_LSN = g_flushed_LSN;
+    for (LSN = redo_start_LSN; LSN < end_LSN; LSN += trx_log->log_size) {
+        if (log_num != 0 && log_count == log_num) {
+            return OP_SUCCESS;
+        }
+        get_log(trx_log, LSN, TRX_LOG_SIZE);
+        if (trx_log->type == kBegin) {
+            fprintf(logmsg_file_fp, "LSN %ld [BEGIN] Transaction id %d\n", trx_log->LSN, trx_log->trx_id);
+            log_count += 1;
+        } else if (trx_log->type == kCommit) {
+            fprintf(logmsg_file_fp, "LSN %ld [COMMIT] Transaction id %d\n", trx_log->LSN, trx_log->trx_id);
+            log_count += 1;
+        } else if (trx_log->type == kRollback) {
+            fprintf(logmsg_file_fp, "LSN %ld [ROLLBACK] Transaction id %d\n", trx_log->LSN, trx_log->trx_id);
+            log_count += 1;
+        } else if (trx_log->type == kUpdate) {
+            get_log(update_log, LSN, trx_log->log_size);
+            // The page on disk is up to date without reading it.
+            dirty_page = recovery_dirty_pages.find(buffer_page_id_t(update_log->table_id, update_log->page_id));
+            if (dirty_page == recovery_dirty_pages.end() || LSN < dirty_page->second) {
+                fprintf(logmsg_file_fp, "LSN %ld [CONSIDER-REDO] Transaction id %d\n", update_log->LSN, update_log->trx_id);
                 log_count += 1;
-                buffer_release_page(leaf_bufnum, true);
-            } else if (trx_log->type == kCompensate) {
-                memcpy(compensate_log, &log_buffer[LSN], trx_log->log_size);
-                // Redo.
-                buffer_request_page(compensate_log->table_id, compensate_log->page_id, leaf_page, &leaf_bufnum);
-                update_flag = false;
-                if (compensate_log->LSN > leaf_page->header.LSN) {
-                    update_flag = true;
-                    memcpy(&leaf_page->values[VALUE_OFFSET(compensate_log->offset)], compensate_log->new_img, compensate_log->data_length);
-                    leaf_page->header.LSN = compensate_log->LSN;
-                    fprintf(logmsg_file_fp, "LSN %lu [CLR] next undo lsn %lu\n", compensate_log->LSN, compensate_log->next_undo_LSN);
-                } else {
-                    fprintf(logmsg_file_fp, "LSN %lu [CONSIDER-REDO] Transaction id %d\n", compensate_log->LSN, compensate_log->trx_id);
-                }
-                buffer_release_page(leaf_bufnum, update_flag;)
+                continue;
+            }
+            open_log_table_file(update_log->table_id);
+            // Redo.
+            buffer_request_page(update_log->table_id, update_log->page_id, leaf_page, &leaf_bufnum);
+            update_flag = false;
+            if (update_log->LSN > leaf_page->header.LSN) {
+                update_flag = true;
+                memcpy(&leaf_page->values[VALUE_OFFSET(update_log->offset)], LOG_NEW_IMG(update_log), update_log->data_length);
+                leaf_page->header.LSN = update_log->LSN;
+                fprintf(logmsg_file_fp, "LSN %ld [UPDATE] Transaction id %d redo apply\n", update_log->LSN, update_log->trx_id);
+            } else {
+                fprintf(logmsg_file_fp, "LSN %ld [CONSIDER-REDO] Transaction id %d\n", update_log->LSN, update_log->trx_id);
+            }
+            log_count += 1;
+            buffer_release_page(leaf_bufnum, update_flag);
+        } else if (trx_log->type == kCompensate) {
+            get_log(compensate_log, LSN, trx_log->log_size);
+            dirty_page = recovery_dirty_pages.find(buffer_page_id_t(compensate_log->table_id, compensate_log->page_id));
+            if (dirty_page == recovery_dirty_pages.end() || LSN < dirty_page->second) {
+                fprintf(logmsg_file_fp, "LSN %ld [CONSIDER-REDO] Transaction id %d\n", compensate_log->LSN, compensate_log->trx_id);
                 log_count += 1;
+                continue;
+            }
+            open_log_table_file(compensate_log->table_id);
+            // Redo.
+            buffer_request_page(compensate_log->table_id, compensate_log->page_id, leaf_page, &leaf_bufnum);
+            update_flag = false;
+            if (compensate_log->LSN > leaf_page->header.LSN) {
+                update_flag = true;
+                memcpy(&leaf_page->values[VALUE_OFFSET(compensate_log->offset)], LOG_NEW_IMG(compensate_log), compensate_log->data_length);
+                leaf_page->header.LSN = compensate_log->LSN;
+                fprintf(logmsg_file_fp, "LSN %ld [CLR] next undo lsn %ld\n", compensate_log->LSN, compensate_log->next_undo_LSN);
+            } else {
+                fprintf(logmsg_file_fp, "LSN %ld [CONSIDER-REDO] Transaction id %d\n", compensate_log->LSN, compensate_log->trx_id);
+            }
+            buffer_release_page(leaf_bufnum, update_flag);
+            log_count += 1;
+        } else if (trx_log->type == kBulkLoad) {
+            get_log(bulk_load_log, LSN, trx_log->log_size);
+            open_log_table_file(bulk_load_log->table_id);
+            // The pages were forced before the log. Only the header page may be behind.
+            if (file_get_root_pagenum(bulk_load_log->table_id) == 0) {
+                file_set_root_pagenum(bulk_load_log->table_id, bulk_load_log->root_pagenum);
+                fprintf(logmsg_file_fp, "LSN %ld [BULK LOAD] Table id %ld, root page %ld redo apply\n", bulk_load_log->LSN, bulk_load_log->table_id, bulk_load_log->root_pagenum);
             } else {
-                perror("Log type error: in redo()");
-                exit(EXIT_FAILURE);
+                fprintf(logmsg_file_fp, "LSN %ld [CONSIDER-REDO] Table id %ld\n", bulk_load_log->LSN, bulk_load_log->table_id);
             }
-            LSN += trx_log->log_size;
+            log_count += 1;
+        } else {
+            perror("Log type error: in redo()");
+            exit(EXIT_FAILURE);
         }
     }
     fprintf(logmsg_file_fp, "[REDO] Redo pass end\n");
 
     return OP_SUCCESS;
 }
-int undo(std::set<int> loser_list, int log_num) {
-    std::set<int>::iterator trx_id;
+void prefetch_redo_pages(void) {
+    std::vector< std::pair<int64_t, buffer_page_id_t> > pages;
+    std::map< table_id_t, std::vector<pagenum_t> > table_pagenums;
+    int i;
+
+    // I. The pages in the order redo requests them, as many as half of the buffer.
+    for (std::unordered_map<buffer_page_id_t, int64_t, BufferPageHash>::iterator it = recovery_dirty_pages.begin(); it != recovery_dirty_pages.end(); it++)
+        pages.push_back(std::make_pair(it->second, it->first));
+    std::sort(pages.begin(), pages.end());
+    if ((int)pages.size() > buffer_get_number_of_frames() / 2)
+        pages.resize(buffer_get_number_of_frames() / 2);
+
+    // II. Read each table in the order of the pages in the file.
+    for (i = 0; i < (int)pages.size(); i++)
+        table_pagenums[pages[i].second.first].push_back(pages[i].second.second);
+    for (std::map< table_id_t, std::vector<pagenum_t> >::iterator it = table_pagenums.begin(); it != table_pagenums.end(); it++) {
+        open_log_table_file(it->first);
+        std::sort(it->second.begin(), it->second.end());
+        buffer_prefetch_pages(it->first, it->second);
+    }
+}
 
+int undo(std::set<int> loser_list, int log_num) {
     int64_t LSN;
-    trx_log_t* trx_log;
-    update_log_t* update_log;
-    compensate_log_t* compensate_log;
+    int64_t end_LSN;
+    compensate_log_t log;
+    trx_log_t* trx_log = (trx_log_t*)&log;
+    update_log_t* update_log = (update_log_t*)&log;
+    compensate_log_t* compensate_log = &log;
     int leaf_bufnum;
     node_page_t* leaf_page;
+    int64_t CLR_LSN;
 
-    int64_t lastLSN;
-    bool update_flag;
+    // (LSN, LSN to undo next in the trx) of the loser logs.
+    std::vector< std::pair<int64_t, int64_t> > loser_logs;
+    std::vector< std::pair<int64_t, int64_t> >::reverse_iterator it;
+    // LSN of the last update or begin log of each loser.
+    std::unordered_map<int, int64_t> last_LSN;
+    // Logs after the next undo LSN of the last CLR are already undone.
+    std::unordered_map<int, int64_t> undo_limit;
 
     int log_count = 0;
 
     fprintf(logmsg_file_fp, "[UNDO] Undo pass start\n");
 
-    // Make the losers active.
-    for (trx_id = loser_list.begin(); trx_id != loser_list.end(); trx_id++) {
-        trx_surrect(trx_surrect);
-    }
-    // Add the LSNs to trx queue_LSN.
-    LSN = 0;
-    while (LSN < g_flushed_LSN) {
-        read_log_file_to_buffer(LSN);
-        while(LSN + TRX_LOG_SIZE <= LOG_BUFFER_SIZE) {
-            memcpy(trx_log, &log_buffer[LSN], TRX_LOG_SIZE);
-            if (loser_list.find(trx_log->trx_id) != loser_list.end())
-                trx_push_log_to_queue(trx_log->LSN, trx_log->trx_id);
-            LSN += trx_log->log_size;
+    // Collect the logs of the losers, from the oldest begin log.
+    end_LSN = g_flushed_LSN;
+    for (LSN = undo_start_LSN; LSN < end_LSN; LSN += trx_log->log_size) {
+        get_log(trx_log, LSN, TRX_LOG_SIZE);
+        if (loser_list.find(trx_log->trx_id) == loser_list.end())
+            continue;
+        if (trx_log->type == kBegin || trx_log->type == kUpdate) {
+            loser_logs.push_back(std::make_pair(LSN, trx_log->type == kBegin ? LSN : last_LSN[trx_log->trx_id]));
+            last_LSN[trx_log->trx_id] = LSN;
+        } else {
+            loser_logs.push_back(std::make_pair(LSN, LSN));
         }
     }
 
-    lastLSN = LSN - trx_log->log_size;
-    trx_log = (trx_log_t*)malloc(sizeof(trx_log_t));
-    if (trx_log == NULL) {
-        perror("Memory allcation error");
-        exit(EXIT_FAILURE);
-    }
-    update_log = (update_log_t*)malloc(sizeof(update_log_t));
-    if (update_log == NULL) {
-        perror("Memory allcation error");
-        exit(EXIT_FAILURE);
-    }
-    compensate_log = (compensate_log_t*)malloc(sizeof(compensate_log));
-    if (compensate_log == NULL) {
-        perror("Memory allcation error");
-        exit(EXIT_FAILURE);
-    }
-
-    // TODO: 여기서 부터 user connection 받아야 하는데 어떻게 같이 받지?
-    // Undo.
-    while (loser_list.empty() != false) {
-        if (log_num != 0 && log_count == log_num) {
-            free(trx_log);
-            free(update_log);
-            free(compensate_log);
-            return OP_SUCCESS;
-        }
-
-        // Identify the log type.
-        get_log(trx_log, lastLSN, TRX_LOG_SIZE);
-        if (trx_log->type == kBegin) {
-
-            // Remain log.
-            log_create(kRollback, trx_log->trx_id);
-
-            // Kill the trx.
-            trx_kill(trx_log->trx_id);
-            loser_list.erase(trx_log->trx_id);
-
-            fprintf(logmsg_file_fp, "LSN %lu [ROLLBACK] Transaction id %d", trx_log->LSN, trx_id, trx_log->trx_id);
-
-            // TODO: begin도 세어야 하나?
-            count += 1;
+    // Undo from the last log.
+    for (it = loser_logs.rbegin(); it != loser_logs.rend(); it++) {
+        get_log(trx_log, it->first, TRX_LOG_SIZE);
+        if (trx_log->type == kCompensate) {
+            get_log(compensate_log, it->first, trx_log->log_size);
+            if (undo_limit.find(compensate_log->trx_id) == undo_limit.end())
+                undo_limit[compensate_log->trx_id] = compensate_log->next_undo_LSN;
         } else if (trx_log->type == kUpdate) {
-            get_log(update_log, lastLSN, trx_log->log_size);
+            if (undo_limit.find(trx_log->trx_id) != undo_limit.end() && it->first > undo_limit[trx_log->trx_id])
+                continue;
+            if (log_num != 0 && log_count == log_num)
+                break;
+            get_log(update_log, it->first, trx_log->log_size);
+            open_log_table_file(update_log->table_id);
 
-            // Pop the LSN from the queue of the trx.
-            trx_pop_log_from_queue(update_log->trx_id);
-            // Update the last LSN
-            lastLSN = trx_get_last_LSN(update_log->trx_id);
+            // Create CLR.
+            CLR_LSN = log_create(kCompensate, update_log->trx_id, update_log->table_id, update_log->page_id, update_log->offset, update_log->data_length, LOG_NEW_IMG(update_log), LOG_OLD_IMG(update_log), it->second);
 
             // Undo.
             buffer_request_page(update_log->table_id, update_log->page_id, leaf_page, &leaf_bufnum);
-            update_flag = false;
-            if (update_log->LSN <= leaf_page->header.LSN) {
-                // Create CLR.
-                log_create(kCompensate, update_log->trx_id, update_log->table_id, update_log->page_id, update_log->offset, update_log->data_length, update_log->new_img, update_log->old_img, trx_get_last_LSN(update_log->trx_id));
-
-                // Update.
-                update_flag = true;
-                memcpy(&leaf_page->values[VALUE_OFFSET(update_log->offset)], update_log->old_img, update_log->data_length);
-                fprintf(logmsg_file_fp, "LSN %lu [UPDATE] Transaction id %d undo apply", update_log->LSN, update_log->trx_id);
+            memcpy(&leaf_page->values[VALUE_OFFSET(update_log->offset)], LOG_OLD_IMG(update_log), update_log->data_length);
+            leaf_page->header.LSN = CLR_LSN;
+            buffer_release_page(leaf_bufnum, true);
+            fprintf(logmsg_file_fp, "LSN %ld [UPDATE] Transaction id %d undo apply\n", update_log->LSN, update_log->trx_id);
 
-                count += 1;
-            }
-            buffer_release_page(leaf_bufnum, update_flag);
-        } else if (trx_log->type == kCompensate) {
-            get_log(compensate_log, lastLSN, trx_log->log_size);
-
-            // Pop the LSN (> lastLSN) from the queue of the trx.
-            while (trx_get_last_LSN(compensate_log->trx_id) > compensate_log->next_undo_LSN)
-                trx_pop_log_from_queue(compensate_log->trx_id);
-            // Update the last LSN.
-            lastLSN = trx_get_last_LSN(compensate_log->trx_id);
-
-            // Undo.
-            buffer_request_page(compensate_log->table_id, compensate_log->page_id, leaf_page, &leaf_bufnum);
-            update_flag = false;
-            if (compensate_log->LSN <= leaf_page->header.LSN) {
-                // Create CLR.
-                log_create(kCompensate, compensate_log->trx_id, compensate_log->table_id, compensate_log->page_id, compensate_log->offset, compensate_log->data_length, compensate_log->new_img, compensate_log->old_img, trx_get_last_LSN(compensate_log->trx_id));
-
-                // Update.
-                update_flag = true;
-                memcpy(&leaf_page->values[VALUE_OFFSET(compensate_log->offset)], compensate_log->old_img, compensate_log->data_length);
-                fprintf(logmsg_file_fp, "LSN %lu [CLR] next undo lsn %lu\n", compensate_log->LSN, compensate_log->next_undo_LSN);
+            log_count += 1;
+        } else if (trx_log->type == kBegin) {
+            // Remain log.
+            log_create(kRollback, trx_log->trx_id);
+            loser_list.erase(trx_log->trx_id);
 
-                count += 1;
-            }
-            buffer_release_page(leaf_bufnum, update_flag);
+            fprintf(logmsg_file_fp, "LSN %ld [ROLLBACK] Transaction id %d\n", trx_log->LSN, trx_log->trx_id);
         }
-        
-        // Update the last LSN of the trx. Find the maximum last LSN.
-        for (trx_id = loser_list.begin(); trx_id != loser_list.end(); trx_id++)
-            lastLSN = std::max(lastLSN, trx_get_last_LSN(trx_id));
     }
 
-    free(trx_log);
-    free(update_log);
-    free(compensate_log);
+    // Force the CLRs.
+    log_flush();
 
-    fprintf(logmsg_file_fp, "[UNDO] Undo pass end\n");
+    if (it == loser_logs.rend())
+        fprintf(logmsg_file_fp, "[UNDO] Undo pass end\n");
 
     return OP_SUCCESS;
 }
 
-void read_log_file_to_buffer(int64_t LSN) {
-    lseek(log_file_fd, LSN, 0);
-    if (read(log_file_fd, log_buffer, LOG_BUFFER_SIZE)) {
-        perror("File read failure");
+// Open the table file of the log, if not opened.
+void open_log_table_file(table_id_t table_id) {
+    char pathname[32];
+
+    if (file_is_valid_table_id(table_id) == true)
+        return;
+    sprintf(pathname, "DATA%ld", table_id);
+    if (file_open_table_file(pathname) != table_id) {
+        perror("Table open failure: in open_log_table_file()");
         exit(EXIT_FAILURE);
     }
 }
-void wrtie_log_buffer_to_file(int log_buffer_size) {
-    lseek(log_file_fd, 0, SEEK_END);
-    if (write(log_file_fd, log_buffer, log_buffer_size) != log_buffer_size) {
+
+void write_log_to_file(int64_t LSN, int64_t size) {
+    int64_t offset = LSN % LOG_BUFFER_SIZE;
+    int64_t first_size = std::min(size, LOG_BUFFER_SIZE - offset);
+
+    if (size <= 0)
+        return;
+    if (pwrite(log_file_fd, &log_buffer[offset], first_size, LSN) != first_size) {
+        perror("File write failure");
+        exit(EXIT_FAILURE);
+    }
+    // Wrap around.
+    if (first_size < size && pwrite(log_file_fd, log_buffer, size - first_size, LSN + first_size) != size - first_size) {
         perror("File write failure");
         exit(EXIT_FAILURE);
     }
@@ -436,26 +897,25 @@ void wrtie_log_buffer_to_file(int log_buffer_size) {
         exit (EXIT_FAILURE);
     }
 }
-void read_log_from_file(void* log, int offset_from_end, int log_size) {
-    lseek(log_file_fd, offset_from_end, SEEK_END);
-    if (read(log_file_fd, log, log_size) != log_size) {
+void read_log_from_file(void* log, int64_t LSN, int log_size) {
+    if (pread(log_file_fd, log, log_size, LSN) != log_size) {
         perror("File read failure: in read_log_from_file()");
         exit(EXIT_FAILURE);
     }
 }
 
 void get_log(void* log, int64_t LSN, int log_size) {
-
     // The log is on disk.
-    if (LSN < g_buffer_LSN) {
-        if (g_buffer_LSN < 0) {
-            perror("fatal: in log_get_update_log()");
-            exit(EXIT_FAILURE);
-        }
-        read_log_from_file(log, LSN - g_flushed_LSN, log->log_size);
+    if (LSN < g_flushed_LSN.load()) {
+        read_log_from_file(log, LSN, log_size);
     }
-    // The log is in buffer.
+    // The log is in the ring.
     else {
-        memcpy(log, &log_buffer[LSN - g_buffer_LSN], log_size);
+        copy_from_log_buffer(log, LSN, log_size);
+        // The ring may have been overwritten while copying. Then, the log is on disk.
+        if (g_LSN.load() - LOG_BUFFER_SIZE > LSN) {
+            log_flush(LSN);
+            read_log_from_file(log, LSN, log_size);
+        }
     }
-}
\ No newline at end of file
+}
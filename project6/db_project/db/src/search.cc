@@ -0,0 +1,128 @@
+#include "search.h"
+
+#include <stddef.h>
+#include <string.h>
+#include <immintrin.h>
+
+#include <algorithm>
+
+static_assert(sizeof(slot_t) == SEARCH_ENTRY_SIZE && offsetof(slot_t, key) == 0, "slot_t is not searchable");
+static_assert(sizeof(branch_t) == SEARCH_ENTRY_SIZE && offsetof(branch_t, key) == 0, "branch_t is not searchable");
+
+#define ENTRY_KEY(entries, index) (*(const int64_t*)((entries) + (size_t)(index) * SEARCH_ENTRY_SIZE))
+
+// Data structures used in the search kernel.
+SearchKernelType search_kernel_type = kSearchScalar;
+int (*search_count)(const char* entries, int64_t key) = search_count_window_scalar;
+
+void search_init(void) {
+    search_set_kernel(kSearchAVX2);
+}
+
+SearchKernelType search_set_kernel(SearchKernelType type) {
+    // __builtin_cpu_supports() reads cpuid.
+    __builtin_cpu_init();
+    if (type == kSearchAVX2 && __builtin_cpu_supports("avx2") == 0)
+        type = kSearchSSE42;
+    if (type == kSearchSSE42 && __builtin_cpu_supports("sse4.2") == 0)
+        type = kSearchScalar;
+
+    switch (type) {
+        case kSearchAVX2:
+            search_count = search_count_window_avx2;
+            break;
+        case kSearchSSE42:
+            search_count = search_count_window_sse42;
+            break;
+        case kSearchScalar:
+        default:
+            search_count = search_count_window_scalar;
+            break;
+    }
+    search_kernel_type = type;
+    return type;
+}
+
+SearchKernelType search_get_kernel(void) {
+    return search_kernel_type;
+}
+
+int search_upper_bound(const void* entries, int number_of_entries, int64_t key) {
+    const char* base = (const char*)entries;
+    const char* last_window = base + (size_t)(number_of_entries - SEARCH_LINEAR_ENTRIES) * SEARCH_ENTRY_SIZE;
+    int half;
+
+    // Too few entries for the window.
+    if (number_of_entries < SEARCH_LINEAR_ENTRIES)
+        return search_count_scalar(base, number_of_entries, key);
+
+    // The answer is in [base, base + number_of_entries].
+    // Every key before base is not greater than key, and every key from base + number_of_entries is greater.
+    while (number_of_entries > SEARCH_LINEAR_ENTRIES) {
+        half = number_of_entries / 2;
+        // Compiled to a conditional move.
+        base = ENTRY_KEY(base, half) <= key ? base + (size_t)half * SEARCH_ENTRY_SIZE : base;
+        number_of_entries -= half;
+    }
+    // Widen the rest to a full window inside the entries. The invariant still holds.
+    base = std::min(base, last_window);
+    return (int)((base - (const char*)entries) / SEARCH_ENTRY_SIZE) + search_count(base, key);
+}
+
+int search_lower_bound(const void* entries, int number_of_entries, int64_t key) {
+    // No key is smaller than INT64_MIN.
+    if (key == INT64_MIN)
+        return 0;
+    return search_upper_bound(entries, number_of_entries, key - 1);
+}
+
+// Kernels
+int search_count_scalar(const char* entries, int number_of_entries, int64_t key) {
+    const char* base = entries;
+    int half;
+
+    if (number_of_entries == 0)
+        return 0;
+    while (number_of_entries > 1) {
+        half = number_of_entries / 2;
+        base = ENTRY_KEY(base, half) <= key ? base + (size_t)half * SEARCH_ENTRY_SIZE : base;
+        number_of_entries -= half;
+    }
+    return (int)((base - entries) / SEARCH_ENTRY_SIZE) + (ENTRY_KEY(base, 0) <= key);
+}
+
+int search_count_window_scalar(const char* entries, int64_t key) {
+    return search_count_scalar(entries, SEARCH_LINEAR_ENTRIES, key);
+}
+
+__attribute__((target("sse4.2")))
+int search_count_window_sse42(const char* entries, int64_t key) {
+    __m128i key_vec = _mm_set1_epi64x(key);
+    __m128i entry;
+    int mask = 0;
+    int i;
+
+    // [key, the rest of the entry] per compare. Only the low lane counts.
+    for (i = 0; i < SEARCH_LINEAR_ENTRIES; i++) {
+        entry = _mm_loadu_si128((const __m128i*)(entries + (size_t)i * SEARCH_ENTRY_SIZE));
+        mask |= (_mm_movemask_pd(_mm_castsi128_pd(_mm_cmpgt_epi64(entry, key_vec))) & 1) << i;
+    }
+    // The keys greater than key are set.
+    return SEARCH_LINEAR_ENTRIES - __builtin_popcount(mask);
+}
+
+__attribute__((target("avx2")))
+int search_count_window_avx2(const char* entries, int64_t key) {
+    __m256i key_vec = _mm256_set1_epi64x(key);
+    __m256i entry;
+    int mask = 0;
+    int i;
+
+    // [key, -, key, -] per compare. Only the lanes 0 and 2 count.
+    for (i = 0; i < SEARCH_LINEAR_ENTRIES; i += 2) {
+        entry = _mm256_loadu_si256((const __m256i*)(entries + (size_t)i * SEARCH_ENTRY_SIZE));
+        mask |= (_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(entry, key_vec))) & 0x5) << (2 * i);
+    }
+    // The keys greater than key are set.
+    return SEARCH_LINEAR_ENTRIES - __builtin_popcount(mask);
+}
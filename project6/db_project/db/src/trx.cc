@@ -5,12 +5,14 @@
 #include <stdlib.h>
 #include <stdio.h>
 
+#include <algorithm>
 #include <unordered_map>
 #include <utility>
 #include <cstring>
 
 #include "buffer.h"
 #include "log.h"
+#include "search.h"
 
 // Lock Table
 std::unordered_map<hash_id_t, lock_table_entry_t, Hash> lock_table;
@@ -21,6 +23,9 @@ int g_trx_id;
 std::unordered_map<int, trx_t> trx_table;
 pthread_mutex_t trx_table_latch;
 
+// Test hook, called between the commit log and the erase of the trx, under trx_table_latch.
+void (*trx_test_commit_hook)(int trx_id) = NULL;
+
 int trx_init(void) {
     lock_table_latch = PTHREAD_MUTEX_INITIALIZER;
     trx_table_latch = PTHREAD_MUTEX_INITIALIZER;
@@ -335,6 +340,93 @@ lock_t* lock_acquire(int64_t table_id, pagenum_t page_id, int64_t key, int trx_i
     return new_lock_obj;
 }
 #endif
+int lock_acquire_batch(int64_t table_id, pagenum_t page_id, const int64_t* keys, int number_of_keys, int trx_id, int lock_mode) {
+
+    lock_table_entry_t* lock_table_entry;
+    lock_t* lock_pred;
+    lock_t* new_lock_obj;
+    std::vector<bool> is_held;
+    const int64_t* key_ptr;
+    int number_of_granted = number_of_keys;
+    int key_index;
+#if IMPLICIT_LOCKING
+    int leaf_bufnum;
+    node_page_t* leaf_page;
+    int slot_index;
+#endif
+
+    pthread_mutex_lock(&lock_table_latch);
+
+#if IMPLICIT_LOCKING
+    // I. Stop at the first key which may have an implicit lock. It is converted by lock_acquire().
+    buffer_request_page(table_id, page_id, leaf_page, &leaf_bufnum, kLatchShared);
+    for (key_index = 0; key_index < number_of_keys; key_index++) {
+        slot_index = search_slots(leaf_page->slots, leaf_page->header.number_of_keys, keys[key_index]);
+        if (slot_index >= 0 && is_alive_trx(leaf_page->slots[slot_index].trx_id) == true) {
+            number_of_granted = key_index;
+            break;
+        }
+    }
+    buffer_release_page(leaf_bufnum, false);
+#endif
+
+    // II. Traverse the lock list once. Find the keys already held, and the first conflicting key.
+    lock_table_entry = lock_table_get_entry(table_id, page_id);
+    is_held.assign(number_of_granted, false);
+    for (lock_pred = lock_table_entry->lock_list_head; lock_pred != NULL; lock_pred = lock_pred->lock_table_next) {
+        key_ptr = std::lower_bound(keys, keys + number_of_granted, lock_pred->key);
+        if (key_ptr == keys + number_of_granted || *key_ptr != lock_pred->key)
+            continue;
+        key_index = key_ptr - keys;
+        if (lock_pred->owner_trx_id == trx_id) {
+            if (lock_pred->lock_mode == kLockExclusive || lock_mode == kLockShared)
+                is_held[key_index] = true;
+        } else if (lock_pred->lock_mode == kLockExclusive || lock_mode == kLockExclusive) {
+            number_of_granted = key_index;
+        }
+    }
+
+    // III. Append the new lock objects of the granted keys.
+    pthread_mutex_lock(&trx_table_latch);
+    for (key_index = 0; key_index < number_of_granted; key_index++) {
+        if (is_held[key_index] == true)
+            continue;
+
+        new_lock_obj = (lock_t*)malloc(sizeof(lock_t));
+        if (new_lock_obj == NULL) {
+            perror("Memory allocation error");
+            exit(EXIT_FAILURE);
+        }
+        new_lock_obj->key = keys[key_index];
+        new_lock_obj->sentinel = lock_table_entry;
+        new_lock_obj->owner_trx_id = trx_id;
+        new_lock_obj->cond_var = PTHREAD_COND_INITIALIZER;
+        new_lock_obj->lock_mode = (LockMode)lock_mode;
+
+        // Push the new_lock_obj into trx_table.
+        new_lock_obj->trx_table_next = NULL;
+        if (trx_table[trx_id].lock_list_head == NULL)
+            trx_table[trx_id].lock_list_head = new_lock_obj;
+        else
+            trx_table[trx_id].lock_list_tail->trx_table_next = new_lock_obj;
+        trx_table[trx_id].lock_list_tail = new_lock_obj;
+
+        // Push the lock object into the lock table list.
+        new_lock_obj->lock_table_next = NULL;
+        new_lock_obj->lock_table_prev = lock_table_entry->lock_list_tail;
+        if (lock_table_entry->lock_list_head == NULL)
+            lock_table_entry->lock_list_head = new_lock_obj;
+        else
+            lock_table_entry->lock_list_tail->lock_table_next = new_lock_obj;
+        lock_table_entry->lock_list_tail = new_lock_obj;
+    }
+    pthread_mutex_unlock(&trx_table_latch);
+
+    pthread_mutex_unlock(&lock_table_latch);
+
+    return number_of_granted;
+}
+
 int lock_release(lock_t* lock_obj) {
 
     lock_table_entry_t* lock_table_entry;
@@ -423,6 +515,7 @@ bool lock_exists(int64_t table_id, pagenum_t page_id, int64_t key, int trx_id) {
         while (page_id != lock_table_entry->page_id) {
             if (lock_table_entry->entry_next == NULL) {
                 // If there is no entry corresponding table_id and page_id.
+                pthread_mutex_unlock(&lock_table_latch);
                 return false;
             }
             lock_table_entry = lock_table_entry->entry_next;
@@ -430,17 +523,16 @@ bool lock_exists(int64_t table_id, pagenum_t page_id, int64_t key, int trx_id) {
     }
     // II. there is no entry.
     else {
+        pthread_mutex_unlock(&lock_table_latch);
         return false;
     }
 
     // Traverse lock table list.
     lock_pred = lock_table_entry->lock_list_head;
     while (lock_pred != NULL) {
-        if (lock_pred->key == key) {
-            if (lock_pred->owner_trx_id == trx_id && lock_pred->lock_mode == kLockShared)
-                continue;
-            else
-                return true;
+        if (lock_pred->key == key && (lock_pred->owner_trx_id != trx_id || lock_pred->lock_mode != kLockShared)) {
+            pthread_mutex_unlock(&lock_table_latch);
+            return true;
         }
         lock_pred = lock_pred->lock_table_next;
     }
@@ -451,23 +543,33 @@ bool lock_exists(int64_t table_id, pagenum_t page_id, int64_t key, int trx_id) {
 }
 
 int trx_begin(void) {
+    int trx_id;
+
     pthread_mutex_lock(&trx_table_latch);
-    g_trx_id++;
-    trx_table[g_trx_id].lock_list_head = NULL;
-    trx_table[g_trx_id].lock_list_tail = NULL;
-    trx_table[g_trx_id].waiting_trx_id = 0;
+    trx_id = ++g_trx_id;
+    trx_table[trx_id].lock_list_head = NULL;
+    trx_table[trx_id].lock_list_tail = NULL;
+    trx_table[trx_id].waiting_trx_id = 0;
+    // Log under trx_table_latch, so that a checkpoint sees either the trx or its begin log.
+    trx_table[trx_id].first_LSN = log_create(kBegin, trx_id);
     pthread_mutex_unlock(&trx_table_latch);
 
-    log_create(kBegin, g_trx_id);
     // TODO: overflow 나면 어떡하지..? 언제 fail되는 거지?
-    return g_trx_id;
+    return trx_id;
 }
 
 int trx_commit(int trx_id) {
     lock_t* lock_obj;
+    int64_t commit_LSN;
 
-    // Clean up the info in the trx_table.
+    // Log and leave the trx_table under trx_table_latch, so that a checkpoint sees
+    // either the trx without its commit log or the commit log without the trx.
     pthread_mutex_lock(&trx_table_latch);
+    commit_LSN = log_create(kCommit, trx_id);
+    if (trx_test_commit_hook != NULL)
+        trx_test_commit_hook(trx_id);
+
+    // Clean up the info in the trx_table.
     while (trx_table[trx_id].lock_list_head != NULL) {
         lock_obj = trx_table[trx_id].lock_list_head;
         
@@ -481,9 +583,8 @@ int trx_commit(int trx_id) {
     trx_table.erase(trx_id);
     pthread_mutex_unlock(&trx_table_latch);
 
-    log_create(kCommit, trx_id);
-    // by WAL
-    log_flush();
+    // by WAL, wait for the group commit of the commit log.
+    log_flush(commit_LSN);
     return trx_id;
 }
 
@@ -492,8 +593,8 @@ int trx_abort(int trx_id) {
     node_page_t* leaf_page;
     update_log_t* update_log;
     lock_t* lock_obj;
-
-    pthread_mutex_lock(&trx_table_latch);
+    int64_t rollback_LSN;
+    std::queue<int64_t> undo_LSNs;
 
     update_log = (update_log_t*)malloc(sizeof(update_log_t));
     if (update_log == NULL) {
@@ -501,24 +602,32 @@ int trx_abort(int trx_id) {
         exit(EXIT_FAILURE);
     }
 
+    // Take the update logs out of the trx_table under its latch, as other trxs modify the table.
+    pthread_mutex_lock(&trx_table_latch);
+    undo_LSNs.swap(trx_table[trx_id].queue_LSN);
+    pthread_mutex_unlock(&trx_table_latch);
+
     // Updates canceled.
-    while (trx_table[trx_id].queue_LSN.empty() == false) {
-        log_get_update_log(update_log, trx_table[trx_id].queue_LSN.front());
-        trx_table[trx_id].queue_LSN.pop();
+    while (undo_LSNs.empty() == false) {
+        log_get_update_log(update_log, undo_LSNs.front());
+        undo_LSNs.pop();
 
         // Create CLR.
-        log_create(kCompensate, trx_id, update_log->table_id, update_log->page_id, update_log->offset, update_log->data_length, update_log->new_img, update_log->old_img, trx_table[trx_id].queue_LSN.front());
+        log_create(kCompensate, trx_id, update_log->table_id, update_log->page_id, update_log->offset, update_log->data_length, LOG_NEW_IMG(update_log), LOG_OLD_IMG(update_log), undo_LSNs.empty() ? 0 : undo_LSNs.front());
 
         // Undo.
         buffer_request_page(update_log->table_id, update_log->page_id, leaf_page, &leaf_bufnum);
-        memcpy(&leaf_page->values[VALUE_OFFSET(update_log->offset)], update_log->old_img, update_log->data_length);
+        memcpy(&leaf_page->values[VALUE_OFFSET(update_log->offset)], LOG_OLD_IMG(update_log), update_log->data_length);
         buffer_release_page(leaf_bufnum, true);
     }
 
     free(update_log);
 
-    // Trx cleaned up in trx_table
+    // Log and leave the trx_table under trx_table_latch, as in trx_commit().
     pthread_mutex_lock(&trx_table_latch);
+    rollback_LSN = log_create(kRollback, trx_id);
+
+    // Trx cleaned up in trx_table
     while (trx_table[trx_id].lock_list_head != NULL) {
         lock_obj = trx_table[trx_id].lock_list_head;
  
@@ -532,11 +641,8 @@ int trx_abort(int trx_id) {
     trx_table.erase(trx_id);
     pthread_mutex_unlock(&trx_table_latch);
 
-    log_create(kRollback, trx_id);
-    // by WAL
-    log_flush();
-
-    pthread_mutex_unlock(&trx_table_latch);
+    // by WAL, wait for the group commit of the rollback log.
+    log_flush(rollback_LSN);
 
     return trx_id;
 }
@@ -575,6 +681,22 @@ void trx_kill(int trx_id) {
     trx_table.erase(trx_id);
     pthread_mutex_unlock(&trx_table_latch);
 }
+int64_t trx_get_active_trxs(std::vector< std::pair<int, int64_t> >& active_trxs, int64_t* last_LSN) {
+    int64_t start_LSN;
+
+    pthread_mutex_lock(&trx_table_latch);
+    for (std::unordered_map<int, trx_t>::iterator it = trx_table.begin(); it != trx_table.end(); it++)
+        if (it->second.first_LSN >= 0)
+            active_trxs.push_back(std::make_pair(it->first, it->second.first_LSN));
+    // A trx beginning later logs after the logs reserved now, so after start_LSN.
+    start_LSN = log_get_filled_LSN(last_LSN);
+    pthread_mutex_unlock(&trx_table_latch);
+
+    return start_LSN;
+}
+void trx_test_set_commit_hook(void (*hook)(int trx_id)) {
+    trx_test_commit_hook = hook;
+}
 int trx_get_last_LSN(int trx_id) {
     if (trx_table[trx_id].queue_LSN.empty() == true)
         return 0;
@@ -593,7 +715,7 @@ int convert_implicit_to_explicit(int64_t table_id, pagenum_t page_id, int64_t ke
     bool existence_flag = false;
 
     // Get trx_id which modified the page last.
-    buffer_request_page(table_id, page_id, leaf_page, &leaf_bufnum);
+    buffer_request_page(table_id, page_id, leaf_page, &leaf_bufnum, kLatchShared);
     for (slot_index = 0; slot_index < leaf_page->header.number_of_keys; slot_index++) 
         if (key == leaf_page->slots[slot_index].key)
             break;
@@ -691,6 +813,23 @@ int convert_implicit_to_explicit(int64_t table_id, pagenum_t page_id, int64_t ke
     return 1;
 }
 
+lock_table_entry_t* lock_table_get_entry(int64_t table_id, pagenum_t page_id) {
+
+    lock_table_entry_t* lock_table_entry;
+
+    lock_table_entry = &lock_table[std::make_pair(table_id, page_id)];
+    // A new entry of the page.
+    if (lock_table_entry->page_id != page_id || lock_table_entry->table_id != table_id) {
+        lock_table_entry->table_id = table_id;
+        lock_table_entry->page_id = page_id;
+        lock_table_entry->lock_list_head = NULL;
+        lock_table_entry->lock_list_tail = NULL;
+        lock_table_entry->entry_prev = NULL;
+        lock_table_entry->entry_next = NULL;
+    }
+    return lock_table_entry;
+}
+
 bool is_alive_trx(int trx_id) {
     return (trx_table.find(trx_id) != trx_table.end());
 }
@@ -0,0 +1,255 @@
+#include "bpt.h"
+#include "log.h"
+#include "trx.h"
+
+#include <gtest/gtest.h>
+
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <fstream>
+#include <string>
+
+/*******************************************************************************
+ * Redo of the page writes left unforced by a crash.
+ * The pages are written without fsync, and the table file is synced only at a
+ * checkpoint. A crash loses the dirty pages in the buffer, and the restart must
+ * redo the committed updates from the log and undo the uncommitted ones.
+ ******************************************************************************/
+
+namespace {
+
+const int kNumRecords = 2000;
+const int kValueSize = 100;
+const int kNumLoserKeys = 10;
+
+char log_path[] = "log";
+char logmsg_path[] = "logmsg";
+char table_path[] = "DATA1";
+
+void make_value(char* value, char tag, int64_t key) {
+  memset(value, tag, kValueSize);
+  snprintf(value, 16, "%c%08ld", tag, key);
+}
+
+// Run the phase in a child process, which leaves by _exit() as crashed.
+// Return the exit status of the child.
+int run_in_child(void (*phase)(void)) {
+  pid_t pid;
+  int status;
+
+  pid = fork();
+  if (pid == 0) {
+    phase();
+    _exit(0);
+  }
+  if (pid < 0 || waitpid(pid, &status, 0) != pid || !WIFEXITED(status))
+    return -1;
+  return WEXITSTATUS(status);
+}
+
+// Load the records, and shut down cleanly.
+void load_phase(void) {
+  char value[kValueSize];
+  int64_t table_id;
+  int64_t key;
+
+  init_db(100, 0, 0, log_path, logmsg_path);
+  table_id = open_table(table_path);
+  for (key = 0; key < kNumRecords; key++) {
+    make_value(value, 'i', key);
+    if (db_insert(table_id, key, value, kValueSize) != 0)
+      _exit(1);
+  }
+  shutdown_db();
+}
+
+// Update every record in committed trxs, then update some again in a trx left
+// uncommitted, and crash. The buffer holds fewer frames than the leaves, so that
+// the updated pages are evicted by unforced writes, and the last ones are dirty
+// at the crash.
+void update_and_crash_phase(void) {
+  char value[kValueSize];
+  uint16_t old_val_size;
+  int64_t table_id;
+  int64_t key;
+  int trx_id = 0;
+
+  init_db(50, 0, 0, log_path, logmsg_path);
+  table_id = open_table(table_path);
+  for (key = 0; key < kNumRecords; key++) {
+    if (key % 100 == 0)
+      trx_id = trx_begin();
+    make_value(value, 'u', key);
+    if (db_update(table_id, key, value, kValueSize, &old_val_size, trx_id) != 0)
+      _exit(1);
+    if (key % 100 == 99)
+      trx_commit(trx_id);
+  }
+
+  trx_id = trx_begin();
+  for (key = 0; key < kNumLoserKeys; key++) {
+    make_value(value, 'l', key);
+    if (db_update(table_id, key, value, kValueSize, &old_val_size, trx_id) != 0)
+      _exit(1);
+  }
+
+  // The commit of another trx flushes the logs of the uncommitted one.
+  trx_id = trx_begin();
+  key = kNumRecords - 1;
+  make_value(value, 'u', key);
+  if (db_update(table_id, key, value, kValueSize, &old_val_size, trx_id) != 0)
+    _exit(1);
+  trx_commit(trx_id);
+}
+
+pthread_t checkpoint_thread;
+
+void* checkpoint_main(void*) {
+  log_checkpoint();
+  return NULL;
+}
+
+// Take a checkpoint while the trx commits, after its commit log.
+// Give the checkpoint time to run, unless it waits for the commit to end.
+void checkpoint_in_commit(int) {
+  trx_test_set_commit_hook(NULL);
+  pthread_create(&checkpoint_thread, NULL, checkpoint_main, NULL);
+  usleep(200 * 1000);
+}
+
+// Update every record in a trx, whose commit is overlapped by a checkpoint, and crash.
+void commit_with_checkpoint_and_crash_phase(void) {
+  char value[kValueSize];
+  uint16_t old_val_size;
+  int64_t table_id;
+  int64_t key;
+  int trx_id;
+
+  init_db(100, 0, 0, log_path, logmsg_path);
+  table_id = open_table(table_path);
+  trx_id = trx_begin();
+  for (key = 0; key < kNumRecords; key++) {
+    make_value(value, 'u', key);
+    if (db_update(table_id, key, value, kValueSize, &old_val_size, trx_id) != 0)
+      _exit(1);
+  }
+  trx_test_set_commit_hook(checkpoint_in_commit);
+  trx_commit(trx_id);
+  pthread_join(checkpoint_thread, NULL);
+}
+
+int count_lines_with(const char* pathname, const char* pattern) {
+  std::ifstream in(pathname);
+  std::string line;
+  int count = 0;
+
+  while (std::getline(in, line))
+    if (line.find(pattern) != std::string::npos)
+      count++;
+  return count;
+}
+
+}  // namespace
+
+class RecoveryTest : public ::testing::Test {
+ protected:
+  RecoveryTest() {
+    char dir_template[] = "/tmp/db_recovery_testXXXXXX";
+
+    old_dir = getcwd(NULL, 0);
+    test_dir = mkdtemp(dir_template);
+    if (chdir(test_dir.c_str()) < 0)
+      test_dir.clear();
+  }
+
+  ~RecoveryTest() {
+    if (chdir(old_dir) == 0 && !test_dir.empty())
+      system(("rm -rf " + test_dir).c_str());
+    free(old_dir);
+  }
+
+  char* old_dir;
+  std::string test_dir;
+};
+
+/*
+ * Tests the redo of the unforced page writes.
+ * 1. Load the records and shut down
+ * 2. Update them with unforced page writes, and crash with an uncommitted trx
+ * 3. Restart, and check that the committed updates are redone and the
+ *    uncommitted ones undone
+ */
+TEST_F(RecoveryTest, RedoesUnforcedPageWrites) {
+  char value[kValueSize];
+  char expected[kValueSize];
+  uint16_t val_size;
+  int64_t table_id;
+  int64_t key;
+  int trx_id;
+
+  ASSERT_FALSE(test_dir.empty());
+  ASSERT_EQ(run_in_child(load_phase), 0);
+  ASSERT_EQ(run_in_child(update_and_crash_phase), 0);
+
+  // Restart with the recovery.
+  init_db(100, 0, 0, log_path, logmsg_path);
+  table_id = open_table(table_path);
+  ASSERT_GT(table_id, 0);
+
+  trx_id = trx_begin();
+  for (key = 0; key < kNumRecords; key++) {
+    ASSERT_EQ(db_find(table_id, key, value, &val_size, trx_id), 0) << "key " << key;
+    make_value(expected, 'u', key);
+    EXPECT_EQ(val_size, kValueSize) << "key " << key;
+    EXPECT_EQ(memcmp(value, expected, kValueSize), 0)
+        << "key " << key << ": " << std::string(value, 9);
+  }
+  trx_commit(trx_id);
+  shutdown_db();
+
+  // The crash left the last updated pages dirty, so the restart has redone them.
+  EXPECT_GT(count_lines_with(logmsg_path, "redo apply"), 0);
+  EXPECT_GT(count_lines_with(logmsg_path, "undo apply"), 0);
+}
+
+/*
+ * Tests a checkpoint taken while a trx commits.
+ * 1. Load the records and shut down
+ * 2. Update them in a trx, take a checkpoint after its commit log, and crash
+ * 3. Restart, and check that the trx is not rolled back as a loser
+ */
+TEST_F(RecoveryTest, KeepsTrxCommittedInCheckpoint) {
+  char value[kValueSize];
+  char expected[kValueSize];
+  uint16_t val_size;
+  int64_t table_id;
+  int64_t key;
+  int trx_id;
+
+  ASSERT_FALSE(test_dir.empty());
+  ASSERT_EQ(run_in_child(load_phase), 0);
+  ASSERT_EQ(run_in_child(commit_with_checkpoint_and_crash_phase), 0);
+
+  // Restart with the recovery.
+  init_db(100, 0, 0, log_path, logmsg_path);
+  table_id = open_table(table_path);
+  ASSERT_GT(table_id, 0);
+
+  trx_id = trx_begin();
+  for (key = 0; key < kNumRecords; key++) {
+    ASSERT_EQ(db_find(table_id, key, value, &val_size, trx_id), 0) << "key " << key;
+    make_value(expected, 'u', key);
+    EXPECT_EQ(memcmp(value, expected, kValueSize), 0)
+        << "key " << key << ": " << std::string(value, 9);
+  }
+  trx_commit(trx_id);
+  shutdown_db();
+
+  EXPECT_EQ(count_lines_with(logmsg_path, "undo apply"), 0);
+}
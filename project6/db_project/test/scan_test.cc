@@ -0,0 +1,93 @@
+#include "bpt.h"
+
+#include <gtest/gtest.h>
+
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+/*******************************************************************************
+ * Range scan cursor.
+ * The cursor pins no page between the calls, so the tree may change under it.
+ ******************************************************************************/
+
+namespace {
+
+const int kNumRecords = 3000;
+const int kValueSize = 100;
+
+char log_path[] = "log";
+char logmsg_path[] = "logmsg";
+char table_path[] = "DATA1";
+
+}  // namespace
+
+class ScanTest : public ::testing::Test {
+ protected:
+  ScanTest() {
+    char dir_template[] = "/tmp/db_scan_testXXXXXX";
+
+    old_dir = getcwd(NULL, 0);
+    test_dir = mkdtemp(dir_template);
+    if (chdir(test_dir.c_str()) < 0)
+      test_dir.clear();
+  }
+
+  ~ScanTest() {
+    if (chdir(old_dir) == 0 && !test_dir.empty())
+      system(("rm -rf " + test_dir).c_str());
+    free(old_dir);
+  }
+
+  char* old_dir;
+  std::string test_dir;
+};
+
+/*
+ * Tests a scan across the deletes which coalesce its leaf page.
+ * 1. Insert the records, and scan some of them
+ * 2. Delete the records around the position, freeing the leaf page of the cursor
+ * 3. Continue the scan, and check that only the remaining records follow in order
+ */
+TEST_F(ScanTest, SkipsRecordsDeletedBetweenCalls) {
+  char value[kValueSize];
+  uint16_t val_size;
+  scan_cursor_t* cursor;
+  std::vector<int64_t> keys;
+  int64_t table_id;
+  int64_t key;
+  int i;
+
+  ASSERT_FALSE(test_dir.empty());
+  init_db(100, 0, 0, log_path, logmsg_path);
+  table_id = open_table(table_path);
+  ASSERT_GT(table_id, 0);
+
+  memset(value, 'v', kValueSize);
+  for (key = 0; key < kNumRecords; key++)
+    ASSERT_EQ(db_insert(table_id, key, value, kValueSize), 0);
+
+  cursor = db_scan_open(table_id, 0, kNumRecords - 1, 0);
+  ASSERT_NE(cursor, nullptr);
+  for (i = 0; i < 100; i++) {
+    ASSERT_EQ(db_scan_next(cursor, &key, value, &val_size), 0);
+    keys.push_back(key);
+  }
+
+  for (key = 50; key < 1500; key++)
+    ASSERT_EQ(db_delete(table_id, key), 0);
+
+  while (db_scan_next(cursor, &key, value, &val_size) == 0)
+    keys.push_back(key);
+  db_scan_close(cursor);
+  shutdown_db();
+
+  ASSERT_EQ(keys.size(), 1600u);
+  for (i = 0; i < 100; i++)
+    EXPECT_EQ(keys[i], i);
+  for (i = 100; i < 1600; i++)
+    EXPECT_EQ(keys[i], i + 1400);
+}